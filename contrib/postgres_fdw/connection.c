@@ -63,6 +63,7 @@ typedef struct ConnCacheEntry
 	uint32		server_hashvalue;	/* hash value of foreign server OID */
 	uint32		mapping_hashvalue;	/* hash value of user mapping OID */
 	CSN			imported_csn;
+	PgFdwConnState state;		/* extra per-connection state */
 } ConnCacheEntry;
 
 /*
@@ -99,9 +100,24 @@ static bool pgfdw_get_cleanup_result(PGconn *conn, TimestampTz endtime,
 static bool UserMappingPasswordRequired(UserMapping *user);
 static void pgfdw_cleanup_after_transaction(ConnCacheEntry *entry);
 static ConnCacheEntry *GetConnectionCacheEntry(Oid umid);
-static void pgfdw_end_prepared_xact(ConnCacheEntry *entry, UserMapping *usermapping,
-									char *fdwxact_id, bool is_commit);
+static void pgfdw_end_prepared_xact(ConnCacheEntry *entry,
+									FdwXactRslvState *frstate, bool is_commit);
+static void pgfdw_send_end_prepared_xact(FdwXactRslvState *frstate,
+										 bool is_commit);
+static void pgfdw_wait_end_prepared_xact(FdwXactRslvState *frstate,
+										 bool is_commit);
+static void pgfdw_connect_for_prepared_xacts(ConnCacheEntry *entry,
+											 UserMapping *usermapping);
+static void pgfdw_end_prepared_xact_command(StringInfo command,
+											FdwXactRslvState *frstate,
+											bool is_commit);
+static void pgfdw_check_end_prepared_result(ConnCacheEntry *entry,
+											PGresult *res, const char *sql);
 static void SyncCSNSnapshot(ConnCacheEntry *entry);
+static void pgfdw_send_query(ConnCacheEntry *entry, const char *sql);
+static void pgfdw_prepare_xact_command(FdwXactRslvState *frstate, char *buf,
+									   int buflen);
+static CSN	pgfdw_get_csn_result(PGresult *res, char *fdwxact_id);
 /*
  * Get a PGconn which can be used to execute queries on the remote PostgreSQL
  * server with the user's authorization.  A new connection is established
@@ -111,9 +127,12 @@ static void SyncCSNSnapshot(ConnCacheEntry *entry);
  * will_prep_stmt must be true if caller intends to create any prepared
  * statements.  Since those don't go away automatically at transaction end
  * (not even on error), we need this flag to cue manual cleanup.
+ *
+ * If state is not NULL, *state receives the per-connection state associated
+ * with the PGconn.
  */
 PGconn *
-GetConnection(UserMapping *user, bool will_prep_stmt)
+GetConnection(UserMapping *user, bool will_prep_stmt, PgFdwConnState **state)
 {
 	bool		retry = false;
 	ConnCacheEntry *entry;
@@ -121,6 +140,15 @@ GetConnection(UserMapping *user, bool will_prep_stmt)
 
 	entry = GetConnectionCacheEntry(user->umid);
 
+	/*
+	 * A backend that gave up waiting for the result of COMMIT PREPARED
+	 * leaves the connection busy.  No remote transaction of ours is open on
+	 * it, so just start over with a new connection.
+	 */
+	if (entry->conn != NULL && entry->changing_xact_state &&
+		entry->xact_depth == 0)
+		disconnect_pg_server(entry);
+
 	/* Reject further use of connections which failed abort cleanup. */
 	pgfdw_reject_incomplete_xact_state_change(entry);
 
@@ -218,6 +246,10 @@ GetConnection(UserMapping *user, bool will_prep_stmt)
 	/* Remember if caller will prepare statements */
 	entry->have_prep_stmt |= will_prep_stmt;
 
+	/* If caller needs access to the per-connection state, return it. */
+	if (state)
+		*state = &entry->state;
+
 	return entry->conn;
 }
 
@@ -294,6 +326,7 @@ make_new_connection(ConnCacheEntry *entry, UserMapping *user)
 	entry->invalidated = false;
 	entry->modified = false;
 	entry->imported_csn = InvalidCSN;
+	memset(&entry->state, 0, sizeof(entry->state));
 	entry->server_hashvalue =
 		GetSysCacheHashValue1(FOREIGNSERVEROID,
 							  ObjectIdGetDatum(server->serverid));
@@ -610,6 +643,13 @@ begin_remote_xact(ConnCacheEntry *entry, UserMapping *user)
 		entry->modified = false;
 		entry->changing_xact_state = false;
 	}
+
+	/*
+	 * If an asynchronous fetch is still in flight on this connection, it
+	 * must be completed before we can send any further commands.
+	 */
+	process_pending_requests(&entry->state);
+
 	/*
 	 * if global snapshot is enabled we need
 	 * to import the CSN in the foreign transaction
@@ -652,7 +692,7 @@ SyncCSNSnapshot(ConnCacheEntry *entry)
 			"SELECT pg_csn_snapshot_import("UINT64_FORMAT")",entry->imported_csn);
 
 		entry->changing_xact_state = true;
-		res = pgfdw_exec_query(entry->conn, sql);
+		res = pgfdw_exec_query(entry->conn, sql, &entry->state);
 		entry->changing_xact_state = false;
 
 		if (PQresultStatus(res) != PGRES_TUPLES_OK)
@@ -711,11 +751,19 @@ GetPrepStmtNumber(PGconn *conn)
  *
  * This function is interruptible by signals.
  *
+ * If state is not NULL and an asynchronous request is pending on the
+ * connection, it is completed first so that its result isn't mistaken for
+ * ours.
+ *
  * Caller is responsible for the error handling on the result.
  */
 PGresult *
-pgfdw_exec_query(PGconn *conn, const char *query)
+pgfdw_exec_query(PGconn *conn, const char *query, PgFdwConnState *state)
 {
+	/* First, complete any request still in flight on the connection. */
+	if (state)
+		process_pending_requests(state);
+
 	/*
 	 * Submit a query.  Since we don't use non-blocking mode, this also can
 	 * block.  But its risk is relatively small, so we ignore that for now.
@@ -727,6 +775,75 @@ pgfdw_exec_query(PGconn *conn, const char *query)
 	return pgfdw_get_result(conn, query);
 }
 
+/*
+ * Run a COPY ... FROM STDIN command, sending the given data as its input,
+ * and wait for the final result.
+ *
+ * This function is interruptible by signals while waiting for the remote
+ * server, and completes a pending asynchronous request first just like
+ * pgfdw_exec_query.  The data must be in the format the COPY command expects.
+ *
+ * Caller is responsible for the error handling on the result.
+ */
+PGresult *
+pgfdw_exec_copy_in(PGconn *conn, const char *query,
+				   const char *data, int len, PgFdwConnState *state)
+{
+	PGresult   *res;
+
+	/* First, complete any request still in flight on the connection. */
+	if (state)
+		process_pending_requests(state);
+
+	if (!PQsendQuery(conn, query))
+		pgfdw_report_error(ERROR, NULL, conn, false, query);
+
+	/*
+	 * Wait for the server to switch into COPY IN mode.  pgfdw_get_result
+	 * can't be used for that, since PQgetResult keeps returning the
+	 * PGRES_COPY_IN result until the copy is ended.
+	 */
+	while (PQisBusy(conn))
+	{
+		int			wc;
+
+		wc = WaitLatchOrSocket(MyLatch,
+							   WL_LATCH_SET | WL_SOCKET_READABLE |
+							   WL_EXIT_ON_PM_DEATH,
+							   PQsocket(conn),
+							   -1L, PG_WAIT_EXTENSION);
+		ResetLatch(MyLatch);
+
+		CHECK_FOR_INTERRUPTS();
+
+		if (wc & WL_SOCKET_READABLE)
+		{
+			if (!PQconsumeInput(conn))
+				pgfdw_report_error(ERROR, NULL, conn, false, query);
+		}
+	}
+
+	res = PQgetResult(conn);
+	if (PQresultStatus(res) != PGRES_COPY_IN)
+	{
+		/* The command failed to start; collect the rest of its results. */
+		PQclear(pgfdw_get_result(conn, query));
+		return res;
+	}
+	PQclear(res);
+
+	/*
+	 * Send the data and end the copy.  Since we don't use non-blocking mode,
+	 * these can block, as with PQsendQuery.
+	 */
+	if (PQputCopyData(conn, data, len) != 1 ||
+		PQputCopyEnd(conn, NULL) != 1)
+		pgfdw_report_error(ERROR, NULL, conn, false, query);
+
+	/* Wait for the result of the COPY command itself. */
+	return pgfdw_get_result(conn, query);
+}
+
 /*
  * Wait for the result from a prior asynchronous execution function call.
  *
@@ -899,6 +1016,9 @@ pgfdw_subxact_callback(SubXactEvent event, SubTransactionId mySubid,
 			 */
 			pgfdw_reject_incomplete_xact_state_change(entry);
 
+			/* Complete any pending asynchronous fetch first */
+			process_pending_requests(&entry->state);
+
 			/* Commit all remote subtransactions during pre-commit */
 			snprintf(sql, sizeof(sql), "RELEASE SAVEPOINT s%d", curlevel);
 			entry->changing_xact_state = true;
@@ -923,6 +1043,10 @@ pgfdw_subxact_callback(SubXactEvent event, SubTransactionId mySubid,
 			/* Assume we might have lost track of prepared statements */
 			entry->have_error = true;
 
+			/* Forget any requests in flight; they are being cancelled */
+			entry->state.pendingAreq = NULL;
+			entry->state.pendingFetch = NULL;
+
 			/*
 			 * If a command has been submitted to the remote server by using
 			 * an asynchronous execution function, the command might not have
@@ -1227,8 +1351,7 @@ postgresCommitForeignTransaction(FdwXactRslvState *frstate)
 	if (!is_onephase)
 	{
 		/* COMMIT PREPARED the transaction and cleanup */
-		pgfdw_end_prepared_xact(entry, frstate->usermapping,
-								frstate->fdwxact_id, true);
+		pgfdw_end_prepared_xact(entry, frstate, true);
 		return;
 	}
 
@@ -1241,7 +1364,7 @@ postgresCommitForeignTransaction(FdwXactRslvState *frstate)
 	pgfdw_reject_incomplete_xact_state_change(entry);
 
 	entry->changing_xact_state = true;
-	res = pgfdw_exec_query(entry->conn, "COMMIT TRANSACTION");
+	res = pgfdw_exec_query(entry->conn, "COMMIT TRANSACTION", NULL);
 	entry->changing_xact_state = false;
 
 	if (PQresultStatus(res) != PGRES_COMMAND_OK)
@@ -1290,8 +1413,7 @@ postgresRollbackForeignTransaction(FdwXactRslvState *frstate)
 	if (!is_onephase)
 	{
 		/* ROLLBACK PREPARED the transaction and cleanup */
-		pgfdw_end_prepared_xact(entry, frstate->usermapping,
-								frstate->fdwxact_id, false);
+		pgfdw_end_prepared_xact(entry, frstate, false);
 		return;
 	}
 
@@ -1371,59 +1493,76 @@ postgresRollbackForeignTransaction(FdwXactRslvState *frstate)
 	return;
 }
 
-static CSN
-pgfdw_prepare_remote_csn_snapshot(ConnCacheEntry *entry, char *fdwxact_id)
+/*
+ * Send the query to the foreign server without waiting for the result, which
+ * is collected later by pgfdw_get_result.
+ */
+static void
+pgfdw_send_query(ConnCacheEntry *entry, const char *sql)
 {
-	PGresult	*res;
-	CSN		csn = 0;
-	char 	*resp;
-	char	sql[256];
+	if (!PQsendQuery(entry->conn, sql))
+		pgfdw_report_error(ERROR, NULL, entry->conn, false, sql);
+}
 
-	snprintf(sql, sizeof(sql),
-		"SELECT pg_csn_snapshot_prepare('%s')",fdwxact_id);
+/*
+ * Build the command to prepare the transaction into buf.
+ *
+ * If the global CSN is used, we also ask for the prepare CSN of the
+ * transaction in the same query string.  PREPARE TRANSACTION cannot be
+ * executed inside a function, and the prepared transaction is available
+ * only after the command completes, so it's sent as a separate statement,
+ * which still costs no additional round trip.
+ */
+static void
+pgfdw_prepare_xact_command(FdwXactRslvState *frstate, char *buf, int buflen)
+{
+	if (frstate->flags & FDWXACT_FLAG_USE_GLOBAL_CSN)
+		snprintf(buf, buflen,
+				 "PREPARE TRANSACTION '%s'; SELECT pg_csn_snapshot_prepare('%s')",
+				 frstate->fdwxact_id, frstate->fdwxact_id);
+	else
+		snprintf(buf, buflen, "PREPARE TRANSACTION '%s'", frstate->fdwxact_id);
+}
 
-	/* Do prepare foreign transaction */
-	entry->changing_xact_state = true;
-	res = pgfdw_exec_query(entry->conn, sql);
-	entry->changing_xact_state = false;
+/*
+ * Extract the CSN returned by pg_csn_snapshot_prepare() from the result.
+ */
+static CSN
+pgfdw_get_csn_result(PGresult *res, char *fdwxact_id)
+{
+	CSN			csn = InvalidCSN;
+	char	   *resp;
 
-	if (PQresultStatus(res) != PGRES_TUPLES_OK)
-		ereport(ERROR,
-				(errmsg("could not prepare CSN snapshot with ID %s",fdwxact_id)));
 	resp = PQgetvalue(res, 0, 0);
 
 	if (resp == NULL || (*resp) == '\0' ||
 			sscanf(resp, UINT64_FORMAT, &csn) != 1)
 		ereport(ERROR,
 				(errmsg("pg_csn_snapshot_prepare returned invalid data for prepared transaction with ID %s",
-							   fdwxact_id)));
+						fdwxact_id)));
 	return csn;
 }
 
-static void
-pgfdw_assign_global_snapshot_to_xact(ConnCacheEntry *entry, char *fdwxact_id, CSN csn)
-{
-	PGresult	*res;
-	char	sql[256];
-
-	snprintf(sql, sizeof(sql),
-			 "SELECT pg_csn_snapshot_assign('%s', "UINT64_FORMAT")", fdwxact_id, csn);
-	res = pgfdw_exec_query(entry->conn, sql);
-	if (PQresultStatus(res) != PGRES_TUPLES_OK)
-		ereport(ERROR,
-				(errmsg("could not assign global CSN to prepared transaction with ID %s",
-						fdwxact_id)));
-	PQclear(res);
-}
 /*
  * Prepare a transaction on foreign server.
  */
 void
 postgresPrepareForeignTransaction(FdwXactRslvState *frstate)
+{
+	postgresSendPrepareForeignTransaction(frstate);
+	postgresWaitPrepareForeignTransaction(frstate);
+}
+
+/*
+ * Send PREPARE TRANSACTION to the foreign server.  The result is collected by
+ * postgresWaitPrepareForeignTransaction, so that transactions on several
+ * servers can be prepared concurrently.
+ */
+void
+postgresSendPrepareForeignTransaction(FdwXactRslvState *frstate)
 {
 	ConnCacheEntry *entry = NULL;
-	PGresult	*res;
-	StringInfo	command;
+	char		sql[512];
 
 	/* The transaction should have started already get the cache entry */
 	entry = GetConnectionCacheEntry(frstate->usermapping->umid);
@@ -1431,18 +1570,49 @@ postgresPrepareForeignTransaction(FdwXactRslvState *frstate)
 
 	pgfdw_reject_incomplete_xact_state_change(entry);
 
-	command = makeStringInfo();
-	appendStringInfo(command, "PREPARE TRANSACTION '%s'", frstate->fdwxact_id);
+	pgfdw_prepare_xact_command(frstate, sql, sizeof(sql));
 
-	/* Do prepare foreign transaction */
+	/*
+	 * Do prepare foreign transaction.  The connection stays in the middle of
+	 * changing transaction state until we get the result.
+	 */
 	entry->changing_xact_state = true;
-	res = pgfdw_exec_query(entry->conn, command->data);
+	pgfdw_send_query(entry, sql);
+}
+
+/*
+ * Wait for the result of PREPARE TRANSACTION sent by
+ * postgresSendPrepareForeignTransaction.
+ */
+void
+postgresWaitPrepareForeignTransaction(FdwXactRslvState *frstate)
+{
+	ConnCacheEntry *entry = NULL;
+	PGresult	*res;
+	char		sql[512];
+
+	entry = GetConnectionCacheEntry(frstate->usermapping->umid);
+	Assert(entry->conn);
+
+	pgfdw_prepare_xact_command(frstate, sql, sizeof(sql));
+
+	/*
+	 * If the prepare CSN is requested too, we get the result of the SELECT
+	 * as the last result.  An error in PREPARE TRANSACTION skips the rest of
+	 * the query string, so the last result is the error in that case.
+	 */
+	res = pgfdw_get_result(entry->conn, sql);
 	entry->changing_xact_state = false;
 
-	if (PQresultStatus(res) != PGRES_COMMAND_OK)
+	if (PQresultStatus(res) !=
+		((frstate->flags & FDWXACT_FLAG_USE_GLOBAL_CSN) ? PGRES_TUPLES_OK : PGRES_COMMAND_OK))
 		ereport(ERROR, (errmsg("could not prepare transaction on server %s with ID %s",
 							   frstate->server->servername, frstate->fdwxact_id)));
 
+	if (frstate->flags & FDWXACT_FLAG_USE_GLOBAL_CSN)
+		frstate->csn = pgfdw_get_csn_result(res, frstate->fdwxact_id);
+	PQclear(res);
+
 	elog(DEBUG1, "prepared foreign transaction on server %s with ID %s",
 		 frstate->server->servername, frstate->fdwxact_id);
 
@@ -1464,6 +1634,8 @@ pgfdw_cleanup_after_transaction(ConnCacheEntry *entry)
 	entry->have_prep_stmt = false;
 	entry->have_error  = false;
 	entry->imported_csn = InvalidCSN;
+	entry->state.pendingAreq = NULL;
+	entry->state.pendingFetch = NULL;
 
 	/*
 	 * If the connection isn't in a good idle state, discard it to
@@ -1486,56 +1658,110 @@ pgfdw_cleanup_after_transaction(ConnCacheEntry *entry)
 CSN
 postgresPrepareForeignCSNSnapshot(FdwXactRslvState *frstate)
 {
-	uint64 csn;
+	postgresSendPrepareForeignCSNSnapshot(frstate);
+	return postgresWaitPrepareForeignCSNSnapshot(frstate);
+}
+
+/*
+ * Ask the foreign server for the prepare CSN of the prepared transaction.
+ * The result is collected by postgresWaitPrepareForeignCSNSnapshot.
+ */
+void
+postgresSendPrepareForeignCSNSnapshot(FdwXactRslvState *frstate)
+{
 	ConnCacheEntry *entry = NULL;
+	char		sql[256];
+
 	/*
 	 * The foreign transaction must already have been prepared
 	 * and we might not have a connection to it. So We get a connection
 	 * but don't start transaction.
 	 */
 	entry = GetConnectionCacheEntry(frstate->usermapping->umid);
-	csn = pgfdw_prepare_remote_csn_snapshot(entry, frstate->fdwxact_id);
+
+	snprintf(sql, sizeof(sql),
+			 "SELECT pg_csn_snapshot_prepare('%s')", frstate->fdwxact_id);
+
+	entry->changing_xact_state = true;
+	pgfdw_send_query(entry, sql);
+}
+
+CSN
+postgresWaitPrepareForeignCSNSnapshot(FdwXactRslvState *frstate)
+{
+	ConnCacheEntry *entry = NULL;
+	PGresult	*res;
+	CSN			csn;
+	char		sql[256];
+
+	entry = GetConnectionCacheEntry(frstate->usermapping->umid);
+
+	snprintf(sql, sizeof(sql),
+			 "SELECT pg_csn_snapshot_prepare('%s')", frstate->fdwxact_id);
+
+	res = pgfdw_get_result(entry->conn, sql);
+	entry->changing_xact_state = false;
+
+	if (PQresultStatus(res) != PGRES_TUPLES_OK)
+		ereport(ERROR,
+				(errmsg("could not prepare CSN snapshot with ID %s",
+						frstate->fdwxact_id)));
+	csn = pgfdw_get_csn_result(res, frstate->fdwxact_id);
+	PQclear(res);
+
 	/* Cleanup transaction status */
 	pgfdw_cleanup_after_transaction(entry);
 	return csn;
 }
 
-void
-postgresAssignGlobalCSN(FdwXactRslvState *frstate, CSN max_csn)
+/*
+ * Commit or rollback prepared transaction on the foreign server.  If the
+ * state has the flag FDWXACT_FLAG_USE_GLOBAL_CSN, its csn is assigned to the
+ * transaction being committed as its global CSN by the same command.
+ */
+static void
+pgfdw_end_prepared_xact(ConnCacheEntry *entry, FdwXactRslvState *frstate,
+						bool is_commit)
 {
-	ConnCacheEntry *entry = NULL;
+	StringInfoData command;
+	PGresult   *res;
+
+	pgfdw_connect_for_prepared_xacts(entry, frstate->usermapping);
+
+	initStringInfo(&command);
+	pgfdw_end_prepared_xact_command(&command, frstate, is_commit);
+
 	/*
-	 * The foreign transaction must already have been prepared
-	 * and we might not have a connection to it. So We get a connection
-	 * but don't start transaction.
+	 * Once the transaction is prepared, further transaction callback is not
+	 * called even when an error occurred during resolving it.  Therefore, we
+	 * don't need to set changing_xact_state here.  On failure the new
+	 * connection will be established either when the new transaction is
+	 * started or when checking the connection status above.
 	 */
+	res = pgfdw_exec_query(entry->conn, command.data, NULL);
+	pgfdw_check_end_prepared_result(entry, res, command.data);
+	pfree(command.data);
 
-	entry = GetConnectionCacheEntry(frstate->usermapping->umid);
-	pgfdw_assign_global_snapshot_to_xact(entry, frstate->fdwxact_id, max_csn);
-
-	elog(DEBUG1, "global CSN "UINT64_FORMAT" assigned to prepared foreign transaction with ID %s",
-		 max_csn, frstate->fdwxact_id);
+	elog(DEBUG1, "%s prepared foreign transaction with ID %s",
+		 is_commit ? "commit" : "rollback",
+		 frstate->fdwxact_id);
 
 	/* Cleanup transaction status */
 	pgfdw_cleanup_after_transaction(entry);
-
 }
 
 /*
- * Commit or rollback prepared transaction on the foreign server.
+ * Make sure that we have a usable connection to end prepared transactions.
  */
 static void
-pgfdw_end_prepared_xact(ConnCacheEntry *entry, UserMapping *usermapping,
-						char *fdwxact_id, bool is_commit)
+pgfdw_connect_for_prepared_xacts(ConnCacheEntry *entry, UserMapping *usermapping)
 {
-	StringInfo	command;
-	PGresult	*res;
-
 	/*
 	 * Check the connection status for the case the previous attempt
-	 * failed.
+	 * failed, or was abandoned while waiting for the result.
 	 */
-	if (entry->conn && PQstatus(entry->conn) != CONNECTION_OK)
+	if (entry->conn &&
+		(PQstatus(entry->conn) != CONNECTION_OK || entry->changing_xact_state))
 		disconnect_pg_server(entry);
 
 	/*
@@ -1545,21 +1771,34 @@ pgfdw_end_prepared_xact(ConnCacheEntry *entry, UserMapping *usermapping,
 	 */
 	if (!entry->conn)
 		make_new_connection(entry, usermapping);
+}
 
-	command = makeStringInfo();
+/*
+ * Build the command to commit or rollback the prepared transaction into
+ * command.
+ */
+static void
+pgfdw_end_prepared_xact_command(StringInfo command, FdwXactRslvState *frstate,
+								bool is_commit)
+{
+	resetStringInfo(command);
 	appendStringInfo(command, "%s PREPARED '%s'",
 					 is_commit ? "COMMIT" : "ROLLBACK",
-					 fdwxact_id);
-
-	/*
-	 * Once the transaction is prepared, further transaction callback is not
-	 * called even when an error occurred during resolving it.  Therefore, we
-	 * don't need to set changing_xact_state here.  On failure the new connection
-	 * will be established either when the new transaction is started or when
-	 * checking the connection status above.
-	 */
-	res = pgfdw_exec_query(entry->conn, command->data);
+					 frstate->fdwxact_id);
+	if (frstate->flags & FDWXACT_FLAG_USE_GLOBAL_CSN)
+	{
+		Assert(is_commit);
+		appendStringInfo(command, " WITH CSN " UINT64_FORMAT, frstate->csn);
+	}
+}
 
+/*
+ * Check the result of COMMIT/ROLLBACK PREPARED and clear it.
+ */
+static void
+pgfdw_check_end_prepared_result(ConnCacheEntry *entry, PGresult *res,
+								const char *sql)
+{
 	if (PQresultStatus(res) != PGRES_COMMAND_OK)
 	{
 		int		sqlstate;
@@ -1577,18 +1816,100 @@ pgfdw_end_prepared_xact(ConnCacheEntry *entry, UserMapping *usermapping,
 			sqlstate = ERRCODE_CONNECTION_FAILURE;
 
 		/*
-		 * As core global transaction manager states, it's possible that the
-		 * given foreign transaction doesn't exist on the foreign server. So
-		 * we should accept an UNDEFINED_OBJECT error.
+		 * As core global transaction manager states, it's possible that
+		 * the given foreign transaction doesn't exist on the foreign
+		 * server. So we should accept an UNDEFINED_OBJECT error.
 		 */
 		if (sqlstate != ERRCODE_UNDEFINED_OBJECT)
-			pgfdw_report_error(ERROR, res, entry->conn, false, command->data);
+			pgfdw_report_error(ERROR, res, entry->conn, true, sql);
 	}
+	PQclear(res);
+}
+
+/*
+ * Send COMMIT PREPARED to the foreign server.  The result is collected by
+ * postgresWaitCommitForeignTransaction, so that the prepared transactions on
+ * several servers can be committed concurrently.
+ */
+void
+postgresSendCommitForeignTransaction(FdwXactRslvState *frstate)
+{
+	pgfdw_send_end_prepared_xact(frstate, true);
+}
+
+/*
+ * Wait for the result of COMMIT PREPARED sent by
+ * postgresSendCommitForeignTransaction.
+ */
+void
+postgresWaitCommitForeignTransaction(FdwXactRslvState *frstate)
+{
+	pgfdw_wait_end_prepared_xact(frstate, true);
+}
+
+/*
+ * Asynchronous variants of postgresRollbackForeignTransaction for a prepared
+ * transaction, like the ones above.
+ */
+void
+postgresSendRollbackForeignTransaction(FdwXactRslvState *frstate)
+{
+	pgfdw_send_end_prepared_xact(frstate, false);
+}
+
+void
+postgresWaitRollbackForeignTransaction(FdwXactRslvState *frstate)
+{
+	pgfdw_wait_end_prepared_xact(frstate, false);
+}
+
+/*
+ * Send COMMIT or ROLLBACK PREPARED without waiting for the result, which is
+ * collected by pgfdw_wait_end_prepared_xact.
+ */
+static void
+pgfdw_send_end_prepared_xact(FdwXactRslvState *frstate, bool is_commit)
+{
+	ConnCacheEntry *entry;
+	StringInfoData command;
+
+	entry = GetConnectionCacheEntry(frstate->usermapping->umid);
+	pgfdw_connect_for_prepared_xacts(entry, frstate->usermapping);
+
+	/*
+	 * The caller may give up waiting for the result, so mark the connection
+	 * busy until we have it.
+	 */
+	initStringInfo(&command);
+	pgfdw_end_prepared_xact_command(&command, frstate, is_commit);
+	entry->changing_xact_state = true;
+	pgfdw_send_query(entry, command.data);
+	pfree(command.data);
+}
+
+/*
+ * Wait for the result of the command sent by pgfdw_send_end_prepared_xact.
+ */
+static void
+pgfdw_wait_end_prepared_xact(FdwXactRslvState *frstate, bool is_commit)
+{
+	ConnCacheEntry *entry;
+	StringInfoData command;
+	PGresult   *res;
+
+	entry = GetConnectionCacheEntry(frstate->usermapping->umid);
+	Assert(entry->conn);
+
+	initStringInfo(&command);
+	pgfdw_end_prepared_xact_command(&command, frstate, is_commit);
+	res = pgfdw_get_result(entry->conn, command.data);
+	entry->changing_xact_state = false;
+	pgfdw_check_end_prepared_result(entry, res, command.data);
+	pfree(command.data);
 
 	elog(DEBUG1, "%s prepared foreign transaction with ID %s",
 		 is_commit ? "commit" : "rollback",
-		 fdwxact_id);
+		 frstate->fdwxact_id);
 
-	/* Cleanup transaction status */
 	pgfdw_cleanup_after_transaction(entry);
 }
@@ -20,6 +20,7 @@
 #include "commands/extension.h"
 #include "postgres_fdw.h"
 #include "utils/builtins.h"
+#include "utils/guc.h"
 #include "utils/varlena.h"
 
 /*
@@ -107,7 +108,11 @@ postgres_fdw_validator(PG_FUNCTION_ARGS)
 		 * Validate option value, when we can do so without any context.
 		 */
 		if (strcmp(def->defname, "use_remote_estimate") == 0 ||
-			strcmp(def->defname, "updatable") == 0)
+			strcmp(def->defname, "updatable") == 0 ||
+			strcmp(def->defname, "async_capable") == 0 ||
+			strcmp(def->defname, "use_remote_copy") == 0 ||
+			strcmp(def->defname, "binary_transfer") == 0 ||
+			strcmp(def->defname, "prefetch") == 0)
 		{
 			/* these accept only boolean values */
 			(void) defGetBoolean(def);
@@ -142,6 +147,22 @@ postgres_fdw_validator(PG_FUNCTION_ARGS)
 						 errmsg("%s requires a non-negative integer value",
 								def->defname)));
 		}
+		else if (strcmp(def->defname, "batch_size") == 0)
+		{
+			char	   *value = defGetString(def);
+			int			batch_size;
+
+			if (!parse_int(value, &batch_size, 0, NULL))
+				ereport(ERROR,
+						(errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+						 errmsg("invalid value for integer option \"%s\": %s",
+								def->defname, value)));
+			if (batch_size <= 0)
+				ereport(ERROR,
+						(errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+						 errmsg("\"%s\" must be an integer value greater than zero",
+								def->defname)));
+		}
 		else if (strcmp(def->defname, "password_required") == 0)
 		{
 			bool		pw_required = defGetBoolean(def);
@@ -203,6 +224,20 @@ InitPgFdwOptions(void)
 		/* fetch_size is available on both server and table */
 		{"fetch_size", ForeignServerRelationId, false},
 		{"fetch_size", ForeignTableRelationId, false},
+		/* async_capable is available on both server and table */
+		{"async_capable", ForeignServerRelationId, false},
+		{"async_capable", ForeignTableRelationId, false},
+		/* batch_size is available on both server and table */
+		{"batch_size", ForeignServerRelationId, false},
+		{"batch_size", ForeignTableRelationId, false},
+		/* use_remote_copy is available on both server and table */
+		{"use_remote_copy", ForeignServerRelationId, false},
+		{"use_remote_copy", ForeignTableRelationId, false},
+		/* binary_transfer is available on server only */
+		{"binary_transfer", ForeignServerRelationId, false},
+		/* prefetch is available on both server and table */
+		{"prefetch", ForeignServerRelationId, false},
+		{"prefetch", ForeignTableRelationId, false},
 		{"password_required", UserMappingRelationId, false},
 
 		/*
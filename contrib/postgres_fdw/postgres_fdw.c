@@ -18,11 +18,14 @@
 #include "access/sysattr.h"
 #include "access/table.h"
 #include "catalog/pg_class.h"
+#include "catalog/pg_type.h"
 #include "commands/defrem.h"
 #include "commands/explain.h"
 #include "commands/vacuum.h"
+#include "executor/execAsync.h"
 #include "foreign/fdwapi.h"
 #include "funcapi.h"
+#include "mb/pg_wchar.h"
 #include "miscadmin.h"
 #include "nodes/makefuncs.h"
 #include "nodes/nodeFuncs.h"
@@ -36,6 +39,7 @@
 #include "optimizer/tlist.h"
 #include "parser/parsetree.h"
 #include "postgres_fdw.h"
+#include "storage/latch.h"
 #include "utils/builtins.h"
 #include "utils/float.h"
 #include "utils/guc.h"
@@ -44,6 +48,7 @@
 #include "utils/rel.h"
 #include "utils/sampling.h"
 #include "utils/selfuncs.h"
+#include "utils/syscache.h"
 
 PG_MODULE_MAGIC;
 
@@ -56,6 +61,9 @@ PG_MODULE_MAGIC;
 /* If no remote estimates, assume a sort costs 20% extra */
 #define DEFAULT_FDW_SORT_MULTIPLIER 1.2
 
+/* Maximum number of parameters libpq can send with one query (uint16) */
+#define PQ_QUERY_PARAM_MAX_LIMIT	65535
+
 /*
  * Indexes of FDW-private information stored in fdw_private lists.
  *
@@ -71,6 +79,8 @@ enum FdwScanPrivateIndex
 	FdwScanPrivateRetrievedAttrs,
 	/* Integer representing the desired fetch_size */
 	FdwScanPrivateFetchSize,
+	/* Boolean flag showing whether to prefetch batches (as an integer) */
+	FdwScanPrivatePrefetch,
 
 	/*
 	 * String describing join i.e. names of relations being joined and types
@@ -86,8 +96,10 @@ enum FdwScanPrivateIndex
  * 1) INSERT/UPDATE/DELETE statement text to be sent to the remote server
  * 2) Integer list of target attribute numbers for INSERT/UPDATE
  *	  (NIL for a DELETE)
- * 3) Boolean flag showing if the remote query has a RETURNING clause
- * 4) Integer list of attribute numbers retrieved by RETURNING, if any
+ * 3) Length till the end of VALUES clause for INSERT
+ *	  (-1 for a DELETE/UPDATE)
+ * 4) Boolean flag showing if the remote query has a RETURNING clause
+ * 5) Integer list of attribute numbers retrieved by RETURNING, if any
  */
 enum FdwModifyPrivateIndex
 {
@@ -95,6 +107,8 @@ enum FdwModifyPrivateIndex
 	FdwModifyPrivateUpdateSql,
 	/* Integer list of target attribute numbers for INSERT/UPDATE */
 	FdwModifyPrivateTargetAttnums,
+	/* Length till the end of VALUES clause (as an integer Value node) */
+	FdwModifyPrivateLen,
 	/* has-returning flag (as an integer Value node) */
 	FdwModifyPrivateHasReturning,
 	/* Integer list of attribute numbers retrieved by RETURNING */
@@ -131,6 +145,9 @@ typedef struct PgFdwScanState
 								 * for a foreign join scan. */
 	TupleDesc	tupdesc;		/* tuple descriptor of scan */
 	AttInMetadata *attinmeta;	/* attribute datatype conversion metadata */
+	FmgrInfo   *attrecvfuncs;	/* binary input functions for the columns, or
+								 * NULL if results are fetched in text */
+	bool		fetch_binary;	/* request binary format in FETCH? */
 
 	/* extracted fdw_private data */
 	char	   *query;			/* text of SELECT command */
@@ -138,6 +155,7 @@ typedef struct PgFdwScanState
 
 	/* for remote query execution */
 	PGconn	   *conn;			/* connection for the scan */
+	PgFdwConnState *conn_state; /* extra per-connection state */
 	unsigned int cursor_number; /* quasi-unique ID for my cursor */
 	bool		cursor_exists;	/* have we created the cursor? */
 	int			numParams;		/* number of parameters passed to query */
@@ -159,6 +177,15 @@ typedef struct PgFdwScanState
 	MemoryContext temp_cxt;		/* context for per-tuple temporary data */
 
 	int			fetch_size;		/* number of tuples per fetch */
+
+	/* prefetching of the next batch */
+	bool		prefetch;		/* keep a FETCH in flight? */
+	bool		prefetch_ready; /* have we collected a prefetched batch? */
+	HeapTuple  *prefetched_tuples;	/* array of prefetched tuples */
+	int			num_prefetched; /* # of tuples in that array */
+	MemoryContext prefetch_cxt; /* context holding prefetched tuples */
+
+	bool		async_capable;	/* engage asynchronous-capable logic? */
 } PgFdwScanState;
 
 /*
@@ -171,11 +198,17 @@ typedef struct PgFdwModifyState
 
 	/* for remote query execution */
 	PGconn	   *conn;			/* connection for the scan */
+	PgFdwConnState *conn_state; /* extra per-connection state */
 	char	   *p_name;			/* name of prepared statement, if created */
 
 	/* extracted fdw_private data */
 	char	   *query;			/* text of INSERT/UPDATE/DELETE command */
+	char	   *orig_query;		/* original text of INSERT command */
 	List	   *target_attrs;	/* list of target attribute numbers */
+	int			values_end;		/* length up to the end of VALUES */
+	int			batch_size;		/* value of FDW option "batch_size" */
+	char	   *copy_query;		/* COPY FROM STDIN command for batches, or
+								 * NULL to send them with INSERT */
 	bool		has_returning;	/* is there a RETURNING clause? */
 	List	   *retrieved_attrs;	/* attr numbers retrieved by RETURNING */
 
@@ -184,6 +217,9 @@ typedef struct PgFdwModifyState
 	int			p_nums;			/* number of parameters to transmit */
 	FmgrInfo   *p_flinfo;		/* output conversion functions for them */
 
+	/* batch operation stuff */
+	int			num_slots;		/* number of slots to insert */
+
 	/* working memory context */
 	MemoryContext temp_cxt;		/* context for per-tuple temporary data */
 
@@ -208,6 +244,7 @@ typedef struct PgFdwDirectModifyState
 
 	/* for remote query execution */
 	PGconn	   *conn;			/* connection for the update */
+	PgFdwConnState *conn_state; /* extra per-connection state */
 	int			numParams;		/* number of parameters passed to query */
 	FmgrInfo   *param_flinfo;	/* output conversion functions for them */
 	List	   *param_exprs;	/* executable expressions for param values */
@@ -342,6 +379,12 @@ static TupleTableSlot *postgresExecForeignInsert(EState *estate,
 												 ResultRelInfo *resultRelInfo,
 												 TupleTableSlot *slot,
 												 TupleTableSlot *planSlot);
+static TupleTableSlot **postgresExecForeignBatchInsert(EState *estate,
+													   ResultRelInfo *resultRelInfo,
+													   TupleTableSlot **slots,
+													   TupleTableSlot **planSlots,
+													   int *numSlots);
+static int	postgresGetForeignModifyBatchSize(ResultRelInfo *resultRelInfo);
 static TupleTableSlot *postgresExecForeignUpdate(EState *estate,
 												 ResultRelInfo *resultRelInfo,
 												 TupleTableSlot *slot,
@@ -386,6 +429,10 @@ static void postgresGetForeignJoinPaths(PlannerInfo *root,
 										JoinPathExtraData *extra);
 static bool postgresRecheckForeignScan(ForeignScanState *node,
 									   TupleTableSlot *slot);
+static bool postgresIsForeignPathAsyncCapable(ForeignPath *path);
+static void postgresForeignAsyncRequest(AsyncRequest *areq);
+static void postgresForeignAsyncConfigureWait(AsyncRequest *areq);
+static void postgresForeignAsyncNotify(AsyncRequest *areq);
 static void postgresGetForeignUpperPaths(PlannerInfo *root,
 										 UpperRelationKind stage,
 										 RelOptInfo *input_rel,
@@ -420,7 +467,14 @@ static bool ec_member_matches_foreign(PlannerInfo *root, RelOptInfo *rel,
 									  void *arg);
 static void create_cursor(ForeignScanState *node);
 static void fetch_more_data(ForeignScanState *node);
-static void close_cursor(PGconn *conn, unsigned int cursor_number);
+static HeapTuple *make_tuples_from_result(ForeignScanState *node,
+										  PGresult *res);
+static void process_pending_fetch(ForeignScanState *node);
+static void fetch_more_data_begin(AsyncRequest *areq);
+static void produce_tuple_asynchronously(AsyncRequest *areq, bool fetch);
+static void complete_pending_request(AsyncRequest *areq);
+static void close_cursor(PGconn *conn, unsigned int cursor_number,
+						 PgFdwConnState *conn_state);
 static PgFdwModifyState *create_foreign_modify(EState *estate,
 											   RangeTblEntry *rte,
 											   ResultRelInfo *resultRelInfo,
@@ -428,20 +482,30 @@ static PgFdwModifyState *create_foreign_modify(EState *estate,
 											   Plan *subplan,
 											   char *query,
 											   List *target_attrs,
+											   int values_end,
 											   bool has_returning,
 											   List *retrieved_attrs);
-static TupleTableSlot *execute_foreign_modify(EState *estate,
-											  ResultRelInfo *resultRelInfo,
-											  CmdType operation,
-											  TupleTableSlot *slot,
-											  TupleTableSlot *planSlot);
+static TupleTableSlot **execute_foreign_modify(EState *estate,
+											   ResultRelInfo *resultRelInfo,
+											   CmdType operation,
+											   TupleTableSlot **slots,
+											   TupleTableSlot **planSlots,
+											   int *numSlots);
 static void prepare_foreign_modify(PgFdwModifyState *fmstate);
 static const char **convert_prep_stmt_params(PgFdwModifyState *fmstate,
 											 ItemPointer tupleid,
-											 TupleTableSlot *slot);
+											 TupleTableSlot **slots,
+											 int numSlots);
 static void store_returning_result(PgFdwModifyState *fmstate,
 								   TupleTableSlot *slot, PGresult *res);
 static void finish_foreign_modify(PgFdwModifyState *fmstate);
+static void deallocate_query(PgFdwModifyState *fmstate);
+static void init_remote_copy(PgFdwModifyState *fmstate, RangeTblEntry *rte,
+							 Index rtindex, bool doNothing);
+static TupleTableSlot **execute_foreign_copy(PgFdwModifyState *fmstate,
+											 TupleTableSlot **slots,
+											 int *numSlots);
+static void append_copy_field(StringInfo buf, const char *value);
 static List *build_remote_returning(Index rtindex, Relation rel,
 									List *returningList);
 static void rebuild_fdw_scan_tlist(ForeignScan *fscan, List *tlist);
@@ -470,10 +534,18 @@ static int	postgresAcquireSampleRowsFunc(Relation relation, int elevel,
 										  double *totaldeadrows);
 static void analyze_row_processor(PGresult *res, int row,
 								  PgFdwAnalyzeState *astate);
+static FmgrInfo *prepare_binary_transfer(ForeignServer *server,
+										 TupleDesc tupdesc,
+										 List *retrieved_attrs);
+static bool is_binary_transfer_safe(Oid typid);
+static bool binary_result_types_match(PgFdwScanState *fsstate,
+									  PGresult *res);
+static void send_fetch(PgFdwScanState *fsstate, const char *sql);
 static HeapTuple make_tuple_from_result_row(PGresult *res,
 											int row,
 											Relation rel,
 											AttInMetadata *attinmeta,
+											FmgrInfo *attrecvfuncs,
 											List *retrieved_attrs,
 											ForeignScanState *fsstate,
 											MemoryContext temp_context);
@@ -501,6 +573,8 @@ static void add_foreign_final_paths(PlannerInfo *root,
 									FinalPathExtraData *extra);
 static void apply_server_options(PgFdwRelationInfo *fpinfo);
 static void apply_table_options(PgFdwRelationInfo *fpinfo);
+static DefElem *get_insert_option(Relation rel, const char *defname);
+static int	get_batch_size_option(Relation rel);
 static void merge_fdw_options(PgFdwRelationInfo *fpinfo,
 							  const PgFdwRelationInfo *fpinfo_o,
 							  const PgFdwRelationInfo *fpinfo_i);
@@ -529,6 +603,8 @@ postgres_fdw_handler(PG_FUNCTION_ARGS)
 	routine->PlanForeignModify = postgresPlanForeignModify;
 	routine->BeginForeignModify = postgresBeginForeignModify;
 	routine->ExecForeignInsert = postgresExecForeignInsert;
+	routine->ExecForeignBatchInsert = postgresExecForeignBatchInsert;
+	routine->GetForeignModifyBatchSize = postgresGetForeignModifyBatchSize;
 	routine->ExecForeignUpdate = postgresExecForeignUpdate;
 	routine->ExecForeignDelete = postgresExecForeignDelete;
 	routine->EndForeignModify = postgresEndForeignModify;
@@ -563,10 +639,23 @@ postgres_fdw_handler(PG_FUNCTION_ARGS)
 	routine->CommitForeignTransaction = postgresCommitForeignTransaction;
 	routine->RollbackForeignTransaction = postgresRollbackForeignTransaction;
 	routine->PrepareForeignTransaction = postgresPrepareForeignTransaction;
+	routine->SendPrepareForeignTransaction = postgresSendPrepareForeignTransaction;
+	routine->WaitPrepareForeignTransaction = postgresWaitPrepareForeignTransaction;
+	routine->SendCommitForeignTransaction = postgresSendCommitForeignTransaction;
+	routine->WaitCommitForeignTransaction = postgresWaitCommitForeignTransaction;
+	routine->SendRollbackForeignTransaction = postgresSendRollbackForeignTransaction;
+	routine->WaitRollbackForeignTransaction = postgresWaitRollbackForeignTransaction;
 
 	/* Global CSN snapshot functions */
 	routine->PrepareForeignCSNSnapshot = postgresPrepareForeignCSNSnapshot;
-	routine->AssignGlobalCSN = postgresAssignGlobalCSN;
+	routine->SendPrepareForeignCSNSnapshot = postgresSendPrepareForeignCSNSnapshot;
+	routine->WaitPrepareForeignCSNSnapshot = postgresWaitPrepareForeignCSNSnapshot;
+
+	/* Support functions for asynchronous execution */
+	routine->IsForeignPathAsyncCapable = postgresIsForeignPathAsyncCapable;
+	routine->ForeignAsyncRequest = postgresForeignAsyncRequest;
+	routine->ForeignAsyncConfigureWait = postgresForeignAsyncConfigureWait;
+	routine->ForeignAsyncNotify = postgresForeignAsyncNotify;
 
 	PG_RETURN_POINTER(routine);
 }
@@ -610,6 +699,8 @@ postgresGetForeignRelSize(PlannerInfo *root,
 	fpinfo->fdw_tuple_cost = DEFAULT_FDW_TUPLE_COST;
 	fpinfo->shippable_extensions = NIL;
 	fpinfo->fetch_size = 100;
+	fpinfo->async_capable = false;
+	fpinfo->prefetch = false;
 
 	apply_server_options(fpinfo);
 	apply_table_options(fpinfo);
@@ -1369,9 +1460,10 @@ postgresGetForeignPlan(PlannerInfo *root,
 	 * Build the fdw_private list that will be available to the executor.
 	 * Items in the list must match order in enum FdwScanPrivateIndex.
 	 */
-	fdw_private = list_make3(makeString(sql.data),
+	fdw_private = list_make4(makeString(sql.data),
 							 retrieved_attrs,
-							 makeInteger(fpinfo->fetch_size));
+							 makeInteger(fpinfo->fetch_size),
+							 makeInteger(fpinfo->prefetch));
 	if (IS_JOIN_REL(foreignrel) || IS_UPPER_REL(foreignrel))
 		fdw_private = lappend(fdw_private,
 							  makeString(fpinfo->relation_name));
@@ -1443,7 +1535,7 @@ postgresBeginForeignScan(ForeignScanState *node, int eflags)
 	 * Get connection to the foreign server.  Connection manager will
 	 * establish new connection if necessary.
 	 */
-	fsstate->conn = GetConnection(user, false);
+	fsstate->conn = GetConnection(user, false, &fsstate->conn_state);
 
 	/* Assign a unique ID for my cursor */
 	fsstate->cursor_number = GetCursorNumber(fsstate->conn);
@@ -1456,6 +1548,8 @@ postgresBeginForeignScan(ForeignScanState *node, int eflags)
 												 FdwScanPrivateRetrievedAttrs);
 	fsstate->fetch_size = intVal(list_nth(fsplan->fdw_private,
 										  FdwScanPrivateFetchSize));
+	fsstate->prefetch = intVal(list_nth(fsplan->fdw_private,
+										FdwScanPrivatePrefetch));
 
 	/* Create contexts for batches of tuples and per-tuple temp workspace. */
 	fsstate->batch_cxt = AllocSetContextCreate(estate->es_query_cxt,
@@ -1464,6 +1558,10 @@ postgresBeginForeignScan(ForeignScanState *node, int eflags)
 	fsstate->temp_cxt = AllocSetContextCreate(estate->es_query_cxt,
 											  "postgres_fdw temporary data",
 											  ALLOCSET_SMALL_SIZES);
+	if (fsstate->prefetch)
+		fsstate->prefetch_cxt = AllocSetContextCreate(estate->es_query_cxt,
+													  "postgres_fdw prefetched tuple data",
+													  ALLOCSET_DEFAULT_SIZES);
 
 	/*
 	 * Get info we'll need for converting data fetched from the foreign server
@@ -1482,6 +1580,11 @@ postgresBeginForeignScan(ForeignScanState *node, int eflags)
 
 	fsstate->attinmeta = TupleDescGetAttInMetadata(fsstate->tupdesc);
 
+	/* Fetch the results in binary format, if we can. */
+	fsstate->attrecvfuncs = prepare_binary_transfer(GetForeignServer(table->serverid),
+													fsstate->tupdesc,
+													fsstate->retrieved_attrs);
+
 	/*
 	 * Prepare for processing of parameters used in remote query, if any.
 	 */
@@ -1494,6 +1597,13 @@ postgresBeginForeignScan(ForeignScanState *node, int eflags)
 							 &fsstate->param_flinfo,
 							 &fsstate->param_exprs,
 							 &fsstate->param_values);
+
+	/* Set the async-capable flag */
+	fsstate->async_capable = node->ss.ps.async_capable;
+
+	/* Asynchronous execution already overlaps fetches with other work */
+	if (fsstate->async_capable)
+		fsstate->prefetch = false;
 }
 
 /*
@@ -1508,8 +1618,10 @@ postgresIterateForeignScan(ForeignScanState *node)
 	TupleTableSlot *slot = node->ss.ss_ScanTupleSlot;
 
 	/*
-	 * If this is the first call after Begin or ReScan, we need to create the
-	 * cursor on the remote side.
+	 * In sync mode, if this is the first call after Begin or ReScan, we need
+	 * to create the cursor on the remote side.  In async mode, we would have
+	 * already created the cursor before we get here, even if this is the
+	 * first call after Begin or ReScan.
 	 */
 	if (!fsstate->cursor_exists)
 		create_cursor(node);
@@ -1519,6 +1631,9 @@ postgresIterateForeignScan(ForeignScanState *node)
 	 */
 	if (fsstate->next_tuple >= fsstate->num_tuples)
 	{
+		/* In async mode, just clear tuple slot. */
+		if (fsstate->async_capable)
+			return ExecClearTuple(slot);
 		/* No point in another fetch if we already detected EOF, though. */
 		if (!fsstate->eof_reached)
 			fetch_more_data(node);
@@ -1552,6 +1667,18 @@ postgresReScanForeignScan(ForeignScanState *node)
 	if (!fsstate->cursor_exists)
 		return;
 
+	/*
+	 * If the node is async-capable, and an asynchronous fetch for it has
+	 * begun, the asynchronous fetch might not have yet completed.  Check if
+	 * the node is async-capable, and an asynchronous fetch for it is still in
+	 * progress; if so, complete the asynchronous fetch before restarting the
+	 * scan.
+	 */
+	if (fsstate->async_capable &&
+		fsstate->conn_state->pendingAreq &&
+		fsstate->conn_state->pendingAreq->requestee == (PlanState *) node)
+		fetch_more_data(node);
+
 	/*
 	 * If any internal parameters affecting this node have changed, we'd
 	 * better destroy and recreate the cursor.  Otherwise, rewinding it should
@@ -1580,17 +1707,23 @@ postgresReScanForeignScan(ForeignScanState *node)
 	 * We don't use a PG_TRY block here, so be careful not to throw error
 	 * without releasing the PGresult.
 	 */
-	res = pgfdw_exec_query(fsstate->conn, sql);
+	res = pgfdw_exec_query(fsstate->conn, sql, fsstate->conn_state);
 	if (PQresultStatus(res) != PGRES_COMMAND_OK)
 		pgfdw_report_error(ERROR, res, fsstate->conn, true, sql);
 	PQclear(res);
 
-	/* Now force a fresh FETCH. */
+	/*
+	 * Now force a fresh FETCH.  Any batch we prefetched was collected above
+	 * and is stale now.
+	 */
 	fsstate->tuples = NULL;
 	fsstate->num_tuples = 0;
 	fsstate->next_tuple = 0;
 	fsstate->fetch_ct_2 = 0;
 	fsstate->eof_reached = false;
+	fsstate->prefetched_tuples = NULL;
+	fsstate->num_prefetched = 0;
+	fsstate->prefetch_ready = false;
 }
 
 /*
@@ -1606,9 +1739,14 @@ postgresEndForeignScan(ForeignScanState *node)
 	if (fsstate == NULL)
 		return;
 
-	/* Close the cursor if open, to prevent accumulation of cursors */
+	/*
+	 * Close the cursor if open, to prevent accumulation of cursors.  That
+	 * also collects a prefetching FETCH we may have left in flight.
+	 */
 	if (fsstate->cursor_exists)
-		close_cursor(fsstate->conn, fsstate->cursor_number);
+		close_cursor(fsstate->conn, fsstate->cursor_number,
+					 fsstate->conn_state);
+	Assert(fsstate->conn_state->pendingFetch != node);
 
 	/* Release remote connection */
 	ReleaseConnection(fsstate->conn);
@@ -1673,6 +1811,7 @@ postgresPlanForeignModify(PlannerInfo *root,
 	List	   *returningList = NIL;
 	List	   *retrieved_attrs = NIL;
 	bool		doNothing = false;
+	int			values_end_len = -1;
 
 	initStringInfo(&sql);
 
@@ -1760,7 +1899,7 @@ postgresPlanForeignModify(PlannerInfo *root,
 			deparseInsertSql(&sql, rte, resultRelation, rel,
 							 targetAttrs, doNothing,
 							 withCheckOptionList, returningList,
-							 &retrieved_attrs);
+							 &retrieved_attrs, &values_end_len);
 			break;
 		case CMD_UPDATE:
 			deparseUpdateSql(&sql, rte, resultRelation, rel,
@@ -1784,8 +1923,9 @@ postgresPlanForeignModify(PlannerInfo *root,
 	 * Build the fdw_private list that will be available to the executor.
 	 * Items in the list must match enum FdwModifyPrivateIndex, above.
 	 */
-	return list_make4(makeString(sql.data),
+	return list_make5(makeString(sql.data),
 					  targetAttrs,
+					  makeInteger(values_end_len),
 					  makeInteger((retrieved_attrs != NIL)),
 					  retrieved_attrs);
 }
@@ -1805,6 +1945,7 @@ postgresBeginForeignModify(ModifyTableState *mtstate,
 	char	   *query;
 	List	   *target_attrs;
 	bool		has_returning;
+	int			values_end_len;
 	List	   *retrieved_attrs;
 	RangeTblEntry *rte;
 
@@ -1820,6 +1961,8 @@ postgresBeginForeignModify(ModifyTableState *mtstate,
 							FdwModifyPrivateUpdateSql));
 	target_attrs = (List *) list_nth(fdw_private,
 									 FdwModifyPrivateTargetAttnums);
+	values_end_len = intVal(list_nth(fdw_private,
+									 FdwModifyPrivateLen));
 	has_returning = intVal(list_nth(fdw_private,
 									FdwModifyPrivateHasReturning));
 	retrieved_attrs = (List *) list_nth(fdw_private,
@@ -1837,9 +1980,19 @@ postgresBeginForeignModify(ModifyTableState *mtstate,
 									mtstate->mt_plans[subplan_index]->plan,
 									query,
 									target_attrs,
+									values_end_len,
 									has_returning,
 									retrieved_attrs);
 
+	/* Send batches of rows with COPY, if asked to. */
+	if (mtstate->operation == CMD_INSERT)
+	{
+		ModifyTable *plan = castNode(ModifyTable, mtstate->ps.plan);
+
+		init_remote_copy(fmstate, rte, resultRelInfo->ri_RangeTableIndex,
+						 plan->onConflictAction == ONCONFLICT_NOTHING);
+	}
+
 	resultRelInfo->ri_FdwState = fmstate;
 }
 
@@ -1854,7 +2007,8 @@ postgresExecForeignInsert(EState *estate,
 						  TupleTableSlot *planSlot)
 {
 	PgFdwModifyState *fmstate = (PgFdwModifyState *) resultRelInfo->ri_FdwState;
-	TupleTableSlot *rslot;
+	TupleTableSlot **rslot;
+	int			numSlots = 1;
 
 	/*
 	 * If the fmstate has aux_fmstate set, use the aux_fmstate (see
@@ -1863,7 +2017,40 @@ postgresExecForeignInsert(EState *estate,
 	if (fmstate->aux_fmstate)
 		resultRelInfo->ri_FdwState = fmstate->aux_fmstate;
 	rslot = execute_foreign_modify(estate, resultRelInfo, CMD_INSERT,
-								   slot, planSlot);
+								   &slot, &planSlot, &numSlots);
+	/* Revert that change */
+	if (fmstate->aux_fmstate)
+		resultRelInfo->ri_FdwState = fmstate;
+
+	return rslot ? *rslot : NULL;
+}
+
+/*
+ * postgresExecForeignBatchInsert
+ *		Insert multiple rows into a foreign table
+ */
+static TupleTableSlot **
+postgresExecForeignBatchInsert(EState *estate,
+							   ResultRelInfo *resultRelInfo,
+							   TupleTableSlot **slots,
+							   TupleTableSlot **planSlots,
+							   int *numSlots)
+{
+	PgFdwModifyState *fmstate = (PgFdwModifyState *) resultRelInfo->ri_FdwState;
+	TupleTableSlot **rslot;
+
+	/*
+	 * If the fmstate has aux_fmstate set, use the aux_fmstate (see
+	 * postgresBeginForeignInsert())
+	 */
+	if (fmstate->aux_fmstate)
+		resultRelInfo->ri_FdwState = fmstate->aux_fmstate;
+	if (((PgFdwModifyState *) resultRelInfo->ri_FdwState)->copy_query)
+		rslot = execute_foreign_copy(resultRelInfo->ri_FdwState,
+									 slots, numSlots);
+	else
+		rslot = execute_foreign_modify(estate, resultRelInfo, CMD_INSERT,
+									   slots, planSlots, numSlots);
 	/* Revert that change */
 	if (fmstate->aux_fmstate)
 		resultRelInfo->ri_FdwState = fmstate;
@@ -1871,6 +2058,79 @@ postgresExecForeignInsert(EState *estate,
 	return rslot;
 }
 
+/*
+ * postgresGetForeignModifyBatchSize
+ *		Determine the maximum number of tuples that can be inserted in bulk
+ *
+ * Returns the batch size specified for server or table. When batching is not
+ * allowed (e.g. for tables with AFTER ROW triggers or with RETURNING clause),
+ * returns 1.
+ */
+static int
+postgresGetForeignModifyBatchSize(ResultRelInfo *resultRelInfo)
+{
+	int			batch_size;
+	PgFdwModifyState *fmstate = resultRelInfo->ri_FdwState ?
+	(PgFdwModifyState *) resultRelInfo->ri_FdwState :
+	NULL;
+
+	/* should be called only once */
+	Assert(resultRelInfo->ri_BatchSize == 0);
+
+	/*
+	 * Should never get called when the insert is being performed as part of
+	 * a row movement operation.
+	 */
+	Assert(fmstate == NULL || fmstate->aux_fmstate == NULL);
+
+	/*
+	 * In EXPLAIN without ANALYZE, ri_fdwstate is NULL, so we have to lookup
+	 * the option directly in server/table options. Otherwise just use the
+	 * value we determined earlier.
+	 */
+	if (fmstate)
+		batch_size = fmstate->batch_size;
+	else
+		batch_size = get_batch_size_option(resultRelInfo->ri_RelationDesc);
+
+	/*
+	 * Disable batching when we have to use RETURNING, there are any
+	 * BEFORE/AFTER ROW INSERT triggers on the foreign table, or there are any
+	 * WITH CHECK OPTION constraints from parent views.
+	 *
+	 * When there are any BEFORE ROW INSERT triggers on the table, we can't
+	 * support it, because such triggers might query the table we're inserting
+	 * into and act differently if the tuples that have already been processed
+	 * and prepared for insertion are not there.
+	 */
+	if (resultRelInfo->ri_projectReturning != NULL ||
+		resultRelInfo->ri_WithCheckOptions != NIL ||
+		(resultRelInfo->ri_TrigDesc &&
+		 (resultRelInfo->ri_TrigDesc->trig_insert_before_row ||
+		  resultRelInfo->ri_TrigDesc->trig_insert_after_row)))
+		return 1;
+
+	/*
+	 * If the foreign table has no columns, disable batching as the INSERT
+	 * syntax doesn't allow batching multiple empty rows into a zero-column
+	 * table in a single statement.  This is needed for COPY FROM, in which
+	 * case fmstate must be non-NULL.
+	 */
+	if (fmstate && list_length(fmstate->target_attrs) == 0)
+		return 1;
+
+	/*
+	 * Otherwise use the batch size specified for server/table. The number of
+	 * parameters in a batch is limited to 65535 (uint16), so make sure we
+	 * don't exceed this limit by using the maximum batch_size possible.
+	 * Batches sent with COPY carry no parameters, so they aren't limited.
+	 */
+	if (fmstate && fmstate->copy_query == NULL && fmstate->p_nums > 0)
+		batch_size = Min(batch_size, PQ_QUERY_PARAM_MAX_LIMIT / fmstate->p_nums);
+
+	return batch_size;
+}
+
 /*
  * postgresExecForeignUpdate
  *		Update one row in a foreign table
@@ -1881,8 +2141,13 @@ postgresExecForeignUpdate(EState *estate,
 						  TupleTableSlot *slot,
 						  TupleTableSlot *planSlot)
 {
-	return execute_foreign_modify(estate, resultRelInfo, CMD_UPDATE,
-								  slot, planSlot);
+	TupleTableSlot **rslot;
+	int			numSlots = 1;
+
+	rslot = execute_foreign_modify(estate, resultRelInfo, CMD_UPDATE,
+								   &slot, &planSlot, &numSlots);
+
+	return rslot ? rslot[0] : NULL;
 }
 
 /*
@@ -1895,8 +2160,13 @@ postgresExecForeignDelete(EState *estate,
 						  TupleTableSlot *slot,
 						  TupleTableSlot *planSlot)
 {
-	return execute_foreign_modify(estate, resultRelInfo, CMD_DELETE,
-								  slot, planSlot);
+	TupleTableSlot **rslot;
+	int			numSlots = 1;
+
+	rslot = execute_foreign_modify(estate, resultRelInfo, CMD_DELETE,
+								   &slot, &planSlot, &numSlots);
+
+	return rslot ? rslot[0] : NULL;
 }
 
 /*
@@ -1937,6 +2207,7 @@ postgresBeginForeignInsert(ModifyTableState *mtstate,
 	List	   *targetAttrs = NIL;
 	List	   *retrieved_attrs = NIL;
 	bool		doNothing = false;
+	int			values_end_len;
 
 	/*
 	 * If the foreign table we are about to insert routed rows into is also an
@@ -2009,7 +2280,7 @@ postgresBeginForeignInsert(ModifyTableState *mtstate,
 	deparseInsertSql(&sql, rte, resultRelation, rel, targetAttrs, doNothing,
 					 resultRelInfo->ri_WithCheckOptions,
 					 resultRelInfo->ri_returningList,
-					 &retrieved_attrs);
+					 &retrieved_attrs, &values_end_len);
 
 	/* Construct an execution state. */
 	fmstate = create_foreign_modify(mtstate->ps.state,
@@ -2019,9 +2290,13 @@ postgresBeginForeignInsert(ModifyTableState *mtstate,
 									NULL,
 									sql.data,
 									targetAttrs,
+									values_end_len,
 									retrieved_attrs != NIL,
 									retrieved_attrs);
 
+	/* Send batches of rows with COPY, if asked to. */
+	init_remote_copy(fmstate, rte, resultRelation, doNothing);
+
 	/*
 	 * If the given resultRelInfo already has PgFdwModifyState set, it means
 	 * the foreign table is an UPDATE subplan result rel; in which case, store
@@ -2382,7 +2657,7 @@ postgresBeginDirectModify(ForeignScanState *node, int eflags)
 	 * Get connection to the foreign server.  Connection manager will
 	 * establish new connection if necessary.
 	 */
-	dmstate->conn = GetConnection(user, false);
+	dmstate->conn = GetConnection(user, false, &dmstate->conn_state);
 	MarkConnectionModified(user);
 
 	/* Update the foreign-join-related fields. */
@@ -2645,6 +2920,13 @@ postgresExplainForeignModify(ModifyTableState *mtstate,
 										  FdwModifyPrivateUpdateSql));
 
 		ExplainPropertyText("Remote SQL", sql, es);
+
+		/*
+		 * Show the batch size only if INSERT actually batches; UPDATE and
+		 * DELETE never do.
+		 */
+		if (rinfo->ri_BatchSize > 1)
+			ExplainPropertyInteger("Batch Size", NULL, rinfo->ri_BatchSize, es);
 	}
 }
 
@@ -2757,7 +3039,7 @@ estimate_path_cost_size(PlannerInfo *root,
 								false, &retrieved_attrs, NULL);
 
 		/* Get the remote estimate */
-		conn = GetConnection(fpinfo->user, false);
+		conn = GetConnection(fpinfo->user, false, NULL);
 		get_remote_estimate(sql.data, conn, &rows, &width,
 							&startup_cost, &total_cost);
 		ReleaseConnection(conn);
@@ -3212,7 +3494,7 @@ get_remote_estimate(const char *sql, PGconn *conn,
 		/*
 		 * Execute EXPLAIN remotely.
 		 */
-		res = pgfdw_exec_query(conn, sql);
+		res = pgfdw_exec_query(conn, sql, NULL);
 		if (PQresultStatus(res) != PGRES_TUPLES_OK)
 			pgfdw_report_error(ERROR, res, conn, false, sql);
 
@@ -3336,6 +3618,9 @@ create_cursor(ForeignScanState *node)
 	StringInfoData buf;
 	PGresult   *res;
 
+	/* First, complete any request still in flight on the connection. */
+	process_pending_requests(fsstate->conn_state);
+
 	/*
 	 * Construct array of query parameter values in text format.  We do the
 	 * conversions in the short-lived per-tuple context, so as not to cause a
@@ -3401,8 +3686,17 @@ static void
 fetch_more_data(ForeignScanState *node)
 {
 	PgFdwScanState *fsstate = (PgFdwScanState *) node->fdw_state;
+	PgFdwConnState *conn_state = fsstate->conn_state;
 	PGresult   *volatile res = NULL;
 	MemoryContext oldcontext;
+	int			numrows;
+
+	/*
+	 * If a prefetching FETCH for this scan is still in flight, collect its
+	 * result now; that leaves it waiting in prefetch_cxt.
+	 */
+	if (conn_state->pendingFetch == node)
+		process_pending_fetch(node);
 
 	/*
 	 * We'll store the tuples in the batch_cxt.  First, flush the previous
@@ -3410,49 +3704,183 @@ fetch_more_data(ForeignScanState *node)
 	 */
 	fsstate->tuples = NULL;
 	MemoryContextReset(fsstate->batch_cxt);
-	oldcontext = MemoryContextSwitchTo(fsstate->batch_cxt);
 
-	/* PGresult must be released before leaving this function. */
-	PG_TRY();
+	if (fsstate->prefetch_ready)
+	{
+		MemoryContext tmpcxt = fsstate->batch_cxt;
+
+		/* Just swap in the batch we prefetched. */
+		fsstate->batch_cxt = fsstate->prefetch_cxt;
+		fsstate->prefetch_cxt = tmpcxt;
+		fsstate->tuples = fsstate->prefetched_tuples;
+		fsstate->num_tuples = numrows = fsstate->num_prefetched;
+		fsstate->next_tuple = 0;
+		fsstate->prefetched_tuples = NULL;
+		fsstate->num_prefetched = 0;
+		fsstate->prefetch_ready = false;
+	}
+	else
+	{
+		oldcontext = MemoryContextSwitchTo(fsstate->batch_cxt);
+
+		/* PGresult must be released before leaving this function. */
+		PG_TRY();
+		{
+			PGconn	   *conn = fsstate->conn;
+			char		sql[64];
+
+			snprintf(sql, sizeof(sql), "FETCH %d FROM c%u",
+					 fsstate->fetch_size, fsstate->cursor_number);
+
+			if (fsstate->async_capable)
+			{
+				Assert(conn_state->pendingAreq);
+
+				/*
+				 * The query was already sent by an earlier call to
+				 * fetch_more_data_begin.  So now we just fetch the result.
+				 */
+				res = pgfdw_get_result(conn, sql);
+				/* On error, report the original query, not the FETCH. */
+				if (PQresultStatus(res) != PGRES_TUPLES_OK)
+					pgfdw_report_error(ERROR, res, conn, false, fsstate->query);
+
+				/* Reset per-connection state */
+				conn_state->pendingAreq = NULL;
+			}
+			else
+			{
+				process_pending_requests(conn_state);
+				send_fetch(fsstate, sql);
+				res = pgfdw_get_result(conn, sql);
+				/* On error, report the original query, not the FETCH. */
+				if (PQresultStatus(res) != PGRES_TUPLES_OK)
+					pgfdw_report_error(ERROR, res, conn, false, fsstate->query);
+			}
+
+			/*
+			 * The first result, which is always in text, tells us which types
+			 * the remote server actually sends.  Switch the following FETCHes
+			 * to binary if they are the ones we'd decode them as, and forget
+			 * about binary transfer otherwise.
+			 */
+			if (fsstate->attrecvfuncs && !fsstate->fetch_binary)
+			{
+				if (binary_result_types_match(fsstate, res))
+					fsstate->fetch_binary = true;
+				else
+				{
+					pfree(fsstate->attrecvfuncs);
+					fsstate->attrecvfuncs = NULL;
+				}
+			}
+
+			/* Convert the data into HeapTuples */
+			fsstate->tuples = make_tuples_from_result(node, res);
+			fsstate->num_tuples = numrows = PQntuples(res);
+			fsstate->next_tuple = 0;
+		}
+		PG_FINALLY();
+		{
+			if (res)
+				PQclear(res);
+		}
+		PG_END_TRY();
+
+		MemoryContextSwitchTo(oldcontext);
+	}
+
+	/* Update fetch_ct_2 */
+	if (fsstate->fetch_ct_2 < 2)
+		fsstate->fetch_ct_2++;
+
+	/* Must be EOF if we didn't get as many tuples as we asked for. */
+	fsstate->eof_reached = (numrows < fsstate->fetch_size);
+
+	/*
+	 * If requested, send the FETCH for the next batch right away, so that
+	 * the remote server produces it while we consume this one.  We can do
+	 * that only if nothing else is in flight on the connection.
+	 */
+	if (fsstate->prefetch && !fsstate->eof_reached &&
+		!conn_state->pendingAreq && !conn_state->pendingFetch)
 	{
-		PGconn	   *conn = fsstate->conn;
 		char		sql[64];
-		int			numrows;
-		int			i;
 
 		snprintf(sql, sizeof(sql), "FETCH %d FROM c%u",
 				 fsstate->fetch_size, fsstate->cursor_number);
 
-		res = pgfdw_exec_query(conn, sql);
-		/* On error, report the original query, not the FETCH. */
-		if (PQresultStatus(res) != PGRES_TUPLES_OK)
-			pgfdw_report_error(ERROR, res, conn, false, fsstate->query);
+		send_fetch(fsstate, sql);
 
-		/* Convert the data into HeapTuples */
-		numrows = PQntuples(res);
-		fsstate->tuples = (HeapTuple *) palloc0(numrows * sizeof(HeapTuple));
-		fsstate->num_tuples = numrows;
-		fsstate->next_tuple = 0;
+		/* Remember that the FETCH is in process */
+		conn_state->pendingFetch = node;
+	}
+}
 
-		for (i = 0; i < numrows; i++)
-		{
-			Assert(IsA(node->ss.ps.plan, ForeignScan));
-
-			fsstate->tuples[i] =
-				make_tuple_from_result_row(res, i,
-										   fsstate->rel,
-										   fsstate->attinmeta,
-										   fsstate->retrieved_attrs,
-										   node,
-										   fsstate->temp_cxt);
-		}
+/*
+ * Convert the rows of a FETCH result into an array of HeapTuples, allocated
+ * in the current memory context.
+ */
+static HeapTuple *
+make_tuples_from_result(ForeignScanState *node, PGresult *res)
+{
+	PgFdwScanState *fsstate = (PgFdwScanState *) node->fdw_state;
+	int			numrows = PQntuples(res);
+	HeapTuple  *tuples;
+	int			i;
+
+	tuples = (HeapTuple *) palloc0(numrows * sizeof(HeapTuple));
+
+	for (i = 0; i < numrows; i++)
+	{
+		Assert(IsA(node->ss.ps.plan, ForeignScan));
+
+		tuples[i] =
+			make_tuple_from_result_row(res, i,
+									   fsstate->rel,
+									   fsstate->attinmeta,
+									   PQbinaryTuples(res) ?
+									   fsstate->attrecvfuncs : NULL,
+									   fsstate->retrieved_attrs,
+									   node,
+									   fsstate->temp_cxt);
+	}
+
+	return tuples;
+}
 
-		/* Update fetch_ct_2 */
-		if (fsstate->fetch_ct_2 < 2)
-			fsstate->fetch_ct_2++;
+/*
+ * Collect the result of the prefetching FETCH sent for node, and keep the
+ * converted rows in its prefetch_cxt until fetch_more_data wants them.
+ */
+static void
+process_pending_fetch(ForeignScanState *node)
+{
+	PgFdwScanState *fsstate = (PgFdwScanState *) node->fdw_state;
+	PGresult   *volatile res = NULL;
+	MemoryContext oldcontext;
+
+	Assert(fsstate->conn_state->pendingFetch == node);
+	Assert(!fsstate->prefetch_ready);
+
+	/* Whatever happens below, the FETCH is no longer in flight. */
+	fsstate->conn_state->pendingFetch = NULL;
+
+	MemoryContextReset(fsstate->prefetch_cxt);
+	oldcontext = MemoryContextSwitchTo(fsstate->prefetch_cxt);
+
+	/* PGresult must be released before leaving this function. */
+	PG_TRY();
+	{
+		res = pgfdw_get_result(fsstate->conn, fsstate->query);
+		/* On error, report the original query, not the FETCH. */
+		if (PQresultStatus(res) != PGRES_TUPLES_OK)
+			pgfdw_report_error(ERROR, res, fsstate->conn, false,
+							   fsstate->query);
 
-		/* Must be EOF if we didn't get as many tuples as we asked for. */
-		fsstate->eof_reached = (numrows < fsstate->fetch_size);
+		fsstate->prefetched_tuples = make_tuples_from_result(node, res);
+		fsstate->num_prefetched = PQntuples(res);
+		fsstate->prefetch_ready = true;
 	}
 	PG_FINALLY();
 	{
@@ -3464,6 +3892,19 @@ fetch_more_data(ForeignScanState *node)
 	MemoryContextSwitchTo(oldcontext);
 }
 
+/*
+ * Complete whatever is in flight on a connection, so that another query can
+ * be sent on it.
+ */
+void
+process_pending_requests(PgFdwConnState *state)
+{
+	if (state->pendingAreq)
+		process_pending_request(state->pendingAreq);
+	if (state->pendingFetch)
+		process_pending_fetch(state->pendingFetch);
+}
+
 /*
  * Force assorted GUC parameters to settings that ensure that we'll output
  * data values in a form that is unambiguous to the remote server.
@@ -3518,7 +3959,8 @@ reset_transmission_modes(int nestlevel)
  * Utility routine to close a cursor.
  */
 static void
-close_cursor(PGconn *conn, unsigned int cursor_number)
+close_cursor(PGconn *conn, unsigned int cursor_number,
+			 PgFdwConnState *conn_state)
 {
 	char		sql[64];
 	PGresult   *res;
@@ -3529,7 +3971,7 @@ close_cursor(PGconn *conn, unsigned int cursor_number)
 	 * We don't use a PG_TRY block here, so be careful not to throw error
 	 * without releasing the PGresult.
 	 */
-	res = pgfdw_exec_query(conn, sql);
+	res = pgfdw_exec_query(conn, sql, conn_state);
 	if (PQresultStatus(res) != PGRES_COMMAND_OK)
 		pgfdw_report_error(ERROR, res, conn, true, sql);
 	PQclear(res);
@@ -3548,6 +3990,7 @@ create_foreign_modify(EState *estate,
 					  Plan *subplan,
 					  char *query,
 					  List *target_attrs,
+					  int values_end,
 					  bool has_returning,
 					  List *retrieved_attrs)
 {
@@ -3577,13 +4020,19 @@ create_foreign_modify(EState *estate,
 	user = GetUserMapping(userid, table->serverid);
 
 	/* Open connection; report that we'll create a prepared statement. */
-	fmstate->conn = GetConnection(user, true);
+	fmstate->conn = GetConnection(user, true, &fmstate->conn_state);
 	MarkConnectionModified(user);
 	fmstate->p_name = NULL;		/* prepared statement not made yet */
 
 	/* Set up remote query information. */
 	fmstate->query = query;
+	if (operation == CMD_INSERT)
+	{
+		fmstate->query = pstrdup(fmstate->query);
+		fmstate->orig_query = pstrdup(fmstate->query);
+	}
 	fmstate->target_attrs = target_attrs;
+	fmstate->values_end = values_end;
 	fmstate->has_returning = has_returning;
 	fmstate->retrieved_attrs = retrieved_attrs;
 
@@ -3635,6 +4084,14 @@ create_foreign_modify(EState *estate,
 
 	Assert(fmstate->p_nums <= n_params);
 
+	/* Set batch_size from foreign server/table options. */
+	if (operation == CMD_INSERT)
+		fmstate->batch_size = get_batch_size_option(rel);
+	else
+		fmstate->batch_size = 1;
+
+	fmstate->num_slots = 1;
+
 	/* Initialize auxiliary state */
 	fmstate->aux_fmstate = NULL;
 
@@ -3645,26 +4102,48 @@ create_foreign_modify(EState *estate,
  * execute_foreign_modify
  *		Perform foreign-table modification as required, and fetch RETURNING
  *		result if any.  (This is the shared guts of postgresExecForeignInsert,
+ *		postgresExecForeignBatchInsert,
  *		postgresExecForeignUpdate, and postgresExecForeignDelete.)
  */
-static TupleTableSlot *
+static TupleTableSlot **
 execute_foreign_modify(EState *estate,
 					   ResultRelInfo *resultRelInfo,
 					   CmdType operation,
-					   TupleTableSlot *slot,
-					   TupleTableSlot *planSlot)
+					   TupleTableSlot **slots,
+					   TupleTableSlot **planSlots,
+					   int *numSlots)
 {
 	PgFdwModifyState *fmstate = (PgFdwModifyState *) resultRelInfo->ri_FdwState;
 	ItemPointer ctid = NULL;
 	const char **p_values;
 	PGresult   *res;
 	int			n_rows;
+	StringInfoData sql;
 
 	/* The operation should be INSERT, UPDATE, or DELETE */
 	Assert(operation == CMD_INSERT ||
 		   operation == CMD_UPDATE ||
 		   operation == CMD_DELETE);
 
+	/*
+	 * If the existing query was deparsed and prepared for a different number
+	 * of rows, rebuild it for the proper number.
+	 */
+	if (operation == CMD_INSERT && fmstate->num_slots != *numSlots)
+	{
+		/* Destroy the prepared statement created previously */
+		if (fmstate->p_name)
+			deallocate_query(fmstate);
+
+		/* Build INSERT string with numSlots records in its VALUES clause. */
+		initStringInfo(&sql);
+		rebuildInsertSql(&sql, fmstate->orig_query, fmstate->values_end,
+						 fmstate->p_nums, *numSlots - 1);
+		pfree(fmstate->query);
+		fmstate->query = sql.data;
+		fmstate->num_slots = *numSlots;
+	}
+
 	/* Set up the prepared statement on the remote server, if we didn't yet */
 	if (!fmstate->p_name)
 		prepare_foreign_modify(fmstate);
@@ -3677,7 +4156,7 @@ execute_foreign_modify(EState *estate,
 		Datum		datum;
 		bool		isNull;
 
-		datum = ExecGetJunkAttribute(planSlot,
+		datum = ExecGetJunkAttribute(planSlots[0],
 									 fmstate->ctidAttno,
 									 &isNull);
 		/* shouldn't ever get a null result... */
@@ -3687,14 +4166,17 @@ execute_foreign_modify(EState *estate,
 	}
 
 	/* Convert parameters needed by prepared statement to text form */
-	p_values = convert_prep_stmt_params(fmstate, ctid, slot);
+	p_values = convert_prep_stmt_params(fmstate, ctid, slots, *numSlots);
+
+	/* First, complete any request still in flight on the connection. */
+	process_pending_requests(fmstate->conn_state);
 
 	/*
 	 * Execute the prepared statement.
 	 */
 	if (!PQsendQueryPrepared(fmstate->conn,
 							 fmstate->p_name,
-							 fmstate->p_nums,
+							 fmstate->p_nums * (*numSlots),
 							 p_values,
 							 NULL,
 							 NULL,
@@ -3715,9 +4197,10 @@ execute_foreign_modify(EState *estate,
 	/* Check number of rows affected, and fetch RETURNING tuple if any */
 	if (fmstate->has_returning)
 	{
+		Assert(*numSlots == 1);
 		n_rows = PQntuples(res);
 		if (n_rows > 0)
-			store_returning_result(fmstate, slot, res);
+			store_returning_result(fmstate, slots[0], res);
 	}
 	else
 		n_rows = atoi(PQcmdTuples(res));
@@ -3727,10 +4210,12 @@ execute_foreign_modify(EState *estate,
 
 	MemoryContextReset(fmstate->temp_cxt);
 
+	*numSlots = n_rows;
+
 	/*
 	 * Return NULL if nothing was inserted/updated/deleted on the remote end
 	 */
-	return (n_rows > 0) ? slot : NULL;
+	return (n_rows > 0) ? slots : NULL;
 }
 
 /*
@@ -3744,6 +4229,9 @@ prepare_foreign_modify(PgFdwModifyState *fmstate)
 	char	   *p_name;
 	PGresult   *res;
 
+	/* First, complete any request still in flight on the connection. */
+	process_pending_requests(fmstate->conn_state);
+
 	/* Construct name we'll use for the prepared statement. */
 	snprintf(prep_name, sizeof(prep_name), "pgsql_fdw_prep_%u",
 			 GetPrepStmtNumber(fmstate->conn));
@@ -3790,52 +4278,64 @@ prepare_foreign_modify(PgFdwModifyState *fmstate)
 static const char **
 convert_prep_stmt_params(PgFdwModifyState *fmstate,
 						 ItemPointer tupleid,
-						 TupleTableSlot *slot)
+						 TupleTableSlot **slots,
+						 int numSlots)
 {
 	const char **p_values;
+	int			i;
+	int			j;
 	int			pindex = 0;
 	MemoryContext oldcontext;
 
 	oldcontext = MemoryContextSwitchTo(fmstate->temp_cxt);
 
-	p_values = (const char **) palloc(sizeof(char *) * fmstate->p_nums);
+	p_values = (const char **) palloc(sizeof(char *) * fmstate->p_nums * numSlots);
+
+	/* ctid is provided only for UPDATE/DELETE, which don't allow batching */
+	Assert(!(tupleid != NULL && numSlots > 1));
 
 	/* 1st parameter should be ctid, if it's in use */
 	if (tupleid != NULL)
 	{
+		Assert(numSlots == 1);
 		/* don't need set_transmission_modes for TID output */
 		p_values[pindex] = OutputFunctionCall(&fmstate->p_flinfo[pindex],
 											  PointerGetDatum(tupleid));
 		pindex++;
 	}
 
-	/* get following parameters from slot */
-	if (slot != NULL && fmstate->target_attrs != NIL)
+	/* get following parameters from slots */
+	if (slots != NULL && fmstate->target_attrs != NIL)
 	{
 		int			nestlevel;
 		ListCell   *lc;
 
 		nestlevel = set_transmission_modes();
 
-		foreach(lc, fmstate->target_attrs)
+		for (i = 0; i < numSlots; i++)
 		{
-			int			attnum = lfirst_int(lc);
-			Datum		value;
-			bool		isnull;
+			j = (tupleid != NULL) ? 1 : 0;
+			foreach(lc, fmstate->target_attrs)
+			{
+				int			attnum = lfirst_int(lc);
+				Datum		value;
+				bool		isnull;
 
-			value = slot_getattr(slot, attnum, &isnull);
-			if (isnull)
-				p_values[pindex] = NULL;
-			else
-				p_values[pindex] = OutputFunctionCall(&fmstate->p_flinfo[pindex],
-													  value);
-			pindex++;
+				value = slot_getattr(slots[i], attnum, &isnull);
+				if (isnull)
+					p_values[pindex] = NULL;
+				else
+					p_values[pindex] = OutputFunctionCall(&fmstate->p_flinfo[j],
+														  value);
+				pindex++;
+				j++;
+			}
 		}
 
 		reset_transmission_modes(nestlevel);
 	}
 
-	Assert(pindex == fmstate->p_nums);
+	Assert(pindex == fmstate->p_nums * numSlots);
 
 	MemoryContextSwitchTo(oldcontext);
 
@@ -3860,6 +4360,7 @@ store_returning_result(PgFdwModifyState *fmstate,
 		newtup = make_tuple_from_result_row(res, 0,
 											fmstate->rel,
 											fmstate->attinmeta,
+											NULL,
 											fmstate->retrieved_attrs,
 											NULL,
 											fmstate->temp_cxt);
@@ -3889,23 +4390,7 @@ finish_foreign_modify(PgFdwModifyState *fmstate)
 	Assert(fmstate != NULL);
 
 	/* If we created a prepared statement, destroy it */
-	if (fmstate->p_name)
-	{
-		char		sql[64];
-		PGresult   *res;
-
-		snprintf(sql, sizeof(sql), "DEALLOCATE %s", fmstate->p_name);
-
-		/*
-		 * We don't use a PG_TRY block here, so be careful not to throw error
-		 * without releasing the PGresult.
-		 */
-		res = pgfdw_exec_query(fmstate->conn, sql);
-		if (PQresultStatus(res) != PGRES_COMMAND_OK)
-			pgfdw_report_error(ERROR, res, fmstate->conn, true, sql);
-		PQclear(res);
-		fmstate->p_name = NULL;
-	}
+	deallocate_query(fmstate);
 
 	/* Release remote connection */
 	ReleaseConnection(fmstate->conn);
@@ -3913,44 +4398,211 @@ finish_foreign_modify(PgFdwModifyState *fmstate)
 }
 
 /*
- * build_remote_returning
- *		Build a RETURNING targetlist of a remote query for performing an
- *		UPDATE/DELETE .. RETURNING on a join directly
+ * init_remote_copy
+ *		Set up a modify state to send batches of rows with COPY FROM STDIN,
+ *		if the "use_remote_copy" option asks for it
+ *
+ * COPY doesn't support ON CONFLICT or RETURNING, nor can it insert rows
+ * without any columns, so plain INSERT is kept for those cases.  Batching
+ * is already disabled when there's RETURNING.
  */
-static List *
-build_remote_returning(Index rtindex, Relation rel, List *returningList)
+static void
+init_remote_copy(PgFdwModifyState *fmstate, RangeTblEntry *rte,
+				 Index rtindex, bool doNothing)
 {
-	bool		have_wholerow = false;
-	List	   *tlist = NIL;
-	List	   *vars;
-	ListCell   *lc;
+	DefElem    *def;
+	StringInfoData sql;
 
-	Assert(returningList);
+	def = get_insert_option(fmstate->rel, "use_remote_copy");
+	if (def == NULL || !defGetBoolean(def))
+		return;
 
-	vars = pull_var_clause((Node *) returningList, PVC_INCLUDE_PLACEHOLDERS);
+	if (doNothing || fmstate->has_returning || fmstate->target_attrs == NIL)
+		return;
 
-	/*
-	 * If there's a whole-row reference to the target relation, then we'll
-	 * need all the columns of the relation.
-	 */
-	foreach(lc, vars)
-	{
-		Var		   *var = (Var *) lfirst(lc);
+	initStringInfo(&sql);
+	deparseCopyFromSql(&sql, rte, rtindex, fmstate->rel,
+					   fmstate->target_attrs);
+	fmstate->copy_query = sql.data;
+}
 
-		if (IsA(var, Var) &&
-			var->varno == rtindex &&
-			var->varattno == InvalidAttrNumber)
+/*
+ * execute_foreign_copy
+ *		Insert a batch of rows into a foreign table with COPY FROM STDIN
+ *
+ * This is the COPY counterpart of execute_foreign_modify for batch inserts.
+ * The rows are converted to COPY text format, which the remote server can
+ * load without parsing and planning a statement.
+ */
+static TupleTableSlot **
+execute_foreign_copy(PgFdwModifyState *fmstate,
+					 TupleTableSlot **slots,
+					 int *numSlots)
+{
+	const char **p_values;
+	StringInfoData buf;
+	MemoryContext oldcontext;
+	PGresult   *res;
+	int			n_rows;
+	int			i;
+	int			j;
+
+	Assert(fmstate->copy_query != NULL);
+
+	/* Convert the column values to text form */
+	p_values = convert_prep_stmt_params(fmstate, NULL, slots, *numSlots);
+
+	/* Build one line of COPY data per row */
+	oldcontext = MemoryContextSwitchTo(fmstate->temp_cxt);
+	initStringInfo(&buf);
+	for (i = 0; i < *numSlots; i++)
+	{
+		for (j = 0; j < fmstate->p_nums; j++)
 		{
-			have_wholerow = true;
-			break;
+			if (j > 0)
+				appendStringInfoChar(&buf, '\t');
+			append_copy_field(&buf, p_values[i * fmstate->p_nums + j]);
 		}
+		appendStringInfoChar(&buf, '\n');
 	}
+	MemoryContextSwitchTo(oldcontext);
+
+	/*
+	 * Get the result, and check for success.
+	 *
+	 * We don't use a PG_TRY block here, so be careful not to throw error
+	 * without releasing the PGresult.
+	 */
+	res = pgfdw_exec_copy_in(fmstate->conn, fmstate->copy_query,
+							 buf.data, buf.len, fmstate->conn_state);
+	if (PQresultStatus(res) != PGRES_COMMAND_OK)
+		pgfdw_report_error(ERROR, res, fmstate->conn, true,
+						   fmstate->copy_query);
+	n_rows = atoi(PQcmdTuples(res));
+
+	/* And clean up */
+	PQclear(res);
+
+	MemoryContextReset(fmstate->temp_cxt);
+
+	*numSlots = n_rows;
+
+	/*
+	 * Return NULL if nothing was inserted on the remote end
+	 */
+	return (n_rows > 0) ? slots : NULL;
+}
+
+/*
+ * append_copy_field
+ *		Append a column value to COPY data in text format
+ *
+ * value is NULL for a null column.  The connection's client_encoding is the
+ * local database encoding, which is always ASCII-safe, so escaping can work
+ * byte by byte.
+ */
+static void
+append_copy_field(StringInfo buf, const char *value)
+{
+	const char *p;
+
+	if (value == NULL)
+	{
+		appendStringInfoString(buf, "\\N");
+		return;
+	}
+
+	for (p = value; *p; p++)
+	{
+		switch (*p)
+		{
+			case '\\':
+				appendStringInfoString(buf, "\\\\");
+				break;
+			case '\t':
+				appendStringInfoString(buf, "\\t");
+				break;
+			case '\n':
+				appendStringInfoString(buf, "\\n");
+				break;
+			case '\r':
+				appendStringInfoString(buf, "\\r");
+				break;
+			default:
+				appendStringInfoChar(buf, *p);
+				break;
+		}
+	}
+}
+
+/*
+ * deallocate_query
+ *		Deallocate a prepared statement for a foreign insert/update/delete
+ *		operation
+ */
+static void
+deallocate_query(PgFdwModifyState *fmstate)
+{
+	char		sql[64];
+	PGresult   *res;
+
+	/* do nothing if the query is not allocated */
+	if (!fmstate->p_name)
+		return;
+
+	snprintf(sql, sizeof(sql), "DEALLOCATE %s", fmstate->p_name);
+
+	/*
+	 * We don't use a PG_TRY block here, so be careful not to throw error
+	 * without releasing the PGresult.
+	 */
+	res = pgfdw_exec_query(fmstate->conn, sql, fmstate->conn_state);
+	if (PQresultStatus(res) != PGRES_COMMAND_OK)
+		pgfdw_report_error(ERROR, res, fmstate->conn, true, sql);
+	PQclear(res);
+	pfree(fmstate->p_name);
+	fmstate->p_name = NULL;
+}
+
+/*
+ * build_remote_returning
+ *		Build a RETURNING targetlist of a remote query for performing an
+ *		UPDATE/DELETE .. RETURNING on a join directly
+ */
+static List *
+build_remote_returning(Index rtindex, Relation rel, List *returningList)
+{
+	bool		have_wholerow = false;
+	List	   *tlist = NIL;
+	List	   *vars;
+	ListCell   *lc;
+
+	Assert(returningList);
+
+	vars = pull_var_clause((Node *) returningList, PVC_INCLUDE_PLACEHOLDERS);
+
+	/*
+	 * If there's a whole-row reference to the target relation, then we'll
+	 * need all the columns of the relation.
+	 */
+	foreach(lc, vars)
+	{
+		Var		   *var = (Var *) lfirst(lc);
+
+		if (IsA(var, Var) &&
+			var->varno == rtindex &&
+			var->varattno == InvalidAttrNumber)
+		{
+			have_wholerow = true;
+			break;
+		}
+	}
+
+	if (have_wholerow)
+	{
+		TupleDesc	tupdesc = RelationGetDescr(rel);
+		int			i;
 
-	if (have_wholerow)
-	{
-		TupleDesc	tupdesc = RelationGetDescr(rel);
-		int			i;
-
 		for (i = 1; i <= tupdesc->natts; i++)
 		{
 			Form_pg_attribute attr = TupleDescAttr(tupdesc, i - 1);
@@ -4052,6 +4704,9 @@ execute_dml_stmt(ForeignScanState *node)
 	int			numParams = dmstate->numParams;
 	const char **values = dmstate->param_values;
 
+	/* First, complete any request still in flight on the connection. */
+	process_pending_requests(dmstate->conn_state);
+
 	/*
 	 * Construct array of query parameter values in text format.
 	 */
@@ -4137,6 +4792,7 @@ get_returning_data(ForeignScanState *node)
 												dmstate->next_tuple,
 												dmstate->rel,
 												dmstate->attinmeta,
+												NULL,
 												dmstate->retrieved_attrs,
 												node,
 												dmstate->temp_cxt);
@@ -4453,7 +5109,7 @@ postgresAnalyzeForeignTable(Relation relation,
 	 */
 	table = GetForeignTable(RelationGetRelid(relation));
 	user = GetUserMapping(relation->rd_rel->relowner, table->serverid);
-	conn = GetConnection(user, false);
+	conn = GetConnection(user, false, NULL);
 
 	/*
 	 * Construct command to get page count for relation.
@@ -4464,7 +5120,7 @@ postgresAnalyzeForeignTable(Relation relation,
 	/* In what follows, do not risk leaking any PGresults. */
 	PG_TRY();
 	{
-		res = pgfdw_exec_query(conn, sql.data);
+		res = pgfdw_exec_query(conn, sql.data, NULL);
 		if (PQresultStatus(res) != PGRES_TUPLES_OK)
 			pgfdw_report_error(ERROR, res, conn, false, sql.data);
 
@@ -4539,7 +5195,7 @@ postgresAcquireSampleRowsFunc(Relation relation, int elevel,
 	table = GetForeignTable(RelationGetRelid(relation));
 	server = GetForeignServer(table->serverid);
 	user = GetUserMapping(relation->rd_rel->relowner, table->serverid);
-	conn = GetConnection(user, false);
+	conn = GetConnection(user, false, NULL);
 
 	/*
 	 * Construct cursor that retrieves whole rows from remote.
@@ -4556,7 +5212,7 @@ postgresAcquireSampleRowsFunc(Relation relation, int elevel,
 		int			fetch_size;
 		ListCell   *lc;
 
-		res = pgfdw_exec_query(conn, sql.data);
+		res = pgfdw_exec_query(conn, sql.data, NULL);
 		if (PQresultStatus(res) != PGRES_COMMAND_OK)
 			pgfdw_report_error(ERROR, res, conn, false, sql.data);
 		PQclear(res);
@@ -4608,7 +5264,7 @@ postgresAcquireSampleRowsFunc(Relation relation, int elevel,
 			 */
 
 			/* Fetch some rows */
-			res = pgfdw_exec_query(conn, fetch_sql);
+			res = pgfdw_exec_query(conn, fetch_sql, NULL);
 			/* On error, report the original query, not the FETCH. */
 			if (PQresultStatus(res) != PGRES_TUPLES_OK)
 				pgfdw_report_error(ERROR, res, conn, false, sql.data);
@@ -4627,7 +5283,7 @@ postgresAcquireSampleRowsFunc(Relation relation, int elevel,
 		}
 
 		/* Close the cursor, just to be tidy. */
-		close_cursor(conn, cursor_number);
+		close_cursor(conn, cursor_number, NULL);
 	}
 	PG_CATCH();
 	{
@@ -4717,6 +5373,7 @@ analyze_row_processor(PGresult *res, int row, PgFdwAnalyzeState *astate)
 		astate->rows[pos] = make_tuple_from_result_row(res, row,
 													   astate->rel,
 													   astate->attinmeta,
+													   NULL,
 													   astate->retrieved_attrs,
 													   NULL,
 													   astate->temp_cxt);
@@ -4767,7 +5424,7 @@ postgresImportForeignSchema(ImportForeignSchemaStmt *stmt, Oid serverOid)
 	 */
 	server = GetForeignServer(serverOid);
 	mapping = GetUserMapping(GetUserId(), server->serverid);
-	conn = GetConnection(mapping, false);
+	conn = GetConnection(mapping, false, NULL);
 
 	/* Don't attempt to import collation if remote server hasn't got it */
 	if (PQserverVersion(conn) < 90100)
@@ -4783,7 +5440,7 @@ postgresImportForeignSchema(ImportForeignSchemaStmt *stmt, Oid serverOid)
 		appendStringInfoString(&buf, "SELECT 1 FROM pg_catalog.pg_namespace WHERE nspname = ");
 		deparseStringLiteral(&buf, stmt->remote_schema);
 
-		res = pgfdw_exec_query(conn, buf.data);
+		res = pgfdw_exec_query(conn, buf.data, NULL);
 		if (PQresultStatus(res) != PGRES_TUPLES_OK)
 			pgfdw_report_error(ERROR, res, conn, false, buf.data);
 
@@ -4895,7 +5552,7 @@ postgresImportForeignSchema(ImportForeignSchemaStmt *stmt, Oid serverOid)
 		appendStringInfoString(&buf, " ORDER BY c.relname, a.attnum");
 
 		/* Fetch the data */
-		res = pgfdw_exec_query(conn, buf.data);
+		res = pgfdw_exec_query(conn, buf.data, NULL);
 		if (PQresultStatus(res) != PGRES_TUPLES_OK)
 			pgfdw_report_error(ERROR, res, conn, false, buf.data);
 
@@ -5355,6 +6012,10 @@ apply_server_options(PgFdwRelationInfo *fpinfo)
 				ExtractExtensionList(defGetString(def), false);
 		else if (strcmp(def->defname, "fetch_size") == 0)
 			fpinfo->fetch_size = strtol(defGetString(def), NULL, 10);
+		else if (strcmp(def->defname, "async_capable") == 0)
+			fpinfo->async_capable = defGetBoolean(def);
+		else if (strcmp(def->defname, "prefetch") == 0)
+			fpinfo->prefetch = defGetBoolean(def);
 	}
 }
 
@@ -5376,7 +6037,75 @@ apply_table_options(PgFdwRelationInfo *fpinfo)
 			fpinfo->use_remote_estimate = defGetBoolean(def);
 		else if (strcmp(def->defname, "fetch_size") == 0)
 			fpinfo->fetch_size = strtol(defGetString(def), NULL, 10);
+		else if (strcmp(def->defname, "async_capable") == 0)
+			fpinfo->async_capable = defGetBoolean(def);
+		else if (strcmp(def->defname, "prefetch") == 0)
+			fpinfo->prefetch = defGetBoolean(def);
+	}
+}
+
+/*
+ * get_insert_option
+ *		Look up an option affecting inserts into a foreign table.  The option
+ *		specified for a table has precedence.  Returns NULL if neither the
+ *		table nor its server specifies it.
+ */
+static DefElem *
+get_insert_option(Relation rel, const char *defname)
+{
+	Oid			foreigntableid = RelationGetRelid(rel);
+	ForeignTable *table;
+	ForeignServer *server;
+	List	   *options;
+	ListCell   *lc;
+
+	/*
+	 * Load options for table and server. We append server options after table
+	 * options, because table options take precedence.
+	 */
+	table = GetForeignTable(foreigntableid);
+	server = GetForeignServer(table->serverid);
+
+	options = NIL;
+	options = list_concat(options, table->options);
+	options = list_concat(options, server->options);
+
+	foreach(lc, options)
+	{
+		DefElem    *def = (DefElem *) lfirst(lc);
+
+		if (strcmp(def->defname, defname) == 0)
+			return def;
 	}
+
+	return NULL;
+}
+
+/*
+ * get_batch_size_option
+ *		Determine the batch size for a foreign table.
+ *
+ * This is the "batch_size" option if specified, else 100 if the table uses
+ * COPY for inserts, else 1.
+ */
+static int
+get_batch_size_option(Relation rel)
+{
+	DefElem    *def = get_insert_option(rel, "batch_size");
+
+	if (def != NULL)
+		return strtol(defGetString(def), NULL, 10);
+
+	/*
+	 * use_remote_copy only affects batched inserts, so it turns batching on
+	 * unless batch_size is specified.
+	 */
+	def = get_insert_option(rel, "use_remote_copy");
+	if (def != NULL && defGetBoolean(def))
+		return 100;
+
+	/* we use 1 by default, which means "no batching" */
+	return 1;
 }
 
 /*
@@ -5410,6 +6139,8 @@ merge_fdw_options(PgFdwRelationInfo *fpinfo,
 	fpinfo->shippable_extensions = fpinfo_o->shippable_extensions;
 	fpinfo->use_remote_estimate = fpinfo_o->use_remote_estimate;
 	fpinfo->fetch_size = fpinfo_o->fetch_size;
+	fpinfo->async_capable = fpinfo_o->async_capable;
+	fpinfo->prefetch = fpinfo_o->prefetch;
 
 	/* Merge the table level options from either side of the join. */
 	if (fpinfo_i)
@@ -5431,6 +6162,22 @@ merge_fdw_options(PgFdwRelationInfo *fpinfo,
 		 * relation sizes.
 		 */
 		fpinfo->fetch_size = Max(fpinfo_o->fetch_size, fpinfo_i->fetch_size);
+
+		/*
+		 * We'll prefer to consider this join async-capable if any table from
+		 * either side of the join is considered async-capable.  This would be
+		 * reasonable because in that case the foreign server would have its
+		 * own resources to scan that table asynchronously, and the join could
+		 * also be computed asynchronously using the resources.
+		 */
+		fpinfo->async_capable = fpinfo_o->async_capable ||
+			fpinfo_i->async_capable;
+
+		/*
+		 * Likewise, prefetch for this join if either side asked for it; the
+		 * join's rows are just as likely to be consumed in full.
+		 */
+		fpinfo->prefetch = fpinfo_o->prefetch || fpinfo_i->prefetch;
 	}
 }
 
@@ -6313,12 +7060,473 @@ add_foreign_final_paths(PlannerInfo *root, RelOptInfo *input_rel,
 	add_path(final_rel, (Path *) final_path);
 }
 
+/*
+ * postgresIsForeignPathAsyncCapable
+ *		Check whether a given ForeignPath node is async-capable.
+ */
+static bool
+postgresIsForeignPathAsyncCapable(ForeignPath *path)
+{
+	RelOptInfo *rel = ((Path *) path)->parent;
+	PgFdwRelationInfo *fpinfo = (PgFdwRelationInfo *) rel->fdw_private;
+
+	return fpinfo->async_capable;
+}
+
+/*
+ * postgresForeignAsyncRequest
+ *		Asynchronously request next tuple from a foreign PostgreSQL table.
+ */
+static void
+postgresForeignAsyncRequest(AsyncRequest *areq)
+{
+	produce_tuple_asynchronously(areq, true);
+}
+
+/*
+ * postgresForeignAsyncConfigureWait
+ *		Configure a file descriptor event for which we wish to wait.
+ */
+static void
+postgresForeignAsyncConfigureWait(AsyncRequest *areq)
+{
+	ForeignScanState *node = (ForeignScanState *) areq->requestee;
+	PgFdwScanState *fsstate = (PgFdwScanState *) node->fdw_state;
+	AsyncRequest *pendingAreq = fsstate->conn_state->pendingAreq;
+	AppendState *requestor = (AppendState *) areq->requestor;
+	WaitEventSet *set = requestor->as_eventset;
+
+	/* This should not be called unless callback_pending */
+	Assert(areq->callback_pending);
+
+	/*
+	 * If process_pending_request() has been invoked on the given request
+	 * before we get here, we might have some tuples already; in which case
+	 * complete the request.
+	 */
+	if (fsstate->next_tuple < fsstate->num_tuples)
+	{
+		complete_pending_request(areq);
+		if (areq->request_complete)
+			return;
+		Assert(areq->callback_pending);
+	}
+
+	/* We must have run out of tuples */
+	Assert(fsstate->next_tuple >= fsstate->num_tuples);
+
+	/* The core code would have registered postmaster death event */
+	Assert(GetNumRegisteredWaitEvents(set) >= 1);
+
+	/* Begin an asynchronous data fetch if not already done */
+	if (!pendingAreq)
+		fetch_more_data_begin(areq);
+	else if (pendingAreq->requestor != areq->requestor)
+	{
+		/*
+		 * This is the case when the in-process request was made by another
+		 * Append.  Note that it might be useless to process the request,
+		 * because the query might not need tuples from that Append anymore.
+		 * If there are any child subplans of the same parent that are ready
+		 * for new requests, skip the given request.  Likewise, if there are
+		 * any configured events other than the postmaster death event, skip
+		 * it.  Otherwise, process the in-process request, then begin a fetch
+		 * to configure the event below, because we might otherwise end up
+		 * with no configured events other than the postmaster death event.
+		 */
+		if (!bms_is_empty(requestor->as_needrequest))
+			return;
+		if (GetNumRegisteredWaitEvents(set) > 1)
+			return;
+		process_pending_request(pendingAreq);
+		fetch_more_data_begin(areq);
+	}
+	else if (pendingAreq->requestee != areq->requestee)
+	{
+		/*
+		 * This is the case when the in-process request was made by the same
+		 * parent but for a different child.  Since we configure only the
+		 * event for the request made for that child, skip the given request.
+		 */
+		return;
+	}
+	else
+		Assert(pendingAreq == areq);
+
+	AddWaitEventToSet(set, WL_SOCKET_READABLE, PQsocket(fsstate->conn),
+					  NULL, areq);
+}
+
+/*
+ * postgresForeignAsyncNotify
+ *		Fetch some more tuples from a file descriptor that becomes ready,
+ *		requesting next tuple.
+ */
+static void
+postgresForeignAsyncNotify(AsyncRequest *areq)
+{
+	ForeignScanState *node = (ForeignScanState *) areq->requestee;
+	PgFdwScanState *fsstate = (PgFdwScanState *) node->fdw_state;
+
+	/* The core code would have initialized the callback_pending flag */
+	Assert(!areq->callback_pending);
+
+	/*
+	 * If process_pending_request() has been invoked on the given request
+	 * before we get here, we might have some tuples already; in which case
+	 * produce the next tuple.
+	 */
+	if (fsstate->next_tuple < fsstate->num_tuples)
+	{
+		produce_tuple_asynchronously(areq, true);
+		return;
+	}
+
+	/* We must have run out of tuples */
+	Assert(fsstate->next_tuple >= fsstate->num_tuples);
+
+	/* The request should be currently in-process */
+	Assert(fsstate->conn_state->pendingAreq == areq);
+
+	/* On error, report the original query, not the FETCH. */
+	if (!PQconsumeInput(fsstate->conn))
+		pgfdw_report_error(ERROR, NULL, fsstate->conn, false, fsstate->query);
+
+	fetch_more_data(node);
+
+	produce_tuple_asynchronously(areq, true);
+}
+
+/*
+ * Asynchronously produce next tuple from a foreign PostgreSQL table.
+ */
+static void
+produce_tuple_asynchronously(AsyncRequest *areq, bool fetch)
+{
+	ForeignScanState *node = (ForeignScanState *) areq->requestee;
+	PgFdwScanState *fsstate = (PgFdwScanState *) node->fdw_state;
+	AsyncRequest *pendingAreq = fsstate->conn_state->pendingAreq;
+	TupleTableSlot *result;
+
+	/* This should not be called if the request is currently in-process */
+	Assert(areq != pendingAreq);
+
+	/* Fetch some more tuples, if we've run out */
+	if (fsstate->next_tuple >= fsstate->num_tuples)
+	{
+		/* No point in another fetch if we already detected EOF, though */
+		if (!fsstate->eof_reached)
+		{
+			/* Mark the request as pending for a callback */
+			ExecAsyncRequestPending(areq);
+			/* Begin another fetch if requested and if no pending request */
+			if (fetch && !pendingAreq)
+				fetch_more_data_begin(areq);
+		}
+		else
+		{
+			/* There's nothing more to do; just return a NULL pointer */
+			result = NULL;
+			/* Mark the request as complete */
+			ExecAsyncRequestDone(areq, result);
+		}
+		return;
+	}
+
+	/* Get a tuple from the ForeignScan node */
+	result = areq->requestee->ExecProcNodeReal(areq->requestee);
+	if (!TupIsNull(result))
+	{
+		/* Mark the request as complete */
+		ExecAsyncRequestDone(areq, result);
+		return;
+	}
+
+	/* We must have run out of tuples */
+	Assert(fsstate->next_tuple >= fsstate->num_tuples);
+
+	/* Fetch some more tuples, if we've not detected EOF yet */
+	if (!fsstate->eof_reached)
+	{
+		/* Mark the request as pending for a callback */
+		ExecAsyncRequestPending(areq);
+		/* Begin another fetch if requested and if no pending request */
+		if (fetch && !pendingAreq)
+			fetch_more_data_begin(areq);
+	}
+	else
+	{
+		/* There's nothing more to do; just return a NULL pointer */
+		result = NULL;
+		/* Mark the request as complete */
+		ExecAsyncRequestDone(areq, result);
+	}
+}
+
+/*
+ * Begin an asynchronous data fetch.
+ *
+ * Note: this function assumes there is no currently-in-progress asynchronous
+ * data fetch.
+ *
+ * Note: fetch_more_data must be called to fetch the result.
+ */
+static void
+fetch_more_data_begin(AsyncRequest *areq)
+{
+	ForeignScanState *node = (ForeignScanState *) areq->requestee;
+	PgFdwScanState *fsstate = (PgFdwScanState *) node->fdw_state;
+	char		sql[64];
+
+	Assert(!fsstate->conn_state->pendingAreq);
+
+	/* Create the cursor synchronously. */
+	if (!fsstate->cursor_exists)
+		create_cursor(node);
+
+	/* A prefetching FETCH of another scan must be completed first. */
+	if (fsstate->conn_state->pendingFetch)
+		process_pending_requests(fsstate->conn_state);
+
+	/* We will send this query, but not wait for the response. */
+	snprintf(sql, sizeof(sql), "FETCH %d FROM c%u",
+			 fsstate->fetch_size, fsstate->cursor_number);
+
+	send_fetch(fsstate, sql);
+
+	/* Remember that the request is in process */
+	fsstate->conn_state->pendingAreq = areq;
+}
+
+/*
+ * Process a pending asynchronous request.
+ */
+void
+process_pending_request(AsyncRequest *areq)
+{
+	ForeignScanState *node = (ForeignScanState *) areq->requestee;
+	PgFdwScanState *fsstate = (PgFdwScanState *) node->fdw_state;
+
+	/* The request would have been pending for a callback */
+	Assert(areq->callback_pending);
+
+	/* The request should be currently in-process */
+	Assert(fsstate->conn_state->pendingAreq == areq);
+
+	fetch_more_data(node);
+
+	/*
+	 * If we didn't get any tuples, must be end of data; complete the request
+	 * now.  Otherwise, we postpone completing the request until we are
+	 * called from postgresForeignAsyncConfigureWait() or
+	 * postgresForeignAsyncNotify().
+	 */
+	if (fsstate->next_tuple >= fsstate->num_tuples)
+	{
+		/* Unlike AsyncNotify, we unset callback_pending ourselves */
+		areq->callback_pending = false;
+		/* Mark the request as complete */
+		ExecAsyncRequestDone(areq, NULL);
+		/* Unlike AsyncNotify, we call ExecAsyncResponse ourselves */
+		ExecAsyncResponse(areq);
+	}
+}
+
+/*
+ * Complete a pending asynchronous request.
+ */
+static void
+complete_pending_request(AsyncRequest *areq)
+{
+	/* The request would have been pending for a callback */
+	Assert(areq->callback_pending);
+
+	/* Unlike AsyncNotify, we unset callback_pending ourselves */
+	areq->callback_pending = false;
+
+	/* We begin a fetch afterwards if necessary; don't fetch */
+	produce_tuple_asynchronously(areq, false);
+
+	/* Unlike AsyncNotify, we call ExecAsyncResponse ourselves */
+	ExecAsyncResponse(areq);
+
+	/* Also, we do instrumentation ourselves, if required */
+	if (areq->requestee->instrument)
+		InstrUpdateTupleCount(areq->requestee->instrument,
+							  TupIsNull(areq->result) ? 0.0 : 1.0);
+}
+
+/*
+ * Set up for fetching a scan's results in binary format.
+ *
+ * This is done only if the server's "binary_transfer" option is set and
+ * every retrieved column has a type whose binary format we can decode; see
+ * is_binary_transfer_safe.  A result is either all text or all binary, so a
+ * single unsafe column makes the whole scan use text.  Binary input
+ * functions for text-like types convert from the session's client_encoding,
+ * while the remote server sends data in the database encoding, so we also
+ * require those to match.
+ *
+ * The cursor is declared as usual, and its first batch is fetched in text.
+ * Only if the types of that result match the local ones are the following
+ * batches fetched in binary; see binary_result_types_match.
+ *
+ * Returns an array of binary input functions indexed like the tupdesc, or
+ * NULL if the results are to be fetched in text.
+ */
+static FmgrInfo *
+prepare_binary_transfer(ForeignServer *server, TupleDesc tupdesc,
+						List *retrieved_attrs)
+{
+	bool		binary_transfer = false;
+	FmgrInfo   *attrecvfuncs;
+	ListCell   *lc;
+
+	foreach(lc, server->options)
+	{
+		DefElem    *def = (DefElem *) lfirst(lc);
+
+		if (strcmp(def->defname, "binary_transfer") == 0)
+			binary_transfer = defGetBoolean(def);
+	}
+
+	if (!binary_transfer || retrieved_attrs == NIL ||
+		pg_get_client_encoding() != GetDatabaseEncoding())
+		return NULL;
+
+	attrecvfuncs = (FmgrInfo *) palloc0(sizeof(FmgrInfo) *
+										Max(tupdesc->natts, 1));
+	foreach(lc, retrieved_attrs)
+	{
+		int			i = lfirst_int(lc);
+		Oid			typid;
+		Oid			typreceive;
+		Oid			typioparam;
+
+		/* ctid is decoded with tidrecv directly */
+		if (i == SelfItemPointerAttributeNumber)
+			continue;
+
+		if (i <= 0)
+		{
+			pfree(attrecvfuncs);
+			return NULL;
+		}
+
+		typid = TupleDescAttr(tupdesc, i - 1)->atttypid;
+		if (!is_binary_transfer_safe(typid))
+		{
+			pfree(attrecvfuncs);
+			return NULL;
+		}
+
+		getTypeBinaryInputInfo(typid, &typreceive, &typioparam);
+		fmgr_info(typreceive, &attrecvfuncs[i - 1]);
+	}
+
+	return attrecvfuncs;
+}
+
+/*
+ * Can values of the given type be transferred from the remote server in
+ * binary format?
+ *
+ * Only built-in types qualify: they have the same OIDs and binary formats on
+ * any server, so we can tell from the OIDs in a result whether the remote
+ * server sends what we expect.  Other types, such as those of extensions or
+ * enums, practically never have the same OIDs on both servers, and composite
+ * values embed type OIDs in their binary format.  Domains are judged by
+ * their base type, whose binary input function we use.
+ */
+static bool
+is_binary_transfer_safe(Oid typid)
+{
+	HeapTuple	tp;
+	Form_pg_type typ;
+	bool		result;
+
+	typid = getBaseType(typid);
+
+	tp = SearchSysCache1(TYPEOID, ObjectIdGetDatum(typid));
+	if (!HeapTupleIsValid(tp))
+		elog(ERROR, "cache lookup failed for type %u", typid);
+	typ = (Form_pg_type) GETSTRUCT(tp);
+
+	if (!OidIsValid(typ->typreceive) || !OidIsValid(typ->typsend))
+		result = false;
+	else if (typ->typtype == TYPTYPE_COMPOSITE ||
+			 typ->typtype == TYPTYPE_PSEUDO)
+		result = false;
+	else
+		result = is_builtin(typid);
+
+	ReleaseSysCache(tp);
+
+	return result;
+}
+
+/*
+ * Check that the remote server sends each column of a result in the type
+ * whose binary input function we'd apply to it, so that the following
+ * results can be fetched in binary.
+ *
+ * prepare_binary_transfer only looks at the foreign table's column types,
+ * but those needn't match the remote columns: a local bigint column might
+ * be an integer or a float8 on the remote side, which would be misread
+ * rather than converted as in text mode.  So require the remote type OID to
+ * be the local column type or, for a domain, its base type.
+ */
+static bool
+binary_result_types_match(PgFdwScanState *fsstate, PGresult *res)
+{
+	ListCell   *lc;
+	int			j = 0;
+
+	foreach(lc, fsstate->retrieved_attrs)
+	{
+		int			i = lfirst_int(lc);
+		Oid			remotetype = PQftype(res, j++);
+
+		if (i > 0)
+		{
+			Oid			typid = TupleDescAttr(fsstate->tupdesc, i - 1)->atttypid;
+
+			if (remotetype != typid && remotetype != getBaseType(typid))
+				return false;
+		}
+		else if (i == SelfItemPointerAttributeNumber)
+		{
+			if (remotetype != TIDOID)
+				return false;
+		}
+	}
+
+	return true;
+}
+
+/*
+ * Send a FETCH for the scan's cursor without waiting for the result.
+ *
+ * FETCH is sent with the extended query protocol, which lets us choose the
+ * result format of each FETCH regardless of how the cursor was declared.
+ */
+static void
+send_fetch(PgFdwScanState *fsstate, const char *sql)
+{
+	if (!PQsendQueryParams(fsstate->conn, sql, 0, NULL, NULL, NULL, NULL,
+						   fsstate->fetch_binary ? 1 : 0))
+		pgfdw_report_error(ERROR, NULL, fsstate->conn, false, fsstate->query);
+}
+
 /*
  * Create a tuple from the specified row of the PGresult.
  *
  * rel is the local representation of the foreign table, attinmeta is
  * conversion data for the rel's tupdesc, and retrieved_attrs is an
  * integer list of the table column numbers present in the PGresult.
+ * attrecvfuncs is NULL if the PGresult is in text format; otherwise it is
+ * in binary format and attrecvfuncs holds the binary input functions for
+ * the tupdesc's columns.
  * temp_context is a working context that can be reset after each tuple.
  */
 static HeapTuple
@@ -6326,6 +7534,7 @@ make_tuple_from_result_row(PGresult *res,
 						   int row,
 						   Relation rel,
 						   AttInMetadata *attinmeta,
+						   FmgrInfo *attrecvfuncs,
 						   List *retrieved_attrs,
 						   ForeignScanState *fsstate,
 						   MemoryContext temp_context)
@@ -6383,7 +7592,7 @@ make_tuple_from_result_row(PGresult *res,
 		int			i = lfirst_int(lc);
 		char	   *valstr;
 
-		/* fetch next column's textual value */
+		/* fetch next column's textual (or binary) value */
 		if (PQgetisnull(res, row, j))
 			valstr = NULL;
 		else
@@ -6395,7 +7604,46 @@ make_tuple_from_result_row(PGresult *res,
 		 * Note: we ignore system columns other than ctid and oid in result
 		 */
 		errpos.cur_attno = i;
-		if (i > 0)
+		if (attrecvfuncs)
+		{
+			StringInfo	valbuf = NULL;
+
+			/* the binary input functions want the value in a StringInfo */
+			if (valstr != NULL)
+			{
+				int			len = PQgetlength(res, row, j);
+
+				valbuf = makeStringInfo();
+				appendBinaryStringInfo(valbuf, valstr, len);
+			}
+
+			if (i > 0)
+			{
+				/* ordinary column */
+				Assert(i <= tupdesc->natts);
+				nulls[i - 1] = (valstr == NULL);
+				/* Apply the input function even to nulls, to support domains */
+				values[i - 1] = ReceiveFunctionCall(&attrecvfuncs[i - 1],
+													valbuf,
+													attinmeta->attioparams[i - 1],
+													attinmeta->atttypmods[i - 1]);
+			}
+			else if (i == SelfItemPointerAttributeNumber && valbuf != NULL)
+			{
+				/* ctid */
+				Datum		datum;
+
+				datum = DirectFunctionCall1(tidrecv, PointerGetDatum(valbuf));
+				ctid = (ItemPointer) DatumGetPointer(datum);
+			}
+
+			/* Trouble if the function didn't eat the whole value */
+			if (valbuf != NULL && valbuf->cursor != valbuf->len)
+				ereport(ERROR,
+						(errcode(ERRCODE_INVALID_BINARY_REPRESENTATION),
+						 errmsg("incorrect binary data format")));
+		}
+		else if (i > 0)
 		{
 			/* ordinary column */
 			Assert(i <= tupdesc->natts);
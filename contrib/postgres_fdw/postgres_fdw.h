@@ -15,6 +15,7 @@
 
 #include "access/fdwxact.h"
 #include "foreign/foreign.h"
+#include "nodes/execnodes.h"
 #include "lib/stringinfo.h"
 #include "libpq-fe.h"
 #include "nodes/pathnodes.h"
@@ -87,6 +88,12 @@ typedef struct PgFdwRelationInfo
 
 	int			fetch_size;		/* fetch size for this remote table */
 
+	/* True if the relation can be scanned asynchronously under an Append */
+	bool		async_capable;
+
+	/* True if the next batch should be fetched while consuming the current */
+	bool		prefetch;
+
 	/*
 	 * Name of the relation, for use while EXPLAINing ForeignScan.  It is used
 	 * for join and upper relations but is set for all relations.  For a base
@@ -125,25 +132,48 @@ typedef struct PgFdwRelationInfo
 	int			relation_index;
 } PgFdwRelationInfo;
 
+/*
+ * Extra control information relating to a connection.
+ */
+typedef struct PgFdwConnState
+{
+	AsyncRequest *pendingAreq;	/* pending async request */
+	ForeignScanState *pendingFetch; /* scan with a prefetching FETCH pending */
+} PgFdwConnState;
+
 /* in postgres_fdw.c */
 extern int	set_transmission_modes(void);
 extern void reset_transmission_modes(int nestlevel);
+extern void process_pending_request(AsyncRequest *areq);
+extern void process_pending_requests(PgFdwConnState *state);
 
 /* in connection.c */
-extern PGconn *GetConnection(UserMapping *user, bool will_prep_stmt);
+extern PGconn *GetConnection(UserMapping *user, bool will_prep_stmt,
+							 PgFdwConnState **state);
 extern void ReleaseConnection(PGconn *conn);
 extern void MarkConnectionModified(UserMapping *user);
 extern unsigned int GetCursorNumber(PGconn *conn);
 extern unsigned int GetPrepStmtNumber(PGconn *conn);
 extern PGresult *pgfdw_get_result(PGconn *conn, const char *query);
-extern PGresult *pgfdw_exec_query(PGconn *conn, const char *query);
+extern PGresult *pgfdw_exec_copy_in(PGconn *conn, const char *query,
+									const char *data, int len,
+									PgFdwConnState *state);
+extern PGresult *pgfdw_exec_query(PGconn *conn, const char *query,
+								  PgFdwConnState *state);
 extern void pgfdw_report_error(int elevel, PGresult *res, PGconn *conn,
 							   bool clear, const char *sql);
 extern void postgresCommitForeignTransaction(FdwXactRslvState *frstate);
 extern void postgresRollbackForeignTransaction(FdwXactRslvState *frstate);
 extern void postgresPrepareForeignTransaction(FdwXactRslvState *frstate);
-extern void postgresAssignGlobalCSN(FdwXactRslvState *frstate, CSN max_csn);
 extern CSN postgresPrepareForeignCSNSnapshot(FdwXactRslvState *frstate);
+extern void postgresSendPrepareForeignTransaction(FdwXactRslvState *frstate);
+extern void postgresWaitPrepareForeignTransaction(FdwXactRslvState *frstate);
+extern void postgresSendCommitForeignTransaction(FdwXactRslvState *frstate);
+extern void postgresWaitCommitForeignTransaction(FdwXactRslvState *frstate);
+extern void postgresSendRollbackForeignTransaction(FdwXactRslvState *frstate);
+extern void postgresWaitRollbackForeignTransaction(FdwXactRslvState *frstate);
+extern void postgresSendPrepareForeignCSNSnapshot(FdwXactRslvState *frstate);
+extern CSN postgresWaitPrepareForeignCSNSnapshot(FdwXactRslvState *frstate);
 
 /* in option.c */
 extern int	ExtractConnectionOptions(List *defelems,
@@ -168,7 +198,13 @@ extern void deparseInsertSql(StringInfo buf, RangeTblEntry *rte,
 							 Index rtindex, Relation rel,
 							 List *targetAttrs, bool doNothing,
 							 List *withCheckOptionList, List *returningList,
-							 List **retrieved_attrs);
+							 List **retrieved_attrs, int *values_end_len);
+extern void rebuildInsertSql(StringInfo buf, char *orig_query,
+							 int values_end_len, int num_cols,
+							 int num_rows);
+extern void deparseCopyFromSql(StringInfo buf, RangeTblEntry *rte,
+							   Index rtindex, Relation rel,
+							   List *targetAttrs);
 extern void deparseUpdateSql(StringInfo buf, RangeTblEntry *rte,
 							 Index rtindex, Relation rel,
 							 List *targetAttrs,
@@ -2690,3 +2690,196 @@ COMMIT;
 
 -- Clean up
 DROP PROCEDURE terminate_backend_and_wait(text);
+
+-- ===================================================================
+-- test asynchronous execution
+-- ===================================================================
+
+ALTER SERVER loopback OPTIONS (ADD async_capable 'true');
+ALTER SERVER loopback2 OPTIONS (ADD async_capable 'true');
+
+CREATE TABLE async_pt (a int, b int, c text) PARTITION BY RANGE (a);
+CREATE TABLE base_tbl1 (a int, b int, c text);
+CREATE TABLE base_tbl2 (a int, b int, c text);
+CREATE FOREIGN TABLE async_p1 PARTITION OF async_pt FOR VALUES FROM (1000) TO (2000)
+  SERVER loopback OPTIONS (table_name 'base_tbl1');
+CREATE FOREIGN TABLE async_p2 PARTITION OF async_pt FOR VALUES FROM (2000) TO (3000)
+  SERVER loopback2 OPTIONS (table_name 'base_tbl2');
+INSERT INTO async_p1 SELECT 1000 + i, i, to_char(i, 'FM0000') FROM generate_series(0, 999, 5) i;
+INSERT INTO async_p2 SELECT 2000 + i, i, to_char(i, 'FM0000') FROM generate_series(0, 999, 5) i;
+ANALYZE async_pt;
+
+CREATE TABLE result_tbl (a int, b int, c text);
+
+EXPLAIN (COSTS OFF)
+INSERT INTO result_tbl SELECT * FROM async_pt WHERE b % 100 = 0;
+INSERT INTO result_tbl SELECT * FROM async_pt WHERE b % 100 = 0;
+
+SELECT * FROM result_tbl ORDER BY a;
+
+-- Scans are synchronous when enable_async_append is off
+SET enable_async_append TO false;
+EXPLAIN (COSTS OFF)
+SELECT * FROM async_pt WHERE b % 100 = 0;
+RESET enable_async_append;
+
+-- Clean up
+DROP TABLE async_pt;
+DROP TABLE base_tbl1;
+DROP TABLE base_tbl2;
+DROP TABLE result_tbl;
+ALTER SERVER loopback OPTIONS (DROP async_capable);
+ALTER SERVER loopback2 OPTIONS (DROP async_capable);
+
+-- ===================================================================
+-- test batch insert
+-- ===================================================================
+CREATE TABLE batch_table (x int);
+CREATE FOREIGN TABLE ftable (x int) SERVER loopback
+  OPTIONS (table_name 'batch_table', batch_size '10');
+EXPLAIN (VERBOSE, COSTS OFF) INSERT INTO ftable SELECT * FROM generate_series(1, 10) i;
+INSERT INTO ftable SELECT * FROM generate_series(1, 10) i;
+INSERT INTO ftable SELECT * FROM generate_series(11, 31) i;
+INSERT INTO ftable VALUES (32);
+INSERT INTO ftable VALUES (33), (34);
+SELECT COUNT(*) FROM ftable;
+
+-- COPY FROM is batched too
+copy ftable from stdin;
+35
+36
+37
+\.
+SELECT COUNT(*), sum(x) FROM ftable;
+
+-- RETURNING disables batching
+INSERT INTO ftable VALUES (38), (39) RETURNING x;
+
+ALTER FOREIGN TABLE ftable OPTIONS (SET batch_size '0');
+ALTER FOREIGN TABLE ftable OPTIONS (SET batch_size '10abc');
+DROP FOREIGN TABLE ftable;
+DROP TABLE batch_table;
+
+-- Rows routed to foreign partitions are batched per partition
+CREATE TABLE batch_table (x int) PARTITION BY HASH (x);
+CREATE TABLE batch_table_p0 (LIKE batch_table);
+CREATE FOREIGN TABLE batch_table_p0f
+  PARTITION OF batch_table
+  FOR VALUES WITH (MODULUS 2, REMAINDER 0)
+  SERVER loopback
+  OPTIONS (table_name 'batch_table_p0', batch_size '10');
+CREATE TABLE batch_table_p1 (LIKE batch_table);
+CREATE FOREIGN TABLE batch_table_p1f
+  PARTITION OF batch_table
+  FOR VALUES WITH (MODULUS 2, REMAINDER 1)
+  SERVER loopback
+  OPTIONS (table_name 'batch_table_p1', batch_size '1');
+INSERT INTO batch_table SELECT * FROM generate_series(1, 66) i;
+SELECT COUNT(*) FROM batch_table;
+
+-- Clean up
+DROP TABLE batch_table;
+DROP TABLE batch_table_p0;
+DROP TABLE batch_table_p1;
+
+-- Batches can be sent with COPY instead of INSERT
+CREATE TABLE batch_table (x int, y text);
+CREATE FOREIGN TABLE ftable (x int, y text) SERVER loopback
+  OPTIONS (table_name 'batch_table', batch_size '10', use_remote_copy 'true');
+INSERT INTO ftable SELECT i, 'row ' || i FROM generate_series(1, 25) i;
+INSERT INTO ftable VALUES (26, E'tab\there'), (27, E'back\\slash'), (28, NULL);
+copy ftable from stdin;
+29	new\nline
+\.
+SELECT x, replace(replace(y, E'\t', '<tab>'), E'\n', '<nl>') AS y
+  FROM ftable WHERE x > 25 ORDER BY x;
+SELECT COUNT(*) FROM ftable;
+
+-- A remote view can't be loaded with COPY, but can with INSERT.
+-- use_remote_copy batches inserts even if batch_size isn't set
+CREATE VIEW batch_view AS SELECT * FROM batch_table;
+CREATE FOREIGN TABLE fview (x int, y text) SERVER loopback
+  OPTIONS (table_name 'batch_view', use_remote_copy 'true');
+INSERT INTO fview VALUES (30, 'a'), (31, 'b');
+-- unless batch_size disables batching
+ALTER FOREIGN TABLE fview OPTIONS (ADD batch_size '1');
+INSERT INTO fview VALUES (30, 'a'), (31, 'b');
+ALTER FOREIGN TABLE fview OPTIONS (DROP batch_size, SET use_remote_copy 'false');
+INSERT INTO fview VALUES (32, 'c'), (33, 'd');
+SELECT COUNT(*) FROM ftable;
+
+-- Clean up
+DROP FOREIGN TABLE fview;
+DROP VIEW batch_view;
+DROP FOREIGN TABLE ftable;
+DROP TABLE batch_table;
+
+-- ===================================================================
+-- test binary transfer
+-- ===================================================================
+ALTER SERVER loopback OPTIONS (ADD binary_transfer 'true');
+CREATE TABLE binary_tbl (a int, b numeric, c timestamptz, d text, e int[], f user_enum);
+INSERT INTO binary_tbl VALUES
+  (1, 1.5, '2000-01-01 12:00:00+00', 'one', '{1,2}', 'foo'),
+  (2, NULL, NULL, 'two', NULL, NULL),
+  (3, -123456789.0123456789, '1970-01-01 00:00:00+00', '', '{}', 'foo');
+-- the first batch is always fetched in text, so fetch one row at a time
+CREATE FOREIGN TABLE binary_ft (a int, b numeric, c timestamptz, d text, e int[], f user_enum)
+  SERVER loopback OPTIONS (table_name 'binary_tbl', fetch_size '1');
+-- the enum column keeps this scan in text
+SELECT * FROM binary_ft ORDER BY a;
+SELECT a, b, c, d, e FROM binary_ft ORDER BY a;
+-- whole-row references are formed from the decoded columns
+SELECT t FROM binary_ft t ORDER BY a;
+-- ctid is fetched too when the UPDATE can't be pushed down
+UPDATE binary_ft SET d = 'three' WHERE a = 3 AND random() >= 0;
+SELECT a, d FROM binary_ft WHERE a = 3;
+SELECT count(*), sum(b), max(c) FROM binary_ft;
+-- the remote column types needn't match the local ones; such a scan
+-- stays in text
+CREATE FOREIGN TABLE binary_ft2 (a bigint, b numeric, d varchar)
+  SERVER loopback OPTIONS (table_name 'binary_tbl', fetch_size '1');
+SELECT a, b, d FROM binary_ft2 ORDER BY a;
+
+-- Clean up
+DROP FOREIGN TABLE binary_ft;
+DROP FOREIGN TABLE binary_ft2;
+DROP TABLE binary_tbl;
+ALTER SERVER loopback OPTIONS (DROP binary_transfer);
+
+-- ===================================================================
+-- test prefetch
+-- ===================================================================
+CREATE TABLE prefetch_tbl1 (a int, b text);
+CREATE TABLE prefetch_tbl2 (a int, b text);
+INSERT INTO prefetch_tbl1 SELECT i, to_char(i, 'FM0000') FROM generate_series(1, 95) i;
+INSERT INTO prefetch_tbl2 SELECT i, to_char(i, 'FM0000') FROM generate_series(1, 95, 3) i;
+CREATE FOREIGN TABLE prefetch_ft1 (a int, b text) SERVER loopback
+  OPTIONS (table_name 'prefetch_tbl1', prefetch 'true', fetch_size '10');
+CREATE FOREIGN TABLE prefetch_ft2 (a int, b text) SERVER loopback
+  OPTIONS (table_name 'prefetch_tbl2', prefetch 'true', fetch_size '10');
+-- a scan spanning several batches
+SELECT count(*), sum(a), min(b), max(b) FROM prefetch_ft1 WHERE random() >= 0;
+-- the scan stops with a prefetched batch still in flight
+SELECT a, b FROM prefetch_ft1 WHERE random() >= 0 ORDER BY a LIMIT 3;
+-- the inner scan is rescanned while the outer one has a FETCH in flight
+SET enable_hashjoin TO false;
+SET enable_mergejoin TO false;
+SET enable_material TO false;
+SELECT count(*), sum(t1.a), sum(t2.a)
+  FROM prefetch_ft1 t1, (SELECT * FROM prefetch_ft2 OFFSET 0) t2
+  WHERE t1.a = t2.a;
+RESET enable_hashjoin;
+RESET enable_mergejoin;
+RESET enable_material;
+-- another query runs on the connection between fetches from a cursor
+BEGIN;
+DECLARE c CURSOR FOR SELECT a FROM prefetch_ft1 WHERE random() >= 0 ORDER BY a;
+MOVE 12 IN c;
+SELECT count(*) FROM prefetch_ft2 WHERE random() >= 0;
+FETCH 2 FROM c;
+COMMIT;
+
+-- Clean up
+DROP FOREIGN TABLE prefetch_ft1, prefetch_ft2;
+DROP TABLE prefetch_tbl1, prefetch_tbl2;
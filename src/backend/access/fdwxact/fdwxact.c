@@ -36,10 +36,21 @@
  * transaction.  Also, the user can use pg_resolve_foreign_xact() SQL function to
  * resolve a foreign transaction manually.
  *
- * At PREPARE TRANSACTION, we prepare all transactions on foreign servers by executing
- * PrepareForeignTransaction() API regardless of data on the foreign server having been
- * modified.  At COMMIT PREPARED and ROLLBACK PREPARED, we commit or rollback only the
- * local transaction but not do anything for involved foreign transactions.
+ * At PREPARE TRANSACTION, we prepare the transactions on all foreign servers that
+ * have been modified by executing PrepareForeignTransaction() API.  At COMMIT PREPARED
+ * and ROLLBACK PREPARED, we commit or rollback only the local transaction but not do
+ * anything for involved foreign transactions.
+ *
+ * Foreign servers that have not been modified don't take part in two-phase commit.
+ * Their transactions are committed in one-phase before preparing the others, since
+ * there is nothing to lose by committing a read-only transaction early.
+ *
+ * The protocol is presumed abort: a prepared foreign transaction whose local
+ * transaction is not known as committed is rolled back.  Hence, aborting never
+ * needs to make anything durable.  A foreign transaction that was never asked to
+ * prepare is forgotten at once by the aborting backend, and the removal of a
+ * rolled back foreign transaction is logged without flushing WAL, since it's
+ * harmless to roll it back again after a crash.
  *
  * LOCKING
  *
@@ -53,29 +64,34 @@
  * * A process who is going to process foreign transaction needs to set
  *   locking_backend of the FdwXact entry to lock the entry, which prevents the entry from
  *	 being updated and removed by concurrent processes.
+ * * Entries are indexed by local transaction id in FdwXactXidHash, which is
+ *	 also protected by FdwXactLock.  Entries of the same local transaction are
+ *	 chained through xid_next, so looking up an entry doesn't need to scan
+ *	 the whole FdwXactCtl->fdwxacts array.
  *
  * RECOVERY
  *
- * During replay WAL and replication FdwXactCtl also holds information about
- * active prepared foreign transaction that haven't been moved to disk yet.
+ * An FdwXact entry holds everything that is logged about its foreign
+ * transaction, so the entries are made durable by writing them all out to a
+ * single snapshot file, pg_fdwxact/snapshot, at every checkpoint.  Recovery
+ * starts from the snapshot of the checkpoint it begins at and replays the
+ * fdwxact records after it:
  *
- * Replay of fdwxact records happens by the following rules:
+ * * At the beginning of recovery, the snapshot file is read with one
+ *	 sequential read, filling FdwXactCtl->fdwxacts with entries marked with
+ *	 fdwxact->inredo.
+ * * On INSERT redo, the foreign transactions are added to
+ *	 FdwXactCtl->fdwxacts unless the snapshot already had them.  We set
+ *	 fdwxact->inredo to true for such entries.
+ * * On REMOVE redo and on resolution we delete the entry from
+ *	 FdwXactCtl->fdwxacts.  There is no file to delete, the entry just
+ *	 doesn't make it to the next snapshot.
+ * * On Checkpoint we write all entries that are behind the redo_horizon to
+ *	 the snapshot file, replacing the previous one atomically.
+ * * RecoverFdwXacts() and PrescanFdwXacts() go through the entries in shared
+ *	 memory without reading anything back from disk or WAL.
  *
- * * At the beginning of recovery, pg_fdwxacts is scanned once, filling FdwXact
- *	 with entries marked with fdwxact->inredo and fdwxact->ondisk.	FdwXact file
- *	 data older than the XID horizon of the redo position are discarded.
- * * On PREPARE redo, the foreign transaction is added to FdwXactCtl->fdwxacts.
- *	 We set fdwxact->inredo to true for such entries.
- * * On Checkpoint we iterate through FdwXactCtl->fdwxacts entries that
- *	 have fdwxact->inredo set and are behind the redo_horizon.	We save
- *	 them to disk and then set fdwxact->ondisk to true.
- * * On resolution we delete the entry from FdwXactCtl->fdwxacts.  If
- *	 fdwxact->ondisk is true, the corresponding entry from the disk is
- *	 additionally deleted.
- * * RecoverFdwXacts() and PrescanFdwXacts() have been modified to go through
- *	 fdwxact->inredo entries that have not made it to disk.
- *
- * These replay rules are borrowed from twophase.c
+ * These replay rules are adapted from twophase.c
  *
  * Portions Copyright (c) 2020, PostgreSQL Global Development Group
  *
@@ -115,6 +131,8 @@
 #include "utils/guc.h"
 #include "utils/memutils.h"
 #include "utils/rel.h"
+#include "utils/timeout.h"
+#include "utils/timestamp.h"
 
 /* Check the FdwXactParticipant is capable of two-phase commit  */
 #define ServerSupportTransactionCallback(fdw_part) \
@@ -124,6 +142,24 @@
 #define SeverSupportGlobalSnapshots(fdw_part) \
 (((FdwXactParticipant *)(fdw_part))->prepare_foreign_CSN_snapshot_fn != NULL)
 
+/*
+ * Check the FdwXactParticipant assigns the global CSN before the local commit.
+ * Otherwise the global CSN is passed to CommitForeignTransaction.
+ */
+#define ServerSupportAssignGlobalCSN(fdw_part) \
+	(((FdwXactParticipant *)(fdw_part))->assign_global_CSN_fn != NULL)
+
+/* Check the FdwXactParticipant can send requests without waiting for them */
+#define ServerSupportAsyncPrepare(fdw_part) \
+	(((FdwXactParticipant *)(fdw_part))->send_prepare_foreign_xact_fn != NULL && \
+	 ((FdwXactParticipant *)(fdw_part))->wait_prepare_foreign_xact_fn != NULL)
+#define ServerSupportAsyncPrepareCSN(fdw_part) \
+	(((FdwXactParticipant *)(fdw_part))->send_prepare_foreign_CSN_snapshot_fn != NULL && \
+	 ((FdwXactParticipant *)(fdw_part))->wait_prepare_foreign_CSN_snapshot_fn != NULL)
+#define ServerSupportAsyncAssignCSN(fdw_part) \
+	(((FdwXactParticipant *)(fdw_part))->send_assign_global_CSN_fn != NULL && \
+	 ((FdwXactParticipant *)(fdw_part))->wait_assign_global_CSN_fn != NULL)
+
 /* Foreign twophase commit is enabled and requested by user */
 #define IsForeignTwophaseCommitRequested() \
 	 (foreign_twophase_commit > FOREIGN_TWOPHASE_COMMIT_DISABLED)
@@ -132,18 +168,26 @@
 #define FDWXACTS_DIR "pg_fdwxact"
 
 /*
- * Name of foreign prepared transaction file is 8 bytes database oid,
- * xid, foreign server oid and user oid separated by '_'.
- *
- * Since FdwXact stat file is created per foreign transaction in a
- * distributed transaction and the xid of unresolved distributed
- * transaction never reused, the name is fairly enough to ensure
- * uniqueness.
+ * Snapshot of the foreign transactions, written at checkpoint.  It's written
+ * to the temporary file first and renamed into place, so that a crash in the
+ * middle leaves the previous snapshot intact.
+ */
+#define FDWXACT_SNAPSHOT_FILE		FDWXACTS_DIR "/snapshot"
+#define FDWXACT_SNAPSHOT_TMPFILE	FDWXACTS_DIR "/snapshot.tmp"
+
+#define FDWXACT_SNAPSHOT_MAGIC		0x46585332	/* "FXS2" */
+
+/*
+ * The snapshot file consists of this header, nentries FdwXactOnDiskData
+ * entries and the CRC of everything before it.
  */
-#define FDWXACT_FILE_NAME_LEN (8 + 1 + 8 + 1 + 8 + 1 + 8)
-#define FdwXactFilePath(path, dbid, xid, serverid, userid)	\
-	snprintf(path, MAXPGPATH, FDWXACTS_DIR "/%08X_%08X_%08X_%08X", \
-			 dbid, xid, serverid, userid)
+typedef struct FdwXactSnapshotHeader
+{
+	uint32		magic;			/* FDWXACT_SNAPSHOT_MAGIC */
+	int			nentries;		/* number of entries following */
+} FdwXactSnapshotHeader;
+
+#define SizeOfFdwXactSnapshotHeader	MAXALIGN(sizeof(FdwXactSnapshotHeader))
 
 /*
  * Structure to bundle the foreign transaction participant.	 This struct
@@ -162,11 +206,19 @@ typedef struct FdwXactParticipant
 	ForeignServer *server;
 	UserMapping *usermapping;
 
-	/* Transaction identifier used for PREPARE */
+	/* Global transaction identifier and its rendering used for PREPARE */
+	FdwXactId	fxid;
 	char	   *fdwxact_id;
 
 	/* true if modified the data on the server */
 	bool		modified;
+
+	/* true if we have asked the server to prepare the transaction */
+	bool		prepare_sent;
+
+	/* when the pending asynchronous request was sent, for statistics */
+	instr_time	request_start;
+
 	CSN         csn;
 	CSN         global_csn;
 
@@ -178,6 +230,13 @@ typedef struct FdwXactParticipant
 	/* Callbacks for global snapshots */
 	PrepareForeignCSNSnapshot_function prepare_foreign_CSN_snapshot_fn;
 	AssignGlobalCSN_function assign_global_CSN_fn;
+	/* Optional asynchronous callbacks, see FdwXactPrepareForeignTransactions */
+	SendPrepareForeignTransaction_function send_prepare_foreign_xact_fn;
+	WaitPrepareForeignTransaction_function wait_prepare_foreign_xact_fn;
+	SendPrepareForeignCSNSnapshot_function send_prepare_foreign_CSN_snapshot_fn;
+	WaitPrepareForeignCSNSnapshot_function wait_prepare_foreign_CSN_snapshot_fn;
+	SendAssignGlobalCSN_function send_assign_global_CSN_fn;
+	WaitAssignGlobalCSN_function wait_assign_global_CSN_fn;
 } FdwXactParticipant;
 
 /*
@@ -190,45 +249,112 @@ typedef struct FdwXactParticipant
 static List *FdwXactParticipants = NIL;
 static bool ForeignTwophaseCommitIsRequired = false;
 
+/*
+ * Prepared foreign transactions of committed local transactions, which this
+ * backend commits itself before it reports ready for query.  See
+ * FdwXactDeferCommitPrepared().
+ */
+static List *FdwXactPendingCommits = NIL;
+
+/*
+ * Set by FdwXactResolvePendingCommits() for the transaction it starts, which
+ * must not release FdwXactPendingCommits in AtStart_FdwXact().
+ */
+static bool FdwXactResolvingPendingCommits = false;
+
+/* Time to wait for each foreign server in FdwXactResolvePendingCommits */
+#define FDWXACT_BACKEND_COMMIT_TIMEOUT	30000	/* ms */
+
 /* Keep track of registering process exit call back. */
 static bool fdwXactExitRegistered = false;
 
+/*
+ * Entry of FdwXactXidHash, the shared hash table indexing FdwXact entries by
+ * local transaction id.
+ */
+typedef struct FdwXactXidEntry
+{
+	TransactionId xid;			/* hash key */
+	FdwXact		fdwxacts;		/* entries of this transaction, chained
+								 * through xid_next */
+	int			heap_idx;		/* position in FdwXactXidHeap */
+} FdwXactXidEntry;
+
+static HTAB *FdwXactXidHash;
+
+/*
+ * Min-heap of FdwXactXidEntry by xid, so that the oldest local transaction
+ * having foreign transactions is always at the top.  FdwXactCtl->num_xids
+ * entries are used.
+ */
+static FdwXactXidEntry **FdwXactXidHeap;
+
+/*
+ * Entry of FdwXactServerHash, the shared hash table indexing FdwXact entries
+ * by database and foreign server.
+ */
+typedef struct FdwXactServerKey
+{
+	Oid			dbid;
+	Oid			serverid;
+} FdwXactServerKey;
+
+typedef struct FdwXactServerEntry
+{
+	FdwXactServerKey key;		/* hash key */
+	int			count;			/* number of entries in fdwxacts */
+	dlist_head	fdwxacts;		/* entries linked through server_node, the
+								 * oldest first */
+} FdwXactServerEntry;
+
+static HTAB *FdwXactServerHash;
+
 
 /* Guc parameter */
 int			max_prepared_foreign_xacts = 0;
 int			max_foreign_xact_resolvers = 0;
 int			foreign_twophase_commit = FOREIGN_TWOPHASE_COMMIT_DISABLED;
 bool		enable_global_snapshot = false;
+bool		foreign_xact_resolve_in_backend = false;
 
 static void AtProcExit_FdwXact(int code, Datum arg);
-static void FdwXactPrepareForeignTransactions(TransactionId xid, bool prepare_all);
+static void FdwXactPrepareForeignTransactions(TransactionId xid);
 static void ForgetAllFdwXactParticipants(void);
+static void FdwXactCommitOnePhase(void);
+static void FdwXactDeferCommitPrepared(void);
+static void FdwXactReleasePendingCommits(void);
 static void FdwXactParticipantEndTransaction(FdwXactParticipant *fdw_part,
 											 bool commit);
-static FdwXact FdwXactInsertFdwXactEntry(TransactionId xid,
-										 FdwXactParticipant *fdw_part);
+static void FdwXactInsertFdwXactEntries(TransactionId xid);
 static void FdwXactComputeRequiredXmin(void);
 static FdwXactStatus FdwXactGetTransactionFate(TransactionId xid);
-static void FdwXactResolveOneFdwXact(FdwXact fdwxact);
-static void FdwXactRedoAdd(char *buf, XLogRecPtr start_lsn, XLogRecPtr end_lsn);
+static void FdwXactInitRslvState(FdwXact fdwxact, FdwRoutine *routine,
+								 FdwXactRslvState *state);
+static int	fdwxact_rslv_cmp(const void *a, const void *b);
+static void FdwXactRedoAdd(char *buf, XLogRecPtr end_lsn);
 static void FdwXactRedoRemove(Oid dbid, TransactionId xid, Oid serverid,
-							  Oid userid, bool givewarning);
-static void XlogReadFdwXactData(XLogRecPtr lsn, char **buf, int *len);
-static char *ProcessFdwXactBuffer(Oid dbid, TransactionId xid, Oid serverid,
-								  Oid userid, XLogRecPtr insert_start_lsn,
-								  bool fromdisk);
-static char *ReadFdwXactFile(Oid dbid, TransactionId xid, Oid serverid, Oid userid);
-static void RemoveFdwXactFile(Oid dbid, TransactionId xid, Oid serverid, Oid userid,
-							  bool giveWarning);
+							  Oid userid);
+static bool FdwXactRejectFutureXid(FdwXact fdwxact);
 static bool checkForeignTwophaseCommitRequired(bool local_modified);
 static FdwXact insert_fdwxact(Oid dbid, TransactionId xid, Oid serverid, Oid userid,
-							  Oid umid, char *fdwxact_id);
+							  Oid umid, FdwXactId *fxid);
 static void remove_fdwxact(FdwXact fdwxact);
 static FdwXactParticipant *create_fdwxact_participant(Oid serverid, Oid userid,
 													  FdwRoutine *routine);
 static char *get_fdwxact_identifier(FdwXactParticipant *fdw_part,
-									TransactionId xid);
-static int	get_fdwxact(Oid dbid, TransactionId xid, Oid serverid, Oid userid);
+									TransactionId xid, uint32 index);
+static void render_fdwxact_id(FdwXactId *fxid, Oid serverid, Oid userid,
+							  GetPrepareId_function get_prepareid_fn,
+							  char *buf);
+static void set_fdwxact_rslv_state(FdwXactRslvState *state,
+								   FdwXactParticipant *fdw_part);
+static FdwXact get_fdwxact(Oid dbid, TransactionId xid, Oid serverid,
+						   Oid userid);
+static Size FdwXactCtlShmemSize(void);
+static void xid_heap_add(FdwXactXidEntry *xid_entry);
+static void xid_heap_remove(FdwXactXidEntry *xid_entry);
+static void xid_heap_sift_up(int idx);
+static void xid_heap_sift_down(int idx);
 
 /*
  * Calculates the size of shared memory allocated for maintaining foreign
@@ -239,7 +365,27 @@ FdwXactShmemSize(void)
 {
 	Size		size;
 
-	/* Size for foreign transaction information array */
+	size = FdwXactCtlShmemSize();
+
+	/* Size for the indexes of the entries, allocated by ShmemInitHash */
+	size = add_size(size, hash_estimate_size(Max(max_prepared_foreign_xacts, 1),
+											 sizeof(FdwXactXidEntry)));
+	size = add_size(size, hash_estimate_size(Max(max_prepared_foreign_xacts, 1),
+											 sizeof(FdwXactServerEntry)));
+	size = add_size(size, mul_size(Max(max_prepared_foreign_xacts, 1),
+								   sizeof(FdwXactXidEntry *)));
+
+	return size;
+}
+
+/*
+ * Size of the foreign transaction information array and its entries.
+ */
+static Size
+FdwXactCtlShmemSize(void)
+{
+	Size		size;
+
 	size = offsetof(FdwXactCtlData, fdwxacts);
 	size = add_size(size, mul_size(max_prepared_foreign_xacts,
 								   sizeof(FdwXact)));
@@ -259,10 +405,32 @@ void
 FdwXactShmemInit(void)
 {
 	bool		found;
+	HASHCTL		info;
+	long		hash_size = Max(max_prepared_foreign_xacts, 1);
 
 	FdwXactCtl = ShmemInitStruct("Foreign transactions table",
-								 FdwXactShmemSize(),
+								 FdwXactCtlShmemSize(),
 								 &found);
+
+	memset(&info, 0, sizeof(info));
+	info.keysize = sizeof(TransactionId);
+	info.entrysize = sizeof(FdwXactXidEntry);
+	FdwXactXidHash = ShmemInitHash("Foreign transactions xid hash",
+								   hash_size, hash_size, &info,
+								   HASH_ELEM | HASH_BLOBS | HASH_FIXED_SIZE);
+
+	memset(&info, 0, sizeof(info));
+	info.keysize = sizeof(FdwXactServerKey);
+	info.entrysize = sizeof(FdwXactServerEntry);
+	FdwXactServerHash = ShmemInitHash("Foreign transactions server hash",
+									  hash_size, hash_size, &info,
+									  HASH_ELEM | HASH_BLOBS | HASH_FIXED_SIZE);
+
+	FdwXactXidHeap = ShmemInitStruct("Foreign transactions xid heap",
+									 mul_size(hash_size,
+											  sizeof(FdwXactXidEntry *)),
+									 &found);
+
 	if (!IsUnderPostmaster)
 	{
 		FdwXact		fdwxacts;
@@ -271,6 +439,7 @@ FdwXactShmemInit(void)
 		Assert(!found);
 		FdwXactCtl->free_fdwxacts = NULL;
 		FdwXactCtl->num_fdwxacts = 0;
+		FdwXactCtl->num_xids = 0;
 
 		/* Initialize the linked list of free FDW transactions */
 		fdwxacts = (FdwXact)
@@ -280,6 +449,8 @@ FdwXactShmemInit(void)
 		for (cnt = 0; cnt < max_prepared_foreign_xacts; cnt++)
 		{
 			fdwxacts[cnt].status = FDWXACT_STATUS_INVALID;
+			fdwxacts[cnt].xid_next = NULL;
+			fdwxacts[cnt].ctl_idx = -1;
 			fdwxacts[cnt].fdwxact_free_next = FdwXactCtl->free_fdwxacts;
 			FdwXactCtl->free_fdwxacts = &fdwxacts[cnt];
 			SpinLockInit(&fdwxacts[cnt].mutex);
@@ -390,6 +561,7 @@ create_fdwxact_participant(Oid serverid, Oid userid, FdwRoutine *routine)
 	fdw_part->usermapping = user_mapping;
 	fdw_part->fdwxact_id = NULL;
 	fdw_part->modified = false;
+	fdw_part->prepare_sent = false;
 	fdw_part->csn = 0;
 	fdw_part->global_csn = 0;
 	fdw_part->commit_foreign_xact_fn = routine->CommitForeignTransaction;
@@ -398,12 +570,20 @@ create_fdwxact_participant(Oid serverid, Oid userid, FdwRoutine *routine)
 	fdw_part->get_prepareid_fn = routine->GetPrepareId;
 	fdw_part->prepare_foreign_CSN_snapshot_fn = routine->PrepareForeignCSNSnapshot;
 	fdw_part->assign_global_CSN_fn = routine->AssignGlobalCSN;
+	fdw_part->send_prepare_foreign_xact_fn = routine->SendPrepareForeignTransaction;
+	fdw_part->wait_prepare_foreign_xact_fn = routine->WaitPrepareForeignTransaction;
+	fdw_part->send_prepare_foreign_CSN_snapshot_fn = routine->SendPrepareForeignCSNSnapshot;
+	fdw_part->wait_prepare_foreign_CSN_snapshot_fn = routine->WaitPrepareForeignCSNSnapshot;
+	fdw_part->send_assign_global_CSN_fn = routine->SendAssignGlobalCSN;
+	fdw_part->wait_assign_global_CSN_fn = routine->WaitAssignGlobalCSN;
 
 	return fdw_part;
 }
 
  /*
  * Prepare all foreign transactions if foreign twophase commit is required.
+ * If only one participant has modified data, we instead commit all foreign
+ * transactions in one-phase here, whatever foreign_twophase_commit is.
  * When foreign twophase commit is enabled, the behavior depends on the value
  * of foreign_twophase_commit; when 'required' we strictly require for all
  * foreign servers' FDW to support two-phase commit protocol and ask them to
@@ -416,6 +596,8 @@ PreCommit_FdwXact(void)
 {
 	TransactionId xid;
 	bool		local_modified;
+	int			nwriters;
+	ListCell   *lc;
 
 	/* If there are no foreign servers involved, we have no business here */
 	if (FdwXactParticipants == NIL)
@@ -424,16 +606,37 @@ PreCommit_FdwXact(void)
 	Assert(!RecoveryInProgress());
 
 	/*
-	 * Check if the current transaction did writes.	 We need to include the
-	 * local node to the distributed transaction participant and to regard it
-	 * as modified, if the current transaction has performed WAL logging and
-	 * has assigned an xid.	 The transaction can end up not writing any WAL,
-	 * even if it has an xid, if it only wrote to temporary and/or unlogged
-	 * tables.	It can end up having written WAL without an xid if did HOT
-	 * pruning.
+	 * Check if the current transaction did writes.  We include the local node
+	 * in the distributed transaction participants and regard it as modified
+	 * if the current transaction has been assigned an xid, even if it only
+	 * wrote to temporary and/or unlogged tables and so wrote no WAL: its
+	 * commit can still fail after we have committed a foreign transaction
+	 * in one-phase.  It can end up having written WAL without an xid if did
+	 * HOT pruning, which doesn't matter.
 	 */
 	xid = GetTopTransactionIdIfAny();
-	local_modified = (TransactionIdIsValid(xid) && (XactLastRecEnd != 0));
+	local_modified = TransactionIdIsValid(xid);
+
+	/*
+	 * If at most one participant, including the local node, has modified
+	 * data, the distributed transaction commits atomically without two-phase
+	 * commit as long as that participant commits last.  If it's a foreign
+	 * server, the local transaction has no xid, so nothing after this can
+	 * make it fail.
+	 */
+	nwriters = local_modified ? 1 : 0;
+	foreach(lc, FdwXactParticipants)
+	{
+		FdwXactParticipant *fdw_part = (FdwXactParticipant *) lfirst(lc);
+
+		if (fdw_part->modified)
+			nwriters++;
+	}
+	if (nwriters <= 1)
+	{
+		FdwXactCommitOnePhase();
+		return;
+	}
 
 	/*
 	 * Check if we need to use foreign twophase commit. Note that we don't
@@ -451,11 +654,55 @@ PreCommit_FdwXact(void)
 		 */
 		if (!TransactionIdIsValid(xid))
 			xid = GetTopTransactionId();
-		FdwXactPrepareForeignTransactions(xid, false);
+		FdwXactPrepareForeignTransactions(xid);
 		ForeignTwophaseCommitIsRequired = true;
 	}
 }
 
+/*
+ * Commit all foreign transactions in one-phase before the local commit, when
+ * at most one participant has modified data.  The read-only ones are
+ * committed first and the modifying one last, so that it decides the outcome
+ * of the distributed transaction (last agent optimization): if committing it
+ * fails, the local transaction is rolled back and nothing else has changed.
+ * If the local node is the one that modified data, it commits after all of
+ * them.
+ *
+ * Committed participants are removed from FdwXactParticipants, so that we
+ * don't roll them back if an error occurs later.
+ */
+static void
+FdwXactCommitOnePhase(void)
+{
+	FdwXactParticipant *writer = NULL;
+	ListCell   *lc;
+
+	foreach(lc, FdwXactParticipants)
+	{
+		FdwXactParticipant *fdw_part = (FdwXactParticipant *) lfirst(lc);
+
+		CHECK_FOR_INTERRUPTS();
+
+		if (fdw_part->modified)
+		{
+			Assert(writer == NULL);
+			writer = fdw_part;
+			continue;
+		}
+
+		FdwXactParticipantEndTransaction(fdw_part, true);
+		FdwXactParticipants = foreach_delete_current(FdwXactParticipants, lc);
+	}
+
+	if (writer)
+	{
+		FdwXactParticipantEndTransaction(writer, true);
+		FdwXactParticipants = list_delete_ptr(FdwXactParticipants, writer);
+	}
+
+	Assert(FdwXactParticipants == NIL);
+}
+
 /* Return true if the current transaction needs to use two-phase commit */
 bool
 FdwXactIsForeignTwophaseCommitRequired(void)
@@ -526,150 +773,329 @@ checkForeignTwophaseCommitRequired(bool local_modified)
 }
 
 /*
- * Insert FdwXact entries and prepare foreign transactions.  If prepare_all is
- * true, we prepare all foreign transaction regardless of writes having happened
- * on the server.
+ * Insert FdwXact entries and prepare foreign transactions.  Participants that
+ * have not been modified are committed in one-phase and removed from
+ * FdwXactParticipants instead, so that they cost neither WAL nor the second
+ * round trip.
  *
  * We still can change to rollback here on failure. If any error occurs, we
  * rollback non-prepared foreign transactions.
+ *
+ * Each step is done for all participants at once rather than participant by
+ * participant: we first persist all FdwXact entries, then send PREPARE to every
+ * server whose FDW provides the asynchronous callbacks and only after that
+ * collect the results.  The same is done for preparing and assigning the
+ * global CSN.  Thus the latency of preparing is roughly one round trip to the
+ * slowest server per step, rather than the sum of round trips to all servers.
+ * Participants whose FDW supports only the synchronous callbacks are processed
+ * in between sending and waiting.
  */
 static void
-FdwXactPrepareForeignTransactions(TransactionId xid, bool prepare_all)
+FdwXactPrepareForeignTransactions(TransactionId xid)
 {
 	ListCell   *lc;
+	uint32		index = 0;
 	CSN max_csn = 0;
 	CSN my_csn = 0;
 
 	Assert(FdwXactParticipants != NIL);
 	Assert(TransactionIdIsValid(xid));
 
-	/* Loop over the foreign connections */
+	/*
+	 * Insert the foreign transaction entries with the
+	 * FDWXACT_STATUS_PREPARING status. Registration persists this information
+	 * to the disk and logs (that way relaying it on standby).  Thus in case we
+	 * loose connectivity to the foreign server or crash ourselves, we will
+	 * remember that we might have prepared transaction on the foreign server
+	 * and try to resolve it when connectivity is restored or after crash
+	 * recovery.
+	 *
+	 * If we prepare the transaction on the foreign server before persisting
+	 * the information to the disk and crash in-between these two steps, we
+	 * will lost the prepared transaction on the foreign server and will not be
+	 * able to resolve it after the crash recovery.  Hence persist all entries
+	 * first then prepare.
+	 */
 	foreach(lc, FdwXactParticipants)
 	{
 		FdwXactParticipant *fdw_part = (FdwXactParticipant *) lfirst(lc);
-		FdwXactRslvState state;
-		FdwXact		fdwxact;
-
-		Assert(ServerSupportTwophaseCommit(fdw_part));
 
 		CHECK_FOR_INTERRUPTS();
 
-		if (!prepare_all && !fdw_part->modified)
+		/*
+		 * A read-only participant votes for commit whatever happens to the
+		 * others, so commit it now.  If we fail afterwards, the distributed
+		 * transaction is rolled back without the need to undo anything on
+		 * this server.
+		 */
+		if (!fdw_part->modified)
+		{
+			FdwXactParticipantEndTransaction(fdw_part, true);
+			FdwXactParticipants = foreach_delete_current(FdwXactParticipants,
+														 lc);
 			continue;
+		}
+
+		Assert(ServerSupportTwophaseCommit(fdw_part));
 
 		/* Get prepared transaction identifier */
-		fdw_part->fdwxact_id = get_fdwxact_identifier(fdw_part, xid);
+		fdw_part->fdwxact_id = get_fdwxact_identifier(fdw_part, xid, index++);
 		Assert(fdw_part->fdwxact_id);
+	}
 
-		/*
-		 * Insert the foreign transaction entry with the
-		 * FDWXACT_STATUS_PREPARING status. Registration persists this
-		 * information to the disk and logs (that way relaying it on standby).
-		 * Thus in case we loose connectivity to the foreign server or crash
-		 * ourselves, we will remember that we might have prepared transaction
-		 * on the foreign server and try to resolve it when connectivity is
-		 * restored or after crash recovery.
-		 *
-		 * If we prepare the transaction on the foreign server before
-		 * persisting the information to the disk and crash in-between these
-		 * two steps, we will lost the prepared transaction on the foreign
-		 * server and will not be able to resolve it after the crash recovery.
-		 * Hence persist first then prepare.
-		 */
-		fdwxact = FdwXactInsertFdwXactEntry(xid, fdw_part);
+	if (FdwXactParticipants == NIL)
+		return;
 
-		/*
-		 * Prepare the foreign transaction.
-		 *
-		 * Between FdwXactInsertFdwXactEntry call till this backend hears
-		 * acknowledge from foreign server, the backend may abort the local
-		 * transaction (say, because of a signal).
-		 */
-		state.server = fdw_part->server;
-		state.usermapping = fdw_part->usermapping;
-		state.fdwxact_id = fdw_part->fdwxact_id;
+	FdwXactInsertFdwXactEntries(xid);
+
+	/*
+	 * Prepare the foreign transactions.
+	 *
+	 * Between FdwXactInsertFdwXactEntries call till this backend hears
+	 * acknowledge from foreign server, the backend may abort the local
+	 * transaction (say, because of a signal).
+	 */
+	foreach(lc, FdwXactParticipants)
+	{
+		FdwXactParticipant *fdw_part = (FdwXactParticipant *) lfirst(lc);
+		FdwXactRslvState state;
+
+		if (!fdw_part->fdwxact || !ServerSupportAsyncPrepare(fdw_part))
+			continue;
+
+		set_fdwxact_rslv_state(&state, fdw_part);
+		fdw_part->prepare_sent = true;
+		INSTR_TIME_SET_CURRENT(fdw_part->request_start);
+		fdw_part->send_prepare_foreign_xact_fn(&state);
+	}
+
+	foreach(lc, FdwXactParticipants)
+	{
+		FdwXactParticipant *fdw_part = (FdwXactParticipant *) lfirst(lc);
+		FdwXactRslvState state;
+		instr_time	start;
+
+		if (!fdw_part->fdwxact || ServerSupportAsyncPrepare(fdw_part))
+			continue;
+
+		CHECK_FOR_INTERRUPTS();
+
+		set_fdwxact_rslv_state(&state, fdw_part);
+		fdw_part->prepare_sent = true;
+		INSTR_TIME_SET_CURRENT(start);
 		fdw_part->prepare_foreign_xact_fn(&state);
+		pgstat_count_fdwxact(fdw_part->server->serverid,
+							 PGSTAT_FDWXACT_PREPARE, 1, start);
+		fdw_part->csn = state.csn;
 
-		if (is_global_snapshot_enabled() &&
-			SeverSupportGlobalSnapshots(fdw_part))
+		/* succeeded, update status */
+		SpinLockAcquire(&fdw_part->fdwxact->mutex);
+		fdw_part->fdwxact->status = FDWXACT_STATUS_PREPARED;
+		SpinLockRelease(&fdw_part->fdwxact->mutex);
+	}
+
+	foreach(lc, FdwXactParticipants)
+	{
+		FdwXactParticipant *fdw_part = (FdwXactParticipant *) lfirst(lc);
+		FdwXactRslvState state;
+
+		if (!fdw_part->fdwxact || !ServerSupportAsyncPrepare(fdw_part))
+			continue;
+
+		set_fdwxact_rslv_state(&state, fdw_part);
+		fdw_part->wait_prepare_foreign_xact_fn(&state);
+		pgstat_count_fdwxact(fdw_part->server->serverid,
+							 PGSTAT_FDWXACT_PREPARE, 1,
+							 fdw_part->request_start);
+		fdw_part->csn = state.csn;
+
+		/* succeeded, update status */
+		SpinLockAcquire(&fdw_part->fdwxact->mutex);
+		fdw_part->fdwxact->status = FDWXACT_STATUS_PREPARED;
+		SpinLockRelease(&fdw_part->fdwxact->mutex);
+	}
+
+	if (!is_global_snapshot_enabled())
+		return;
+
+	/*
+	 * Collect the prepare CSNs of the prepared foreign transactions, unless
+	 * the FDW has already returned it when preparing.
+	 */
+	foreach(lc, FdwXactParticipants)
+	{
+		FdwXactParticipant *fdw_part = (FdwXactParticipant *) lfirst(lc);
+		FdwXactRslvState state;
+
+		if (!fdw_part->fdwxact || !SeverSupportGlobalSnapshots(fdw_part) ||
+			fdw_part->csn != InvalidCSN ||
+			!ServerSupportAsyncPrepareCSN(fdw_part))
+			continue;
+
+		set_fdwxact_rslv_state(&state, fdw_part);
+		INSTR_TIME_SET_CURRENT(fdw_part->request_start);
+		fdw_part->send_prepare_foreign_CSN_snapshot_fn(&state);
+	}
+
+	foreach(lc, FdwXactParticipants)
+	{
+		FdwXactParticipant *fdw_part = (FdwXactParticipant *) lfirst(lc);
+		FdwXactRslvState state;
+		instr_time	start;
+
+		if (!fdw_part->fdwxact || !SeverSupportGlobalSnapshots(fdw_part))
+			continue;
+
+		if (fdw_part->csn != InvalidCSN)
 		{
-			fdw_part->csn = fdw_part->prepare_foreign_CSN_snapshot_fn(&state);
 			if (max_csn < fdw_part->csn)
 				max_csn = fdw_part->csn;
+			continue;
 		}
 
-		/* succeeded, update status */
-		SpinLockAcquire(&fdwxact->mutex);
-		fdwxact->status = FDWXACT_STATUS_PREPARED;
-		SpinLockRelease(&fdwxact->mutex);
-	}
+		set_fdwxact_rslv_state(&state, fdw_part);
+		if (ServerSupportAsyncPrepareCSN(fdw_part))
+		{
+			start = fdw_part->request_start;
+			fdw_part->csn = fdw_part->wait_prepare_foreign_CSN_snapshot_fn(&state);
+		}
+		else
+		{
+			INSTR_TIME_SET_CURRENT(start);
+			fdw_part->csn = fdw_part->prepare_foreign_CSN_snapshot_fn(&state);
+		}
+		pgstat_count_fdwxact(fdw_part->server->serverid,
+							 PGSTAT_FDWXACT_CSN_PREPARE, 1, start);
 
-    if (!is_global_snapshot_enabled())
-		return;
+		if (max_csn < fdw_part->csn)
+			max_csn = fdw_part->csn;
+	}
 
 	/* before finishing prepare, assign the max csn */
 	my_csn = CSNSnapshotPrepareCurrent();
 	if (max_csn < my_csn)
 		max_csn = my_csn;
 	/* TODO: do we need to xlog max_csn? */
-	/* Loop over the foreign connections and set max csn */
+
+	/*
+	 * Loop over the foreign connections and set max csn.  Participants whose
+	 * FDW doesn't provide AssignGlobalCSN get the global CSN when committing
+	 * the prepared transaction, which is the same as the CSN of the local
+	 * transaction (see FdwXactInitRslvState).
+	 */
+	foreach(lc, FdwXactParticipants)
+	{
+		FdwXactParticipant *fdw_part = (FdwXactParticipant *) lfirst(lc);
+		FdwXactRslvState state;
+
+		if (!SeverSupportGlobalSnapshots(fdw_part) || !fdw_part->csn ||
+			!ServerSupportAssignGlobalCSN(fdw_part) ||
+			!ServerSupportAsyncAssignCSN(fdw_part))
+			continue;
+
+		set_fdwxact_rslv_state(&state, fdw_part);
+		INSTR_TIME_SET_CURRENT(fdw_part->request_start);
+		fdw_part->send_assign_global_CSN_fn(&state, max_csn);
+	}
+
 	foreach(lc, FdwXactParticipants)
 	{
 		FdwXactParticipant *fdw_part = (FdwXactParticipant *) lfirst(lc);
-		if (SeverSupportGlobalSnapshots(fdw_part) && fdw_part->csn)
+		FdwXactRslvState state;
+		instr_time	start;
+
+		if (!SeverSupportGlobalSnapshots(fdw_part) || !fdw_part->csn ||
+			!ServerSupportAssignGlobalCSN(fdw_part))
+			continue;
+
+		set_fdwxact_rslv_state(&state, fdw_part);
+		if (ServerSupportAsyncAssignCSN(fdw_part))
+		{
+			start = fdw_part->request_start;
+			fdw_part->wait_assign_global_CSN_fn(&state);
+		}
+		else
 		{
-			FdwXactRslvState state;
-			state.server = fdw_part->server;
-			state.usermapping = fdw_part->usermapping;
-			state.fdwxact_id = pstrdup(fdw_part->fdwxact_id);
+			INSTR_TIME_SET_CURRENT(start);
 			fdw_part->assign_global_CSN_fn(&state, max_csn);
 		}
+		pgstat_count_fdwxact(fdw_part->server->serverid,
+							 PGSTAT_FDWXACT_CSN_ASSIGN, 1, start);
 	}
+
 	/* Assign global CSN to local transaction */
 	CSNSnapshotAssignCurrent(max_csn);
 }
 
+/* Fill the state passed to FDW callbacks for the given prepared participant */
+static void
+set_fdwxact_rslv_state(FdwXactRslvState *state, FdwXactParticipant *fdw_part)
+{
+	state->server = fdw_part->server;
+	state->usermapping = fdw_part->usermapping;
+	strlcpy(state->fdwxact_id, fdw_part->fdwxact_id, FDWXACT_ID_MAX_LEN);
+	state->flags = 0;
+	state->csn = InvalidCSN;
+
+	if (is_global_snapshot_enabled() && SeverSupportGlobalSnapshots(fdw_part))
+		state->flags |= FDWXACT_FLAG_USE_GLOBAL_CSN;
+}
+
 /*
- * Return a null-terminated foreign transaction identifier.  If the given
- * foreign server's FDW provides getPrepareId callback we return the identifier
- * returned from it. Otherwise we generate an unique identifier with in the
- * form of "fx_<random number>_<xid>_<serverid>_<userid> whose length is
- * less than FDWXACT_ID_MAX_LEN.
+ * Assign the global transaction identifier to the participant, the index-th
+ * one of the local transaction xid, and return its null-terminated
+ * rendering, see render_fdwxact_id().
  *
  * Returned string value is used to identify foreign transaction. The
  * identifier should not be same as any other concurrent prepared transaction
- * identifier.
- *
- * To make the foreign transactionid unique, we should ideally use something
- * like UUID, which gives unique ids with high probability, but that may be
- * expensive here and UUID extension which provides the function to generate
- * UUID is not part of the core code.
+ * identifier.  The system identifier in the global transaction identifier
+ * tells apart the transactions of coordinators sharing a foreign server, and
+ * the random number those of coordinators cloned from the same one.
  */
 static char *
-get_fdwxact_identifier(FdwXactParticipant *fdw_part, TransactionId xid)
+get_fdwxact_identifier(FdwXactParticipant *fdw_part, TransactionId xid,
+					   uint32 index)
 {
-	char *id;
-	int	id_len;
+	char	   *id = palloc(FDWXACT_ID_MAX_LEN);
 
-	/*
-	 * If FDW doesn't provide the callback function, generate an unique
-	 * identifier.
-	 */
-	if (!fdw_part->get_prepareid_fn)
-	{
-		char		buf[FDWXACT_ID_MAX_LEN] = {0};
+	fdw_part->fxid.sysid = GetSystemIdentifier();
+	fdw_part->fxid.xid = xid;
+	fdw_part->fxid.index = index;
+	fdw_part->fxid.random = (uint32) random();
+
+	render_fdwxact_id(&fdw_part->fxid, fdw_part->server->serverid,
+					  fdw_part->usermapping->userid,
+					  fdw_part->get_prepareid_fn, id);
+	return id;
+}
 
-		snprintf(buf, FDWXACT_ID_MAX_LEN, "fx_%ld_%u_%d_%d",
-				 Abs(random()), xid, fdw_part->server->serverid,
-				 fdw_part->usermapping->userid);
+/*
+ * Render the prepared transaction identifier of a foreign transaction into
+ * buf, of FDWXACT_ID_MAX_LEN bytes.  If the given foreign server's FDW
+ * provides getPrepareId callback we use the identifier returned from it,
+ * which must be the same every time it's called for the same foreign
+ * transaction.  Otherwise the identifier is in the form of
+ * "fx_<system identifier>_<xid>_<participant index>_<random number>".
+ *
+ * Only FdwXactId is kept in shared memory and on disk, so this is called
+ * whenever the identifier is passed to the FDW.
+ */
+static void
+render_fdwxact_id(FdwXactId *fxid, Oid serverid, Oid userid,
+				  GetPrepareId_function get_prepareid_fn, char *buf)
+{
+	char	   *id;
+	int			id_len;
 
-		return pstrdup(buf);
+	if (!get_prepareid_fn)
+	{
+		snprintf(buf, FDWXACT_ID_MAX_LEN, FDWXACT_ID_FORMAT,
+				 fxid->sysid, fxid->xid, fxid->index, fxid->random);
+		return;
 	}
 
 	/* Get an unique identifier from callback function */
-	id = fdw_part->get_prepareid_fn(xid, fdw_part->server->serverid,
-									fdw_part->usermapping->userid,
-									&id_len);
+	id = get_prepareid_fn(fxid->xid, serverid, userid, &id_len);
 
 	if (id == NULL)
 		ereport(ERROR,
@@ -677,9 +1103,9 @@ get_fdwxact_identifier(FdwXactParticipant *fdw_part, TransactionId xid)
 				 (errmsg("foreign transaction identifier is not provided"))));
 
 	/* Check length of foreign transaction identifier */
-	if (id_len > FDWXACT_ID_MAX_LEN)
+	if (id_len >= FDWXACT_ID_MAX_LEN)
 	{
-		id[FDWXACT_ID_MAX_LEN] = '\0';
+		id[FDWXACT_ID_MAX_LEN - 1] = '\0';
 		ereport(ERROR,
 				(errcode(ERRCODE_NAME_TOO_LONG),
 				 errmsg("foreign transaction identifier \"%s\" is too long",
@@ -688,80 +1114,116 @@ get_fdwxact_identifier(FdwXactParticipant *fdw_part, TransactionId xid)
 						   FDWXACT_ID_MAX_LEN)));
 	}
 
-	id[id_len] = '\0';
-	return pstrdup(id);
+	memcpy(buf, id, id_len);
+	buf[id_len] = '\0';
 }
 
 /*
- * This function is used to create new foreign transaction entry before an FDW
- * prepares and commit/rollback. The function adds the entry to WAL and it will
- * be persisted to the disk under pg_fdwxact directory when checkpoint.
+ * This function is used to create new foreign transaction entries before the
+ * FDWs prepare and commit/rollback.  An entry is created for every
+ * participant that got a prepared transaction identifier.  All of them are
+ * added to WAL in a single record, so that a distributed transaction pays for
+ * one WAL flush however many servers it involves, and will be persisted to
+ * the snapshot file under pg_fdwxact directory when checkpoint.
  */
-static FdwXact
-FdwXactInsertFdwXactEntry(TransactionId xid, FdwXactParticipant *fdw_part)
+static void
+FdwXactInsertFdwXactEntries(TransactionId xid)
 {
-	FdwXact		fdwxact;
-	FdwXactOnDiskData *fdwxact_file_data;
+	ListCell   *lc;
+	List	   *new_parts = NIL;
+	xl_fdwxact_insert xlrec;
+	StringInfoData buf;
+	XLogRecPtr	end_lsn;
 	MemoryContext old_context;
-	int			data_len;
 
 	old_context = MemoryContextSwitchTo(TopTransactionContext);
 
 	/*
-	 * Enter the foreign transaction in the shared memory structure.
+	 * Enter the foreign transactions in the shared memory structure.
 	 */
 	LWLockAcquire(FdwXactLock, LW_EXCLUSIVE);
-	fdwxact = insert_fdwxact(MyDatabaseId, xid, fdw_part->server->serverid,
-							 fdw_part->usermapping->userid,
-							 fdw_part->usermapping->umid, fdw_part->fdwxact_id);
-	fdwxact->locking_backend = MyBackendId;
+	foreach(lc, FdwXactParticipants)
+	{
+		FdwXactParticipant *fdw_part = (FdwXactParticipant *) lfirst(lc);
+		FdwXact		fdwxact;
+
+		if (!fdw_part->fdwxact_id || fdw_part->fdwxact)
+			continue;
+
+		fdwxact = insert_fdwxact(MyDatabaseId, xid, fdw_part->server->serverid,
+								 fdw_part->usermapping->userid,
+								 fdw_part->usermapping->umid,
+								 &fdw_part->fxid);
+		fdwxact->locking_backend = MyBackendId;
+		fdw_part->fdwxact = fdwxact;
+		new_parts = lappend(new_parts, fdw_part);
+	}
 	LWLockRelease(FdwXactLock);
 
-	fdw_part->fdwxact = fdwxact;
 	MemoryContextSwitchTo(old_context);
 
+	if (new_parts == NIL)
+		return;
+
 	/*
-	 * Prepare to write the entry to a file. Also add xlog entry. The contents
-	 * of the xlog record are same as what is written to the file.
+	 * Prepare to write the entries to files. Also add xlog entry. The
+	 * contents of each entry in the xlog record are same as what is written
+	 * to its file.
 	 */
-	data_len = offsetof(FdwXactOnDiskData, fdwxact_id);
-	data_len = data_len + strlen(fdw_part->fdwxact_id) + 1;
-	data_len = MAXALIGN(data_len);
-	fdwxact_file_data = (FdwXactOnDiskData *) palloc0(data_len);
-	fdwxact_file_data->dbid = MyDatabaseId;
-	fdwxact_file_data->local_xid = xid;
-	fdwxact_file_data->serverid = fdw_part->server->serverid;
-	fdwxact_file_data->userid = fdw_part->usermapping->userid;
-	fdwxact_file_data->umid = fdw_part->usermapping->umid;
-	memcpy(fdwxact_file_data->fdwxact_id, fdw_part->fdwxact_id,
-		   strlen(fdw_part->fdwxact_id) + 1);
+	initStringInfo(&buf);
+	xlrec.nentries = list_length(new_parts);
+	appendBinaryStringInfo(&buf, (char *) &xlrec, sizeof(xl_fdwxact_insert));
+	appendStringInfoSpaces(&buf, SizeOfFdwXactInsert - sizeof(xl_fdwxact_insert));
+	foreach(lc, new_parts)
+	{
+		FdwXactParticipant *fdw_part = (FdwXactParticipant *) lfirst(lc);
+		FdwXactOnDiskData *fdwxact_file_data;
+		int			data_len;
+
+		data_len = FdwXactOnDiskDataSize(fdwxact_file_data);
+		fdwxact_file_data = (FdwXactOnDiskData *) palloc0(data_len);
+		fdwxact_file_data->dbid = MyDatabaseId;
+		fdwxact_file_data->local_xid = xid;
+		fdwxact_file_data->serverid = fdw_part->server->serverid;
+		fdwxact_file_data->userid = fdw_part->usermapping->userid;
+		fdwxact_file_data->umid = fdw_part->usermapping->umid;
+		fdwxact_file_data->fxid = fdw_part->fxid;
+
+		appendBinaryStringInfo(&buf, (char *) fdwxact_file_data, data_len);
+		pfree(fdwxact_file_data);
+	}
 
 	/* See note in RecordTransactionCommit */
 	MyProc->delayChkpt = true;
 
 	START_CRIT_SECTION();
 
-	/* Add the entry in the xlog and save LSN for checkpointer */
+	/* Add the entries in the xlog */
 	XLogBeginInsert();
-	XLogRegisterData((char *) fdwxact_file_data, data_len);
-	fdwxact->insert_end_lsn = XLogInsert(RM_FDWXACT_ID, XLOG_FDWXACT_INSERT);
-	XLogFlush(fdwxact->insert_end_lsn);
+	XLogRegisterData(buf.data, buf.len);
+	end_lsn = XLogInsert(RM_FDWXACT_ID, XLOG_FDWXACT_INSERT);
+	XLogFlush(end_lsn);
 
 	/* If we crash now, we have prepared: WAL replay will fix things */
 
-	/* Store record's start location to read that later on CheckPoint */
-	fdwxact->insert_start_lsn = ProcLastRecPtr;
+	foreach(lc, new_parts)
+	{
+		FdwXact		fdwxact = ((FdwXactParticipant *) lfirst(lc))->fdwxact;
+
+		/* Store record's end location to compare with checkpoint's redo */
+		fdwxact->insert_end_lsn = end_lsn;
 
-	/* File is written completely, checkpoint can proceed with syncing */
-	fdwxact->valid = true;
+		/* Entry is logged completely, checkpoint can include it */
+		fdwxact->valid = true;
+	}
 
 	/* Checkpoint can process now */
 	MyProc->delayChkpt = false;
 
 	END_CRIT_SECTION();
 
-	pfree(fdwxact_file_data);
-	return fdwxact;
+	pfree(buf.data);
+	list_free(new_parts);
 }
 
 /*
@@ -773,24 +1235,31 @@ FdwXactInsertFdwXactEntry(TransactionId xid, FdwXactParticipant *fdw_part)
  */
 static FdwXact
 insert_fdwxact(Oid dbid, TransactionId xid, Oid serverid, Oid userid,
-			   Oid umid, char *fdwxact_id)
+			   Oid umid, FdwXactId *fxid)
 {
 	FdwXact		fdwxact;
+	FdwXactXidEntry *xid_entry;
+	FdwXactServerEntry *server_entry;
+	FdwXactServerKey key;
+	bool		found;
 
 	Assert(LWLockHeldByMeInMode(FdwXactLock, LW_EXCLUSIVE));
 
 	/* Check for duplicated foreign transaction entry */
-	for (int i = 0; i < FdwXactCtl->num_fdwxacts; i++)
+	xid_entry = (FdwXactXidEntry *) hash_search(FdwXactXidHash, &xid,
+												HASH_FIND, NULL);
+	if (xid_entry)
 	{
-		fdwxact = FdwXactCtl->fdwxacts[i];
-		if (fdwxact->valid &&
-			fdwxact->dbid == dbid &&
-			fdwxact->local_xid == xid &&
-			fdwxact->serverid == serverid &&
-			fdwxact->userid == userid)
-			ereport(ERROR, (errmsg("could not insert a foreign transaction entry"),
-							errdetail("Duplicate entry with transaction id %u, serverid %u, userid %u exists.",
-									  xid, serverid, userid)));
+		for (fdwxact = xid_entry->fdwxacts; fdwxact; fdwxact = fdwxact->xid_next)
+		{
+			if (fdwxact->valid &&
+				fdwxact->dbid == dbid &&
+				fdwxact->serverid == serverid &&
+				fdwxact->userid == userid)
+				ereport(ERROR, (errmsg("could not insert a foreign transaction entry"),
+								errdetail("Duplicate entry with transaction id %u, serverid %u, userid %u exists.",
+										  xid, serverid, userid)));
+		}
 	}
 
 	/*
@@ -808,8 +1277,36 @@ insert_fdwxact(Oid dbid, TransactionId xid, Oid serverid, Oid userid,
 	fdwxact = FdwXactCtl->free_fdwxacts;
 	FdwXactCtl->free_fdwxacts = fdwxact->fdwxact_free_next;
 
+	/*
+	 * Index the entry by xid and by server.  There is always room in the hash
+	 * tables since they have as many entries as FdwXactData structs.
+	 */
+	if (!xid_entry)
+	{
+		xid_entry = (FdwXactXidEntry *) hash_search(FdwXactXidHash, &xid,
+													HASH_ENTER, &found);
+		Assert(!found);
+		xid_entry->fdwxacts = NULL;
+		xid_heap_add(xid_entry);
+	}
+	fdwxact->xid_next = xid_entry->fdwxacts;
+	xid_entry->fdwxacts = fdwxact;
+
+	key.dbid = dbid;
+	key.serverid = serverid;
+	server_entry = (FdwXactServerEntry *) hash_search(FdwXactServerHash, &key,
+													  HASH_ENTER, &found);
+	if (!found)
+	{
+		server_entry->count = 0;
+		dlist_init(&server_entry->fdwxacts);
+	}
+	dlist_push_tail(&server_entry->fdwxacts, &fdwxact->server_node);
+	server_entry->count++;
+
 	/* Insert the entry to shared memory array */
 	Assert(FdwXactCtl->num_fdwxacts < max_prepared_foreign_xacts);
+	fdwxact->ctl_idx = FdwXactCtl->num_fdwxacts;
 	FdwXactCtl->fdwxacts[FdwXactCtl->num_fdwxacts++] = fdwxact;
 
 	fdwxact->status = FDWXACT_STATUS_PREPARING;
@@ -818,13 +1315,12 @@ insert_fdwxact(Oid dbid, TransactionId xid, Oid serverid, Oid userid,
 	fdwxact->serverid = serverid;
 	fdwxact->userid = userid;
 	fdwxact->umid = umid;
-	fdwxact->insert_start_lsn = InvalidXLogRecPtr;
 	fdwxact->insert_end_lsn = InvalidXLogRecPtr;
 	fdwxact->locking_backend = InvalidBackendId;
 	fdwxact->valid = false;
-	fdwxact->ondisk = false;
 	fdwxact->inredo = false;
-	memcpy(fdwxact->fdwxact_id, fdwxact_id, strlen(fdwxact_id) + 1);
+	fdwxact->insert_time = GetCurrentTimestamp();
+	fdwxact->fxid = *fxid;
 
 	return fdwxact;
 }
@@ -832,36 +1328,68 @@ insert_fdwxact(Oid dbid, TransactionId xid, Oid serverid, Oid userid,
 /*
  * Remove the foreign prepared transaction entry from shared memory.
  * Caller must hold FdwXactLock in exclusive mode.
+ *
+ * The removal of a rolled back entry is not flushed to WAL.  If it's lost in
+ * a crash, the entry is recovered and its foreign transaction is rolled back
+ * again, which is harmless under presumed abort.
  */
 static void
 remove_fdwxact(FdwXact fdwxact)
 {
-	int			i;
+	int			i = fdwxact->ctl_idx;
+	bool		aborted = (fdwxact->status == FDWXACT_STATUS_ABORTING);
+	FdwXactXidEntry *xid_entry;
+	FdwXactServerEntry *server_entry;
+	FdwXactServerKey key;
+	FdwXact    *prev;
 
 	Assert(fdwxact != NULL);
 	Assert(LWLockHeldByMeInMode(FdwXactLock, LW_EXCLUSIVE));
 
-	/* Search the slot where this entry resided */
-	for (i = 0; i < FdwXactCtl->num_fdwxacts; i++)
-	{
-		if (FdwXactCtl->fdwxacts[i] == fdwxact)
-			break;
-	}
-
 	/* We did not find the given entry in the array */
-	if (i >= FdwXactCtl->num_fdwxacts)
+	if (i < 0 || i >= FdwXactCtl->num_fdwxacts ||
+		FdwXactCtl->fdwxacts[i] != fdwxact)
 		ereport(ERROR,
 				(errmsg("could not remove a foreign transaction entry"),
 				 errdetail("Failed to find entry for xid %u, foreign server %u, and user %u.",
 						   fdwxact->local_xid, fdwxact->serverid, fdwxact->userid)));
 
-	elog(DEBUG2, "remove fdwxact entry id %s, xid %u db %d user %d",
-		 fdwxact->fdwxact_id, fdwxact->local_xid, fdwxact->dbid,
+	elog(DEBUG2, "remove fdwxact entry xid %u db %u server %u user %u",
+		 fdwxact->local_xid, fdwxact->dbid, fdwxact->serverid,
 		 fdwxact->userid);
 
+	/* Unlink the entry from the xid index */
+	xid_entry = (FdwXactXidEntry *) hash_search(FdwXactXidHash,
+												&(fdwxact->local_xid),
+												HASH_FIND, NULL);
+	Assert(xid_entry);
+	for (prev = &(xid_entry->fdwxacts); *prev != fdwxact;
+		 prev = &((*prev)->xid_next))
+		Assert(*prev != NULL);
+	*prev = fdwxact->xid_next;
+	fdwxact->xid_next = NULL;
+
+	if (xid_entry->fdwxacts == NULL)
+	{
+		xid_heap_remove(xid_entry);
+		hash_search(FdwXactXidHash, &(fdwxact->local_xid), HASH_REMOVE, NULL);
+	}
+
+	/* Unlink the entry from the server index */
+	key.dbid = fdwxact->dbid;
+	key.serverid = fdwxact->serverid;
+	server_entry = (FdwXactServerEntry *) hash_search(FdwXactServerHash, &key,
+													  HASH_FIND, NULL);
+	Assert(server_entry);
+	dlist_delete(&fdwxact->server_node);
+	if (--server_entry->count == 0)
+		hash_search(FdwXactServerHash, &key, HASH_REMOVE, NULL);
+
 	/* Remove the entry from active array */
 	FdwXactCtl->num_fdwxacts--;
 	FdwXactCtl->fdwxacts[i] = FdwXactCtl->fdwxacts[FdwXactCtl->num_fdwxacts];
+	FdwXactCtl->fdwxacts[i]->ctl_idx = i;
+	fdwxact->ctl_idx = -1;
 
 	/* Put it back into free list */
 	fdwxact->fdwxact_free_next = FdwXactCtl->free_fdwxacts;
@@ -871,7 +1399,6 @@ remove_fdwxact(FdwXact fdwxact)
 	fdwxact->status = FDWXACT_STATUS_INVALID;
 	fdwxact->locking_backend = InvalidBackendId;
 	fdwxact->valid = false;
-	fdwxact->ondisk = false;
 	fdwxact->inredo = false;
 
 	if (!RecoveryInProgress())
@@ -885,10 +1412,22 @@ remove_fdwxact(FdwXact fdwxact)
 		record.xid = fdwxact->local_xid;
 		record.userid = fdwxact->userid;
 
+		if (aborted)
+		{
+			/*
+			 * A checkpoint may still write the entry to the snapshot, too.
+			 * That only makes the entry come back after a crash.
+			 */
+			XLogBeginInsert();
+			XLogRegisterData((char *) &record, sizeof(xl_fdwxact_remove));
+			(void) XLogInsert(RM_FDWXACT_ID, XLOG_FDWXACT_REMOVE);
+			return;
+		}
+
 		/*
 		 * Now writing FdwXact state data to WAL. We have to set delayChkpt
 		 * here, otherwise a checkpoint starting immediately after the WAL
-		 * record is inserted could complete without fsync'ing our state file.
+		 * record is inserted could complete with our entry in its snapshot.
 		 * (This is essentially the same kind of race condition as the
 		 * COMMIT-to-clog-write case that RecordTransactionCommit uses
 		 * delayChkpt for; see notes there.)
@@ -897,10 +1436,7 @@ remove_fdwxact(FdwXact fdwxact)
 
 		MyProc->delayChkpt = true;
 
-		/*
-		 * Log that we are removing the foreign transaction entry and remove
-		 * the file from the disk as well.
-		 */
+		/* Log that we are removing the foreign transaction entry */
 		XLogBeginInsert();
 		XLogRegisterData((char *) &record, sizeof(xl_fdwxact_remove));
 		recptr = XLogInsert(RM_FDWXACT_ID, XLOG_FDWXACT_REMOVE);
@@ -920,6 +1456,7 @@ static void
 AtProcExit_FdwXact(int code, Datum arg)
 {
 	ForgetAllFdwXactParticipants();
+	FdwXactReleasePendingCommits();
 }
 
 /*
@@ -934,8 +1471,9 @@ FdwXactParticipantEndTransaction(FdwXactParticipant *fdw_part, bool commit)
 
 	state.server = fdw_part->server;
 	state.usermapping = fdw_part->usermapping;
-	state.fdwxact_id = NULL;
+	state.fdwxact_id[0] = '\0';
 	state.flags = FDWXACT_FLAG_ONEPHASE;
+	state.csn = InvalidCSN;
 	if (commit)
 	{
 		fdw_part->commit_foreign_xact_fn(&state);
@@ -988,13 +1526,21 @@ ForgetAllFdwXactParticipants(void)
 
 	/*
 	 * If we leave any FdwXact entries, update the oldest local transaction of
-	 * unresolved distributed transaction and notify the launcher.
+	 * unresolved distributed transaction and notify the resolvers of the
+	 * servers, or the launcher to start them.
 	 */
 	if (nlefts > 0)
 	{
 		elog(DEBUG1, "left %u foreign transactions", nlefts);
 		FdwXactComputeRequiredXmin();
-		FdwXactLaunchOrWakeupResolver();
+
+		foreach(cell, FdwXactParticipants)
+		{
+			FdwXactParticipant *fdw_part = (FdwXactParticipant *) lfirst(cell);
+
+			if (fdw_part->fdwxact)
+				FdwXactLaunchOrWakeupResolver(fdw_part->server->serverid);
+		}
 	}
 
 	list_free_deep(FdwXactParticipants);
@@ -1003,13 +1549,16 @@ ForgetAllFdwXactParticipants(void)
 
 /*
  * Close in-progress involved foreign transactions.  We don't perform the second
- * phase of two-phase commit protocol here.  All prepared foreign transactions
- * enter in-doubt state and a resolver process will process them.
+ * phase of two-phase commit protocol here.  If foreign_xact_resolve_in_backend
+ * is set, the backend does it before reporting ready for query.  All other
+ * prepared foreign transactions left enter in-doubt state and a resolver
+ * process will process them.
  */
 void
 AtEOXact_FdwXact(bool is_commit)
 {
 	ListCell   *lc;
+	int			nforgotten = 0;
 
 	/* If there are no foreign servers involved, we have no business here */
 	if (FdwXactParticipants == NIL)
@@ -1054,13 +1603,282 @@ AtEOXact_FdwXact(bool is_commit)
 
 			if (status == FDWXACT_STATUS_PREPARING)
 				FdwXactParticipantEndTransaction(fdw_part, false);
+
+			/*
+			 * If we haven't even asked the server to prepare, there cannot
+			 * be a prepared transaction to roll back.  Forget the entry
+			 * rather than leaving it to the resolver.
+			 */
+			if (!fdw_part->prepare_sent)
+			{
+				LWLockAcquire(FdwXactLock, LW_EXCLUSIVE);
+				remove_fdwxact(fdwxact);
+				LWLockRelease(FdwXactLock);
+
+				fdw_part->fdwxact = NULL;
+				nforgotten++;
+			}
 		}
 	}
 
+	if (nforgotten > 0)
+		FdwXactComputeRequiredXmin();
+
+	if (is_commit && foreign_xact_resolve_in_backend &&
+		MyBackendType == B_BACKEND)
+		FdwXactDeferCommitPrepared();
+
 	ForgetAllFdwXactParticipants();
 	ForeignTwophaseCommitIsRequired = false;
 }
 
+/*
+ * Hand the foreign transactions prepared by the just committed local
+ * transaction over to FdwXactResolvePendingCommits(), instead of leaving
+ * them to the resolvers.  We are called from CommitTransaction(), with
+ * interrupts held and the local locks not released yet, so talking to the
+ * foreign servers has to wait until the backend has left the transaction
+ * block.  The entries stay locked by us until then, or until the next
+ * transaction starts, see AtStart_FdwXact().
+ */
+static void
+FdwXactDeferCommitPrepared(void)
+{
+	MemoryContext oldcontext;
+	ListCell   *lc;
+
+	oldcontext = MemoryContextSwitchTo(TopMemoryContext);
+
+	foreach(lc, FdwXactParticipants)
+	{
+		FdwXactParticipant *fdw_part = (FdwXactParticipant *) lfirst(lc);
+		FdwXact		fdwxact = fdw_part->fdwxact;
+		FdwXactStatus status;
+
+		if (!fdwxact)
+			continue;
+
+		/*
+		 * When preparing the local transaction, the foreign transactions are
+		 * resolved when it's committed or rolled back.
+		 */
+		if (!TransactionIdDidCommit(fdwxact->local_xid))
+			break;
+
+		SpinLockAcquire(&fdwxact->mutex);
+		status = fdwxact->status;
+		SpinLockRelease(&fdwxact->mutex);
+
+		if (status != FDWXACT_STATUS_PREPARED)
+			continue;
+
+		FdwXactPendingCommits = lappend(FdwXactPendingCommits, fdwxact);
+		fdw_part->fdwxact = NULL;
+	}
+
+	MemoryContextSwitchTo(oldcontext);
+}
+
+/*
+ * Commit the prepared foreign transactions handed over by
+ * FdwXactDeferCommitPrepared().  This is called once the backend has left
+ * the transaction block, by finish_xact_command() and before the backend
+ * reports ready for query.
+ *
+ * The commit requests are sent to all servers whose FDW supports it before
+ * waiting for any of them, so that they are committed concurrently.  Each
+ * wait is bounded by FDWXACT_BACKEND_COMMIT_TIMEOUT, and can be canceled.
+ * The local transaction is already committed, so if committing a foreign
+ * transaction fails, we report a warning and leave it, along with the ones
+ * not committed yet, to the resolvers.
+ */
+void
+FdwXactResolvePendingCommits(void)
+{
+	MemoryContext oldcontext;
+	FdwXact    *fdwxacts;
+	FdwRoutine **routines;
+	FdwXactRslvState *states;
+	instr_time *starts;
+	bool	   *sent;
+	int			nfdwxacts;
+	volatile int ncommitted = 0;
+	volatile int failed = -1;
+	ListCell   *lc;
+	int			i;
+
+	if (FdwXactPendingCommits == NIL)
+		return;
+
+	Assert(!IsTransactionOrTransactionBlock());
+
+	FdwXactResolvingPendingCommits = true;
+	StartTransactionCommand();
+	oldcontext = CurrentMemoryContext;
+
+	nfdwxacts = list_length(FdwXactPendingCommits);
+	fdwxacts = (FdwXact *) palloc(sizeof(FdwXact) * nfdwxacts);
+	routines = (FdwRoutine **) palloc(sizeof(FdwRoutine *) * nfdwxacts);
+	states = (FdwXactRslvState *) palloc(sizeof(FdwXactRslvState) * nfdwxacts);
+	starts = (instr_time *) palloc(sizeof(instr_time) * nfdwxacts);
+	sent = (bool *) palloc0(sizeof(bool) * nfdwxacts);
+
+	i = 0;
+	foreach(lc, FdwXactPendingCommits)
+		fdwxacts[i++] = (FdwXact) lfirst(lc);
+
+	PG_TRY();
+	{
+		for (i = 0; i < nfdwxacts; i++)
+		{
+			routines[i] = GetFdwRoutineByServerId(fdwxacts[i]->serverid);
+			FdwXactInitRslvState(fdwxacts[i], routines[i], &states[i]);
+			Assert(fdwxacts[i]->status == FDWXACT_STATUS_COMMITTING);
+		}
+
+		/* Send the commit requests to the servers supporting it */
+		for (i = 0; i < nfdwxacts; i++)
+		{
+			if (routines[i]->SendCommitForeignTransaction == NULL ||
+				routines[i]->WaitCommitForeignTransaction == NULL)
+				continue;
+
+			failed = i;
+			INSTR_TIME_SET_CURRENT(starts[i]);
+			routines[i]->SendCommitForeignTransaction(&states[i]);
+			sent[i] = true;
+		}
+
+		/* Collect their results, and commit the others one by one */
+		for (i = 0; i < nfdwxacts; i++)
+		{
+			failed = i;
+			if (!sent[i])
+				INSTR_TIME_SET_CURRENT(starts[i]);
+
+			enable_timeout_after(FDWXACT_COMMIT_TIMEOUT,
+								 FDWXACT_BACKEND_COMMIT_TIMEOUT);
+			if (sent[i])
+				routines[i]->WaitCommitForeignTransaction(&states[i]);
+			else
+				routines[i]->CommitForeignTransaction(&states[i]);
+			disable_timeout(FDWXACT_COMMIT_TIMEOUT, false);
+
+			pgstat_count_fdwxact(fdwxacts[i]->serverid, PGSTAT_FDWXACT_COMMIT,
+								 1, starts[i]);
+
+			LWLockAcquire(FdwXactLock, LW_EXCLUSIVE);
+			remove_fdwxact(fdwxacts[i]);
+			LWLockRelease(FdwXactLock);
+
+			FdwXactPendingCommits = list_delete_ptr(FdwXactPendingCommits,
+													fdwxacts[i]);
+			ncommitted++;
+		}
+	}
+	PG_CATCH();
+	{
+		ErrorData  *edata;
+		bool		timed_out;
+
+		HOLD_INTERRUPTS();
+
+		timed_out = get_timeout_indicator(FDWXACT_COMMIT_TIMEOUT, true);
+		disable_timeout(FDWXACT_COMMIT_TIMEOUT, false);
+
+		MemoryContextSwitchTo(oldcontext);
+		edata = CopyErrorData();
+		FlushErrorState();
+
+		if (failed >= 0)
+		{
+			pgstat_count_fdwxact_failure(fdwxacts[failed]->serverid, 1);
+
+			ereport(WARNING,
+					(errmsg("could not commit prepared foreign transaction on server \"%s\" with ID %s",
+							states[failed].server->servername,
+							states[failed].fdwxact_id),
+					 timed_out ?
+					 errdetail("Timed out waiting for the foreign server.") :
+					 errdetail_internal("%s", edata->message),
+					 errhint("The foreign transaction resolver will retry committing it.")));
+		}
+		else
+			ereport(WARNING,
+					(errmsg("could not commit prepared foreign transactions"),
+					 errdetail_internal("%s", edata->message),
+					 errhint("The foreign transaction resolver will retry committing them.")));
+		FreeErrorData(edata);
+
+		AbortCurrentTransaction();
+
+		RESUME_INTERRUPTS();
+	}
+	PG_END_TRY();
+
+	if (IsTransactionState())
+		CommitTransactionCommand();
+
+	if (ncommitted > 0)
+	{
+		elog(DEBUG1, "committed %d prepared foreign transactions", ncommitted);
+		FdwXactComputeRequiredXmin();
+	}
+
+	/* Leave whatever we didn't commit to the resolvers */
+	FdwXactReleasePendingCommits();
+}
+
+/*
+ * Called when a transaction starts.  If the foreign transactions prepared by
+ * the previous transaction are still waiting for FdwXactResolvePendingCommits(),
+ * the backend did not leave the transaction block in between, e.g. a procedure
+ * executed COMMIT.  Leave them to the resolvers rather than keeping them locked
+ * for an unbounded time.
+ */
+void
+AtStart_FdwXact(void)
+{
+	if (FdwXactResolvingPendingCommits)
+		FdwXactResolvingPendingCommits = false;
+	else
+		FdwXactReleasePendingCommits();
+}
+
+/*
+ * Unlock the foreign transactions left in FdwXactPendingCommits and wake up
+ * the resolvers of their servers.
+ */
+static void
+FdwXactReleasePendingCommits(void)
+{
+	ListCell   *lc;
+
+	if (FdwXactPendingCommits == NIL)
+		return;
+
+	foreach(lc, FdwXactPendingCommits)
+	{
+		FdwXact		fdwxact = (FdwXact) lfirst(lc);
+		Oid			serverid = fdwxact->serverid;
+
+		/* Once unlocked, a resolver may remove the entry at any time */
+		LWLockAcquire(FdwXactLock, LW_EXCLUSIVE);
+		fdwxact->locking_backend = InvalidBackendId;
+		LWLockRelease(FdwXactLock);
+
+		FdwXactLaunchOrWakeupResolver(serverid);
+	}
+
+	elog(DEBUG1, "left %d foreign transactions to the resolvers",
+		 list_length(FdwXactPendingCommits));
+
+	list_free(FdwXactPendingCommits);
+	FdwXactPendingCommits = NIL;
+
+	FdwXactComputeRequiredXmin();
+}
+
 /*
  * Prepare foreign transactions by PREPARE TRANSACTION command.
  *
@@ -1078,15 +1896,15 @@ PrePrepare_FdwXact(void)
 		return;
 
 	/*
-	 * Check if there is a server that doesn't support two-phase commit. All
-	 * involved servers need to support two-phase commit as we're going to
-	 *  prepare all of them.
+	 * Check if there is a modified server that doesn't support two-phase
+	 * commit.  All of them need to support two-phase commit as we're going
+	 * to prepare all of them.
 	 */
 	foreach(lc, FdwXactParticipants)
 	{
 		FdwXactParticipant *fdw_part = (FdwXactParticipant *) lfirst(lc);
 
-		if (!ServerSupportTwophaseCommit(fdw_part))
+		if (fdw_part->modified && !ServerSupportTwophaseCommit(fdw_part))
 			ereport(ERROR,
 					(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
 					 errmsg("cannot PREPARE a distributed transaction which has operated on a foreign server not supporting two-phase commit protocol")));
@@ -1095,10 +1913,10 @@ PrePrepare_FdwXact(void)
 	/*
 	 * Assign a transaction id if not yet because the local transaction id
 	 * is used to determine the result of the distributed transaction. And
-	 * prepare all foreign transactions.
+	 * prepare all modified foreign transactions.
 	 */
 	xid = GetTopTransactionId();
-	FdwXactPrepareForeignTransactions(xid, true);
+	FdwXactPrepareForeignTransactions(xid);
 
 	/*
 	 * We keep FdwXactParticipants until the transaction end so that we change
@@ -1107,29 +1925,188 @@ PrePrepare_FdwXact(void)
 }
 
 /*
- * Resolve foreign transactions at the give indexes.
+ * Resolve the given foreign transactions.
+ *
+ * The entries are sorted by server and user, and resolved in rounds that take
+ * the next entry of each server and user mapping, i.e. of each connection.
+ * The requests of a round are sent to all of its connections whose FDW
+ * supports it before waiting for any of the results, so that several servers
+ * resolve their transactions concurrently.  The others are resolved one by
+ * one.
  *
  * The caller must hold the given foreign transactions in advance to prevent
  * concurrent update.
  */
 void
-FdwXactResolveFdwXacts(int *fdwxact_idxs, int nfdwxacts)
+FdwXactResolveFdwXacts(FdwXact *fdwxacts, int nfdwxacts)
 {
+	FdwRoutine **routines;
+	FdwXactRslvState *states;
+	instr_time *starts;
+	bool	   *sent;
+	int		   *next;
+	int		   *end;
+	int		   *round;
+	int			ngroups = 0;
+	int			nresolved = 0;
+
+	if (nfdwxacts == 0)
+		return;
+
+	if (nfdwxacts > 1)
+		qsort(fdwxacts, nfdwxacts, sizeof(FdwXact), fdwxact_rslv_cmp);
+
+	routines = (FdwRoutine **) palloc(sizeof(FdwRoutine *) * nfdwxacts);
+	states = (FdwXactRslvState *) palloc(sizeof(FdwXactRslvState) * nfdwxacts);
+	starts = (instr_time *) palloc(sizeof(instr_time) * nfdwxacts);
+	sent = (bool *) palloc(sizeof(bool) * nfdwxacts);
+	next = (int *) palloc(sizeof(int) * nfdwxacts);
+	end = (int *) palloc(sizeof(int) * nfdwxacts);
+	round = (int *) palloc(sizeof(int) * nfdwxacts);
+
+	/* Find the range of entries of each server and user */
 	for (int i = 0; i < nfdwxacts; i++)
 	{
-		FdwXact		fdwxact = FdwXactCtl->fdwxacts[fdwxact_idxs[i]];
+		if (i == 0 || fdwxact_rslv_cmp(&fdwxacts[i - 1], &fdwxacts[i]) != 0)
+		{
+			routines[i] = GetFdwRoutineByServerId(fdwxacts[i]->serverid);
+			next[ngroups++] = i;
+		}
+		else
+			routines[i] = routines[i - 1];
+		end[ngroups - 1] = i + 1;
+
+		FdwXactInitRslvState(fdwxacts[i], routines[i], &states[i]);
+	}
+
+	while (nresolved < nfdwxacts)
+	{
+		int			nround = 0;
 
 		CHECK_FOR_INTERRUPTS();
 
-		FdwXactResolveOneFdwXact(fdwxact);
+		for (int g = 0; g < ngroups; g++)
+		{
+			if (next[g] < end[g])
+				round[nround++] = next[g]++;
+		}
 
-		LWLockAcquire(FdwXactLock, LW_EXCLUSIVE);
-		if (fdwxact->ondisk)
-			RemoveFdwXactFile(fdwxact->dbid, fdwxact->local_xid, fdwxact->serverid,
-							  fdwxact->userid, true);
-		remove_fdwxact(fdwxact);
-		LWLockRelease(FdwXactLock);
+		/* Send the requests to the servers supporting it */
+		for (int j = 0; j < nround; j++)
+		{
+			int			i = round[j];
+			FdwRoutine *routine = routines[i];
+			bool		commit = (fdwxacts[i]->status == FDWXACT_STATUS_COMMITTING);
+
+			sent[i] = commit ?
+				(routine->SendCommitForeignTransaction != NULL &&
+				 routine->WaitCommitForeignTransaction != NULL) :
+				(routine->SendRollbackForeignTransaction != NULL &&
+				 routine->WaitRollbackForeignTransaction != NULL);
+			if (!sent[i])
+				continue;
+
+			INSTR_TIME_SET_CURRENT(starts[i]);
+			PG_TRY();
+			{
+				if (commit)
+					routine->SendCommitForeignTransaction(&states[i]);
+				else
+					routine->SendRollbackForeignTransaction(&states[i]);
+			}
+			PG_CATCH();
+			{
+				pgstat_count_fdwxact_failure(fdwxacts[i]->serverid, 1);
+				PG_RE_THROW();
+			}
+			PG_END_TRY();
+		}
+
+		/* Collect their results, and resolve the others one by one */
+		for (int j = 0; j < nround; j++)
+		{
+			int			i = round[j];
+			FdwRoutine *routine = routines[i];
+			bool		commit = (fdwxacts[i]->status == FDWXACT_STATUS_COMMITTING);
+
+			if (!sent[i])
+				INSTR_TIME_SET_CURRENT(starts[i]);
+
+			PG_TRY();
+			{
+				if (commit && sent[i])
+					routine->WaitCommitForeignTransaction(&states[i]);
+				else if (commit)
+					routine->CommitForeignTransaction(&states[i]);
+				else if (sent[i])
+					routine->WaitRollbackForeignTransaction(&states[i]);
+				else
+					routine->RollbackForeignTransaction(&states[i]);
+			}
+			PG_CATCH();
+			{
+				/* Sent with the next report, or at exit if the error ends us */
+				pgstat_count_fdwxact_failure(fdwxacts[i]->serverid, 1);
+				PG_RE_THROW();
+			}
+			PG_END_TRY();
+			pgstat_count_fdwxact(fdwxacts[i]->serverid,
+								 commit ? PGSTAT_FDWXACT_COMMIT : PGSTAT_FDWXACT_ROLLBACK,
+								 1, starts[i]);
+
+			elog(DEBUG1, "successfully %s prepared foreign transaction %s for server %u user %u",
+				 commit ? "committed" : "rolled back", states[i].fdwxact_id,
+				 fdwxacts[i]->serverid, fdwxacts[i]->userid);
+
+			LWLockAcquire(FdwXactLock, LW_EXCLUSIVE);
+			remove_fdwxact(fdwxacts[i]);
+			LWLockRelease(FdwXactLock);
+			nresolved++;
+		}
 	}
+
+	pfree(routines);
+	pfree(states);
+	pfree(starts);
+	pfree(sent);
+	pfree(next);
+	pfree(end);
+	pfree(round);
+
+	/* The resolved transactions no longer hold back xmin */
+	FdwXactComputeRequiredXmin();
+}
+
+/*
+ * Return the number of foreign transactions of the given database and server
+ * that are being prepared or waiting for resolution.  *oldest is set to the
+ * time the oldest of them was added, or 0 if there are none.
+ */
+int
+FdwXactCountServerEntries(Oid dbid, Oid serverid, TimestampTz *oldest)
+{
+	FdwXactServerEntry *server_entry;
+	FdwXactServerKey key;
+	int			count = 0;
+
+	*oldest = 0;
+	key.dbid = dbid;
+	key.serverid = serverid;
+
+	LWLockAcquire(FdwXactLock, LW_SHARED);
+	server_entry = (FdwXactServerEntry *) hash_search(FdwXactServerHash, &key,
+													  HASH_FIND, NULL);
+	if (server_entry)
+	{
+		FdwXact		fdwxact = dlist_head_element(FdwXactData, server_node,
+												 &server_entry->fdwxacts);
+
+		count = server_entry->count;
+		*oldest = fdwxact->insert_time;
+	}
+	LWLockRelease(FdwXactLock);
+
+	return count;
 }
 
 /*
@@ -1139,105 +2116,201 @@ FdwXactResolveFdwXacts(int *fdwxact_idxs, int nfdwxacts)
 bool
 FdwXactExists(Oid dbid, Oid serverid, Oid userid)
 {
-	int			idx;
+	FdwXact		fdwxact;
 
 	LWLockAcquire(FdwXactLock, LW_SHARED);
-	idx = get_fdwxact(dbid, InvalidTransactionId, serverid, userid);
+	fdwxact = get_fdwxact(dbid, InvalidTransactionId, serverid, userid);
 	LWLockRelease(FdwXactLock);
 
-	return (idx >= 0);
+	return (fdwxact != NULL);
 }
 bool
 FdwXactExistsXid(TransactionId xid)
 {
-	int			idx;
+	FdwXact		fdwxact;
 
 	LWLockAcquire(FdwXactLock, LW_SHARED);
-	idx = get_fdwxact(InvalidOid, xid, InvalidOid, InvalidOid);
+	fdwxact = get_fdwxact(InvalidOid, xid, InvalidOid, InvalidOid);
 	LWLockRelease(FdwXactLock);
 
-	return (idx >= 0);
+	return (fdwxact != NULL);
 }
 
 /*
- * Return the index of first found FdwXact entry that matched to given arguments.
- * Otherwise return -1.	 The search condition is defined by arguments with valid
- * values for respective datatypes.
+ * Return the first found FdwXact entry that matched to given arguments.
+ * Otherwise return NULL.  The search condition is defined by arguments with
+ * valid values for respective datatypes.  Either xid, or both dbid and
+ * serverid must be given, so that only the entries of that transaction or
+ * that server are looked at through FdwXactXidHash or FdwXactServerHash.
  */
-static int
+static FdwXact
 get_fdwxact(Oid dbid, TransactionId xid, Oid serverid, Oid userid)
 {
-	bool		found = false;
-	int			i;
+	FdwXact		fdwxact;
 
 	Assert(LWLockHeldByMe(FdwXactLock));
 
-	for (i = 0; i < FdwXactCtl->num_fdwxacts; i++)
+	if (TransactionIdIsValid(xid))
 	{
-		FdwXact		fdwxact = FdwXactCtl->fdwxacts[i];
-
-		if (!fdwxact->valid)
-			continue;
+		FdwXactXidEntry *xid_entry;
 
-		/* dbid */
-		if (OidIsValid(dbid) && fdwxact->dbid != dbid)
-			continue;
+		xid_entry = (FdwXactXidEntry *) hash_search(FdwXactXidHash, &xid,
+													HASH_FIND, NULL);
+		for (fdwxact = xid_entry ? xid_entry->fdwxacts : NULL; fdwxact;
+			 fdwxact = fdwxact->xid_next)
+		{
+			if (fdwxact->valid &&
+				(!OidIsValid(dbid) || fdwxact->dbid == dbid) &&
+				(!OidIsValid(serverid) || fdwxact->serverid == serverid) &&
+				(!OidIsValid(userid) || fdwxact->userid == userid))
+				return fdwxact;
+		}
+	}
+	else
+	{
+		FdwXactServerEntry *server_entry;
+		FdwXactServerKey key;
+		dlist_iter	iter;
 
-		/* xid */
-		if (TransactionIdIsValid(xid) && xid != fdwxact->local_xid)
-			continue;
+		Assert(OidIsValid(dbid) && OidIsValid(serverid));
 
-		/* serverid */
-		if (OidIsValid(serverid) && serverid != fdwxact->serverid)
-			continue;
+		key.dbid = dbid;
+		key.serverid = serverid;
+		server_entry = (FdwXactServerEntry *) hash_search(FdwXactServerHash,
+														  &key, HASH_FIND,
+														  NULL);
+		if (server_entry == NULL)
+			return NULL;
 
-		/* userid */
-		if (OidIsValid(userid) && fdwxact->userid != userid)
-			continue;
+		dlist_foreach(iter, &server_entry->fdwxacts)
+		{
+			fdwxact = dlist_container(FdwXactData, server_node, iter.cur);
 
-		/* This entry matches the condition */
-		found = true;
-		break;
+			if (fdwxact->valid &&
+				(!OidIsValid(userid) || fdwxact->userid == userid))
+				return fdwxact;
+		}
 	}
 
-	return found ? i : -1;
+	return NULL;
 }
 
 /*
  * Compute the oldest xmin across all unresolved foreign transactions
  * and store it in the ProcArray.
  *
+ * The oldest xid is the top of FdwXactXidHeap, maintained by
+ * insert_fdwxact() and remove_fdwxact().
+ *
  * XXX: we can exclude FdwXact entries whose status is already committing
  * or aborting.
  */
 static void
 FdwXactComputeRequiredXmin(void)
 {
-	TransactionId agg_xmin = InvalidTransactionId;
+	TransactionId agg_xmin;
 
 	Assert(FdwXactCtl != NULL);
 
 	LWLockAcquire(FdwXactLock, LW_SHARED);
+	if (FdwXactCtl->num_xids > 0)
+		agg_xmin = FdwXactXidHeap[0]->xid;
+	else
+		agg_xmin = InvalidTransactionId;
+	LWLockRelease(FdwXactLock);
 
-	for (int i = 0; i < FdwXactCtl->num_fdwxacts; i++)
-	{
-		FdwXact		fdwxact = FdwXactCtl->fdwxacts[i];
+	ProcArraySetFdwXactUnresolvedXmin(agg_xmin);
+}
 
-		if (!fdwxact->valid)
-			continue;
 
-		Assert(TransactionIdIsValid(fdwxact->local_xid));
+/*
+ * Add the xid entry to FdwXactXidHeap.  Caller must hold FdwXactLock in
+ * exclusive mode.
+ */
+static void
+xid_heap_add(FdwXactXidEntry *xid_entry)
+{
+	int			idx = FdwXactCtl->num_xids++;
 
-		if (!TransactionIdIsValid(agg_xmin) ||
-			TransactionIdPrecedes(fdwxact->local_xid, agg_xmin))
-			agg_xmin = fdwxact->local_xid;
-	}
+	Assert(idx < Max(max_prepared_foreign_xacts, 1));
+	FdwXactXidHeap[idx] = xid_entry;
+	xid_entry->heap_idx = idx;
+	xid_heap_sift_up(idx);
+}
 
-	LWLockRelease(FdwXactLock);
+/*
+ * Remove the xid entry from FdwXactXidHeap, by moving the last heap entry to
+ * its place.  Caller must hold FdwXactLock in exclusive mode.
+ */
+static void
+xid_heap_remove(FdwXactXidEntry *xid_entry)
+{
+	int			idx = xid_entry->heap_idx;
+	FdwXactXidEntry *last;
 
-	ProcArraySetFdwXactUnresolvedXmin(agg_xmin);
+	Assert(FdwXactXidHeap[idx] == xid_entry);
+
+	last = FdwXactXidHeap[--FdwXactCtl->num_xids];
+	xid_entry->heap_idx = -1;
+	if (last == xid_entry)
+		return;
+
+	FdwXactXidHeap[idx] = last;
+	last->heap_idx = idx;
+	xid_heap_sift_down(idx);
+	xid_heap_sift_up(last->heap_idx);
+}
+
+/* Move the heap entry at idx up until its parent is older */
+static void
+xid_heap_sift_up(int idx)
+{
+	FdwXactXidEntry *xid_entry = FdwXactXidHeap[idx];
+
+	while (idx > 0)
+	{
+		int			parent = (idx - 1) / 2;
+
+		if (!TransactionIdPrecedes(xid_entry->xid,
+								   FdwXactXidHeap[parent]->xid))
+			break;
+
+		FdwXactXidHeap[idx] = FdwXactXidHeap[parent];
+		FdwXactXidHeap[idx]->heap_idx = idx;
+		idx = parent;
+	}
+
+	FdwXactXidHeap[idx] = xid_entry;
+	xid_entry->heap_idx = idx;
 }
 
+/* Move the heap entry at idx down until its children are newer */
+static void
+xid_heap_sift_down(int idx)
+{
+	FdwXactXidEntry *xid_entry = FdwXactXidHeap[idx];
+
+	for (;;)
+	{
+		int			child = 2 * idx + 1;
+
+		if (child >= FdwXactCtl->num_xids)
+			break;
+		if (child + 1 < FdwXactCtl->num_xids &&
+			TransactionIdPrecedes(FdwXactXidHeap[child + 1]->xid,
+								  FdwXactXidHeap[child]->xid))
+			child++;
+		if (!TransactionIdPrecedes(FdwXactXidHeap[child]->xid, xid_entry->xid))
+			break;
+
+		FdwXactXidHeap[idx] = FdwXactXidHeap[child];
+		FdwXactXidHeap[idx]->heap_idx = idx;
+		idx = child;
+	}
+
+	FdwXactXidHeap[idx] = xid_entry;
+	xid_entry->heap_idx = idx;
+}
 
 /*
  * Return whether the foreign transaction associated with the given transaction
@@ -1283,14 +2356,16 @@ FdwXactGetTransactionFate(TransactionId xid)
 	pg_unreachable();
 }
 
-/* Commit or rollback one prepared foreign transaction */
+/*
+ * Determine whether the given foreign transaction is to be committed or
+ * rolled back, and set up the state to pass to the FDW to do that.  routine
+ * is the FdwRoutine of the server of the foreign transaction.
+ */
 static void
-FdwXactResolveOneFdwXact(FdwXact fdwxact)
+FdwXactInitRslvState(FdwXact fdwxact, FdwRoutine *routine,
+					 FdwXactRslvState *state)
 {
-	FdwXactRslvState state;
 	ForeignServer *server;
-	ForeignDataWrapper *fdw;
-	FdwRoutine *routine;
 
 	/* The FdwXact entry must be held by me */
 	Assert(fdwxact != NULL);
@@ -1312,28 +2387,51 @@ FdwXactResolveOneFdwXact(FdwXact fdwxact)
 	}
 
 	server = GetForeignServer(fdwxact->serverid);
-	fdw = GetForeignDataWrapper(server->fdwid);
-	routine = GetFdwRoutine(fdw->fdwhandler);
 
 	/* Prepare the resolution state to pass to API */
-	state.server = server;
-	state.usermapping = GetUserMapping(fdwxact->userid, fdwxact->serverid);
-	state.fdwxact_id = fdwxact->fdwxact_id;
-	state.flags = 0;
+	state->server = server;
+	state->usermapping = GetUserMapping(fdwxact->userid, fdwxact->serverid);
+	render_fdwxact_id(&fdwxact->fxid, fdwxact->serverid, fdwxact->userid,
+					  routine->GetPrepareId, state->fdwxact_id);
+	state->flags = 0;
+	state->csn = InvalidCSN;
 	if (fdwxact->status == FDWXACT_STATUS_COMMITTING)
 	{
-		routine->CommitForeignTransaction(&state);
-		elog(DEBUG1, "successfully committed the prepared foreign transaction for server %u user %u",
-			 fdwxact->serverid, fdwxact->userid);
-	}
-	else
-	{
-		routine->RollbackForeignTransaction(&state);
-		elog(DEBUG1, "successfully rolled back the prepared foreign transaction for server %u user %u",
-			 fdwxact->serverid, fdwxact->userid);
+		/*
+		 * If the FDW doesn't assign the global CSN before the local commit,
+		 * the prepared transaction must be committed with it.  The global CSN
+		 * has been assigned to the local transaction as well, so we can get
+		 * it from the CSN log even after a restart.
+		 */
+		if (is_global_snapshot_enabled() &&
+			routine->PrepareForeignCSNSnapshot != NULL &&
+			routine->AssignGlobalCSN == NULL)
+		{
+			CSN			csn = CSNLogGetCSNByXid(fdwxact->local_xid);
+
+			if (CSNIsNormal(csn))
+			{
+				state->flags |= FDWXACT_FLAG_USE_GLOBAL_CSN;
+				state->csn = csn;
+			}
+		}
 	}
 }
 
+/* qsort comparator to group foreign transactions by server and user */
+static int
+fdwxact_rslv_cmp(const void *a, const void *b)
+{
+	FdwXact		fa = *(const FdwXact *) a;
+	FdwXact		fb = *(const FdwXact *) b;
+
+	if (fa->serverid != fb->serverid)
+		return (fa->serverid < fb->serverid) ? -1 : 1;
+	if (fa->userid != fb->userid)
+		return (fa->userid < fb->userid) ? -1 : 1;
+	return 0;
+}
+
 /* Apply the redo log for a foreign transaction */
 void
 fdwxact_redo(XLogReaderState *record)
@@ -1343,24 +2441,29 @@ fdwxact_redo(XLogReaderState *record)
 
 	if (info == XLOG_FDWXACT_INSERT)
 	{
+		xl_fdwxact_insert *xlrec = (xl_fdwxact_insert *) rec;
+		char	   *ptr = rec + SizeOfFdwXactInsert;
+
 		/*
-		 * Add fdwxact entry and set start/end lsn of the WAL record in
-		 * FdwXact entry.
+		 * Add fdwxact entries of all participants and set start/end lsn of
+		 * the WAL record in each FdwXact entry.
 		 */
 		LWLockAcquire(FdwXactLock, LW_EXCLUSIVE);
-		FdwXactRedoAdd(XLogRecGetData(record),
-					   record->ReadRecPtr,
-					   record->EndRecPtr);
+		for (int i = 0; i < xlrec->nentries; i++)
+		{
+			FdwXactRedoAdd(ptr, record->EndRecPtr);
+			ptr += FdwXactOnDiskDataSize((FdwXactOnDiskData *) ptr);
+		}
 		LWLockRelease(FdwXactLock);
 	}
 	else if (info == XLOG_FDWXACT_REMOVE)
 	{
 		xl_fdwxact_remove *record = (xl_fdwxact_remove *) rec;
 
-		/* Delete FdwXact entry and file if exists */
+		/* Delete FdwXact entry if exists */
 		LWLockAcquire(FdwXactLock, LW_EXCLUSIVE);
 		FdwXactRedoRemove(record->dbid, record->xid, record->serverid,
-						  record->userid, false);
+						  record->userid);
 		LWLockRelease(FdwXactLock);
 	}
 	else
@@ -1371,18 +2474,44 @@ fdwxact_redo(XLogReaderState *record)
 
 
 /*
- * Store pointer to the start/end of the WAL record along with the xid in
- * a fdwxact entry in shared memory FdwXactData structure.
+ * Add a foreign transaction entry into FdwXactCtl from its logged data.
+ * end_lsn is the end of the WAL record that logged the entry, or invalid if
+ * the entry comes from the snapshot file.
  */
 static void
-FdwXactRedoAdd(char *buf, XLogRecPtr start_lsn, XLogRecPtr end_lsn)
+FdwXactRedoAdd(char *buf, XLogRecPtr end_lsn)
 {
 	FdwXactOnDiskData *fdwxact_data = (FdwXactOnDiskData *) buf;
+	FdwXactXidEntry *xid_entry;
 	FdwXact		fdwxact;
 
 	Assert(LWLockHeldByMeInMode(FdwXactLock, LW_EXCLUSIVE));
 	Assert(RecoveryInProgress());
 
+	/*
+	 * The snapshot file can already have the entry if it was written by a
+	 * checkpoint that didn't complete.  It holds the same data as the WAL
+	 * record, so just keep it.
+	 */
+	xid_entry = (FdwXactXidEntry *) hash_search(FdwXactXidHash,
+												&(fdwxact_data->local_xid),
+												HASH_FIND, NULL);
+	if (xid_entry)
+	{
+		for (fdwxact = xid_entry->fdwxacts; fdwxact; fdwxact = fdwxact->xid_next)
+		{
+			if (fdwxact->dbid == fdwxact_data->dbid &&
+				fdwxact->serverid == fdwxact_data->serverid &&
+				fdwxact->userid == fdwxact_data->userid)
+			{
+				elog(DEBUG2, "fdwxact entry for foreign transaction, db %u xid %u server %u user %u, is already restored",
+					 fdwxact_data->dbid, fdwxact_data->local_xid,
+					 fdwxact_data->serverid, fdwxact_data->userid);
+				return;
+			}
+		}
+	}
+
 	/*
 	 * Add this entry into the table of foreign transactions. The status of
 	 * the transaction is set as preparing, since we do not know the exact
@@ -1391,12 +2520,11 @@ FdwXactRedoAdd(char *buf, XLogRecPtr start_lsn, XLogRecPtr end_lsn)
 	 */
 	fdwxact = insert_fdwxact(fdwxact_data->dbid, fdwxact_data->local_xid,
 							 fdwxact_data->serverid, fdwxact_data->userid,
-							 fdwxact_data->umid, fdwxact_data->fdwxact_id);
+							 fdwxact_data->umid, &fdwxact_data->fxid);
 
-	elog(DEBUG2, "added fdwxact entry in shared memory for foreign transaction, db %u xid %u server %u user %u id %s",
+	elog(DEBUG2, "added fdwxact entry in shared memory for foreign transaction, db %u xid %u server %u user %u",
 		 fdwxact_data->dbid, fdwxact_data->local_xid,
-		 fdwxact_data->serverid, fdwxact_data->userid,
-		 fdwxact_data->fdwxact_id);
+		 fdwxact_data->serverid, fdwxact_data->userid);
 
 	/*
 	 * Set status as PREPARED, since we do not know the xact status right now.
@@ -1404,374 +2532,294 @@ FdwXactRedoAdd(char *buf, XLogRecPtr start_lsn, XLogRecPtr end_lsn)
 	 * prepared this fdwxact entry.
 	 */
 	fdwxact->status = FDWXACT_STATUS_PREPARED;
-	fdwxact->insert_start_lsn = start_lsn;
 	fdwxact->insert_end_lsn = end_lsn;
 	fdwxact->inredo = true;		/* added in redo */
 	fdwxact->valid = false;
-	fdwxact->ondisk = XLogRecPtrIsInvalid(start_lsn);
 }
 
 /*
- * Remove the corresponding fdwxact entry from FdwXactCtl. Also remove
- * FdwXact file if a foreign transaction was saved via an earlier checkpoint.
- * We could not found the FdwXact entry in the case where a crash recovery
- * starts from the point where is after added but before removed the entry.
+ * Remove the corresponding fdwxact entry from FdwXactCtl.  We could not found
+ * the FdwXact entry in the case where a crash recovery starts from the point
+ * where is after added but before removed the entry.
  */
 static void
-FdwXactRedoRemove(Oid dbid, TransactionId xid, Oid serverid,
-				  Oid userid, bool givewarning)
+FdwXactRedoRemove(Oid dbid, TransactionId xid, Oid serverid, Oid userid)
 {
-	FdwXact		fdwxact;
-	int			i;
+	FdwXactXidEntry *xid_entry;
+	FdwXact		fdwxact = NULL;
 
 	Assert(LWLockHeldByMeInMode(FdwXactLock, LW_EXCLUSIVE));
 	Assert(RecoveryInProgress());
 
-	for (i = 0; i < FdwXactCtl->num_fdwxacts; i++)
+	/* Entries added by redo are not valid yet, so don't use get_fdwxact */
+	xid_entry = (FdwXactXidEntry *) hash_search(FdwXactXidHash, &xid,
+												HASH_FIND, NULL);
+	if (xid_entry)
 	{
-		fdwxact = FdwXactCtl->fdwxacts[i];
-
-		if (fdwxact->dbid == dbid && fdwxact->local_xid == xid &&
-			fdwxact->serverid == serverid && fdwxact->userid == userid)
-			break;
+		for (fdwxact = xid_entry->fdwxacts; fdwxact; fdwxact = fdwxact->xid_next)
+		{
+			if (fdwxact->dbid == dbid && fdwxact->serverid == serverid &&
+				fdwxact->userid == userid)
+				break;
+		}
 	}
 
-	if (i >= FdwXactCtl->num_fdwxacts)
+	if (fdwxact == NULL)
 		return;
 
-	/* Clean up entry and any files we may have left */
-	if (fdwxact->ondisk)
-		RemoveFdwXactFile(fdwxact->dbid, fdwxact->local_xid,
-						  fdwxact->serverid, fdwxact->userid,
-						  givewarning);
 	remove_fdwxact(fdwxact);
 
-	elog(DEBUG2, "removed fdwxact entry from shared memory for foreign transaction, db %u xid %u server %u user %u id %s",
-		 fdwxact->dbid, fdwxact->local_xid, fdwxact->serverid,
-		 fdwxact->userid, fdwxact->fdwxact_id);
+	elog(DEBUG2, "removed fdwxact entry from shared memory for foreign transaction, db %u xid %u server %u user %u",
+		 dbid, xid, serverid, userid);
 }
 
 /*
- * We must fsync the foreign transaction state file that is valid or generated
- * during redo and has a inserted LSN <= the checkpoint's redo horizon.
- * The foreign transaction entries and hence the corresponding files are expected
- * to be very short-lived. By executing this function at the end, we might have
- * lesser files to fsync, thus reducing some I/O. This is similar to
- * CheckPointTwoPhase().
+ * Write the foreign transaction entries that are valid or generated during
+ * redo and have an inserted LSN <= the checkpoint's redo horizon to the
+ * snapshot file.  Recovery starting from this checkpoint reads them back
+ * from the snapshot and replays the rest from WAL.
+ *
+ * The snapshot replaces the previous one as a whole, so entries resolved
+ * since the last checkpoint simply disappear.  The foreign transaction
+ * entries are expected to be very short-lived, so there is usually nothing
+ * to write, in which case the snapshot file is removed.
  *
  * This is deliberately run as late as possible in the checkpoint sequence,
  * because FdwXacts ordinarily have short lifespans, and so it is quite
  * possible that FdwXacts that were valid at checkpoint start will no longer
- * exist if we wait a little bit. With typical checkpoint settings this
- * will be about 3 minutes for an online checkpoint, so as a result we
- * expect that there will be no FdwXacts that need to be copied to disk.
- *
- * If a FdwXact remains valid across multiple checkpoints, it will already
- * be on disk so we don't bother to repeat that write.
+ * exist if we wait a little bit.
  */
 void
 CheckPointFdwXacts(XLogRecPtr redo_horizon)
 {
-	int			cnt;
-	int			serialized_fdwxacts = 0;
+	FdwXactSnapshotHeader *hdr;
+	FdwXactOnDiskData *entries = NULL;
+	char	   *buf = NULL;
+	Size		len;
+	pg_crc32c	crc;
+	int			nentries = 0;
+	int			fd;
 
 	if (max_prepared_foreign_xacts <= 0)
 		return;					/* nothing to do */
 
 	/*
-	 * We are expecting there to be zero FdwXact that need to be copied to
-	 * disk, so we perform all I/O while holding FdwXactLock for simplicity.
-	 * This presents any new foreign xacts from preparing while this occurs,
-	 * which shouldn't be a problem since the presence of long-lived prepared
-	 * foreign xacts indicated the transaction manager isn't active.
-	 *
-	 * It's also possible to move I/O out of the lock, but on every error we
-	 * should check whether somebody committed our transaction in different
-	 * backend. Let's leave this optimisation for future, if somebody will
-	 * spot that this place cause bottleneck.
+	 * Copy the entries while holding FdwXactLock and write them out after
+	 * releasing it, so that preparing foreign transactions doesn't wait for
+	 * the I/O.  The buffer is sized for the entries that exist now, which is
+	 * usually none at all.
 	 *
 	 * Note that it isn't possible for there to be a FdwXact with a
 	 * insert_end_lsn set prior to the last checkpoint yet is marked invalid,
 	 * because of the efforts with delayChkpt.
 	 */
 	LWLockAcquire(FdwXactLock, LW_SHARED);
-	for (cnt = 0; cnt < FdwXactCtl->num_fdwxacts; cnt++)
+	if (FdwXactCtl->num_fdwxacts > 0)
 	{
-		FdwXact		fdwxact = FdwXactCtl->fdwxacts[cnt];
-
-		if ((fdwxact->valid || fdwxact->inredo) &&
-			!fdwxact->ondisk &&
-			fdwxact->insert_end_lsn <= redo_horizon)
-		{
-			char	   *buf;
-			int			len;
-
-			XlogReadFdwXactData(fdwxact->insert_start_lsn, &buf, &len);
-			RecreateFdwXactFile(fdwxact->dbid, fdwxact->local_xid,
-								fdwxact->serverid, fdwxact->userid,
-								buf, len);
-			fdwxact->ondisk = true;
-			fdwxact->insert_start_lsn = InvalidXLogRecPtr;
-			fdwxact->insert_end_lsn = InvalidXLogRecPtr;
-			pfree(buf);
-			serialized_fdwxacts++;
-		}
+		buf = palloc0(SizeOfFdwXactSnapshotHeader +
+					  sizeof(FdwXactOnDiskData) * FdwXactCtl->num_fdwxacts +
+					  sizeof(pg_crc32c));
+		entries = (FdwXactOnDiskData *) (buf + SizeOfFdwXactSnapshotHeader);
 	}
+	for (int i = 0; i < FdwXactCtl->num_fdwxacts; i++)
+	{
+		FdwXact		fdwxact = FdwXactCtl->fdwxacts[i];
+		FdwXactOnDiskData *data;
 
-	LWLockRelease(FdwXactLock);
-
-	/*
-	 * Flush unconditionally the parent directory to make any information
-	 * durable on disk.	 FdwXact files could have been removed and those
-	 * removals need to be made persistent as well as any files newly created.
-	 */
-	fsync_fname(FDWXACTS_DIR, true);
-
-	if (log_checkpoints && serialized_fdwxacts > 0)
-		ereport(LOG,
-				(errmsg_plural("%u foreign transaction state file was written "
-							   "for long-running prepared transactions",
-							   "%u foreign transaction state files were written "
-							   "for long-running prepared transactions",
-							   serialized_fdwxacts,
-							   serialized_fdwxacts)));
-}
-
-/*
- * Reads foreign transaction data from xlog. During checkpoint this data will
- * be moved to fdwxact files and ReadFdwXactFile should be used instead.
- *
- * Note clearly that this function accesses WAL during normal operation, similarly
- * to the way WALSender or Logical Decoding would do. It does not run during
- * crash recovery or standby processing.
- */
-static void
-XlogReadFdwXactData(XLogRecPtr lsn, char **buf, int *len)
-{
-	XLogRecord *record;
-	XLogReaderState *xlogreader;
-	char	   *errormsg;
-
-	xlogreader = XLogReaderAllocate(wal_segment_size, NULL,
-									XL_ROUTINE(.page_read = &read_local_xlog_page,
-											   .segment_open = &wal_segment_open,
-											   .segment_close = &wal_segment_close),
-									NULL);
-	if (!xlogreader)
-		ereport(ERROR,
-				(errcode(ERRCODE_OUT_OF_MEMORY),
-				 errmsg("out of memory"),
-				 errdetail("Failed while allocating an XLog reading processor.")));
-
-	XLogBeginRead(xlogreader, lsn);
-	record = XLogReadRecord(xlogreader, &errormsg);
-	if (record == NULL)
-		ereport(ERROR,
-				(errcode_for_file_access(),
-				 errmsg("could not read foreign transaction state from xlog at %X/%X",
-						(uint32) (lsn >> 32),
-						(uint32) lsn)));
-
-	if (XLogRecGetRmid(xlogreader) != RM_FDWXACT_ID ||
-		(XLogRecGetInfo(xlogreader) & ~XLR_INFO_MASK) != XLOG_FDWXACT_INSERT)
-		ereport(ERROR,
-				(errcode_for_file_access(),
-				 errmsg("expected foreign transaction state data is not present in xlog at %X/%X",
-						(uint32) (lsn >> 32),
-						(uint32) lsn)));
-
-	if (len != NULL)
-		*len = XLogRecGetDataLen(xlogreader);
-
-	*buf = palloc(sizeof(char) * XLogRecGetDataLen(xlogreader));
-	memcpy(*buf, XLogRecGetData(xlogreader), sizeof(char) * XLogRecGetDataLen(xlogreader));
-
-	XLogReaderFree(xlogreader);
-}
+		if (!(fdwxact->valid || fdwxact->inredo) ||
+			fdwxact->insert_end_lsn > redo_horizon)
+			continue;
 
-/*
- * Recreates a foreign transaction state file. This is used in WAL replay
- * and during checkpoint creation.
- *
- * Note: content and len don't include CRC.
- */
-void
-RecreateFdwXactFile(Oid dbid, TransactionId xid, Oid serverid,
-					Oid userid, void *content, int len)
-{
-	char		path[MAXPGPATH];
-	pg_crc32c	statefile_crc;
-	int			fd;
+		data = &entries[nentries++];
+		data->local_xid = fdwxact->local_xid;
+		data->dbid = fdwxact->dbid;
+		data->serverid = fdwxact->serverid;
+		data->userid = fdwxact->userid;
+		data->umid = fdwxact->umid;
+		data->fxid = fdwxact->fxid;
+	}
+	LWLockRelease(FdwXactLock);
 
-	/* Recompute CRC */
-	INIT_CRC32C(statefile_crc);
-	COMP_CRC32C(statefile_crc, content, len);
-	FIN_CRC32C(statefile_crc);
+	if (nentries == 0)
+	{
+		/* Make the removal durable, the old entries must not come back */
+		if (unlink(FDWXACT_SNAPSHOT_FILE) == 0)
+			fsync_fname(FDWXACTS_DIR, true);
+		else if (errno != ENOENT)
+			ereport(ERROR,
+					(errcode_for_file_access(),
+					 errmsg("could not remove file \"%s\": %m",
+							FDWXACT_SNAPSHOT_FILE)));
+		if (buf)
+			pfree(buf);
+		return;
+	}
 
-	FdwXactFilePath(path, dbid, xid, serverid, userid);
+	hdr = (FdwXactSnapshotHeader *) buf;
+	hdr->magic = FDWXACT_SNAPSHOT_MAGIC;
+	hdr->nentries = nentries;
+	len = SizeOfFdwXactSnapshotHeader + sizeof(FdwXactOnDiskData) * nentries;
 
-	fd = OpenTransientFile(path, O_CREAT | O_TRUNC | O_WRONLY | PG_BINARY);
+	INIT_CRC32C(crc);
+	COMP_CRC32C(crc, buf, len);
+	FIN_CRC32C(crc);
+	memcpy(buf + len, &crc, sizeof(pg_crc32c));
+	len += sizeof(pg_crc32c);
 
+	fd = OpenTransientFile(FDWXACT_SNAPSHOT_TMPFILE,
+						   O_CREAT | O_TRUNC | O_WRONLY | PG_BINARY);
 	if (fd < 0)
 		ereport(ERROR,
 				(errcode_for_file_access(),
-				 errmsg("could not recreate foreign transaction state file \"%s\": %m",
-						path)));
+				 errmsg("could not create file \"%s\": %m",
+						FDWXACT_SNAPSHOT_TMPFILE)));
 
-	/* Write content and CRC */
+	errno = 0;
 	pgstat_report_wait_start(WAIT_EVENT_FDWXACT_FILE_WRITE);
-	if (write(fd, content, len) != len)
+	if (write(fd, buf, len) != len)
 	{
 		/* if write didn't set errno, assume problem is no disk space */
 		if (errno == 0)
 			errno = ENOSPC;
 		ereport(ERROR,
 				(errcode_for_file_access(),
-				 errmsg("could not write foreign transaction state file: %m")));
-	}
-	if (write(fd, &statefile_crc, sizeof(pg_crc32c)) != sizeof(pg_crc32c))
-	{
-		if (errno == 0)
-			errno = ENOSPC;
-		ereport(ERROR,
-				(errcode_for_file_access(),
-				 errmsg("could not write foreign transaction state file: %m")));
+				 errmsg("could not write file \"%s\": %m",
+						FDWXACT_SNAPSHOT_TMPFILE)));
 	}
 	pgstat_report_wait_end();
 
-	/*
-	 * We must fsync the file because the end-of-replay checkpoint will not do
-	 * so, there being no FDWXACT in shared memory yet to tell it to.
-	 */
 	pgstat_report_wait_start(WAIT_EVENT_FDWXACT_FILE_SYNC);
 	if (pg_fsync(fd) != 0)
-		ereport(ERROR,
+		ereport(data_sync_elevel(ERROR),
 				(errcode_for_file_access(),
-				 errmsg("could not fsync foreign transaction state file: %m")));
+				 errmsg("could not fsync file \"%s\": %m",
+						FDWXACT_SNAPSHOT_TMPFILE)));
 	pgstat_report_wait_end();
 
 	if (CloseTransientFile(fd) != 0)
 		ereport(ERROR,
 				(errcode_for_file_access(),
-				 errmsg("could not close foreign transaction file: %m")));
+				 errmsg("could not close file \"%s\": %m",
+						FDWXACT_SNAPSHOT_TMPFILE)));
+
+	/* Replace the previous snapshot */
+	durable_rename(FDWXACT_SNAPSHOT_TMPFILE, FDWXACT_SNAPSHOT_FILE, ERROR);
+
+	pfree(buf);
+
+	if (log_checkpoints)
+		ereport(LOG,
+				(errmsg_plural("%d foreign transaction was written to the snapshot file",
+							   "%d foreign transactions were written to the snapshot file",
+							   nentries,
+							   nentries)));
 }
 
 /*
- * Given a transaction id, userid and serverid read it either from disk
- * or read it directly via shmem xlog record pointer using the provided
- * "insert_start_lsn".
+ * Remove the entry if its local transaction is not older than the next XID,
+ * that is, no evidence of the transaction exists in WAL.  Return true if the
+ * entry was removed.
  */
-static char *
-ProcessFdwXactBuffer(Oid dbid, TransactionId xid, Oid serverid,
-					 Oid userid, XLogRecPtr insert_start_lsn, bool fromdisk)
+static bool
+FdwXactRejectFutureXid(FdwXact fdwxact)
 {
 	TransactionId origNextXid =
 	XidFromFullTransactionId(ShmemVariableCache->nextXid);
-	char	   *buf;
 
 	Assert(LWLockHeldByMeInMode(FdwXactLock, LW_EXCLUSIVE));
 
-	if (!fromdisk)
-		Assert(!XLogRecPtrIsInvalid(insert_start_lsn));
+	if (TransactionIdPrecedes(fdwxact->local_xid, origNextXid))
+		return false;
 
-	/* Reject XID if too new */
-	if (TransactionIdFollowsOrEquals(xid, origNextXid))
-	{
-		if (fromdisk)
-		{
-			ereport(WARNING,
-					(errmsg("removing future fdwxact state file for xid %u, server %u and user %u",
-							xid, serverid, userid)));
-			RemoveFdwXactFile(dbid, xid, serverid, userid, true);
-		}
-		else
-		{
-			ereport(WARNING,
-					(errmsg("removing future fdwxact state from memory for xid %u, server %u and user %u",
-							xid, serverid, userid)));
-			FdwXactRedoRemove(dbid, xid, serverid, userid, true);
-		}
-		return NULL;
-	}
+	ereport(WARNING,
+			(errmsg("removing future fdwxact state for xid %u, server %u and user %u",
+					fdwxact->local_xid, fdwxact->serverid, fdwxact->userid)));
+	FdwXactRedoRemove(fdwxact->dbid, fdwxact->local_xid, fdwxact->serverid,
+					  fdwxact->userid);
 
-	if (fromdisk)
-	{
-		/* Read and validate file */
-		buf = ReadFdwXactFile(dbid, xid, serverid, userid);
-	}
-	else
+	return true;
+}
+
+/*
+ * Scan the shared memory entries of FdwXact and determine the range of valid
+ * XIDs present.  This is run during database startup, after we have completed
+ * reading WAL.	 ShmemVariableCache->nextXid has been set to one more than
+ * the highest XID for which evidence exists in WAL.
+ *
+ * Our other responsibility is to update and return the oldest valid XID
+ * among the distributed transactions. This is needed to synchronize pg_subtrans
+ * startup properly.
+ */
+TransactionId
+PrescanFdwXacts(TransactionId oldestActiveXid)
+{
+	TransactionId result =
+	XidFromFullTransactionId(ShmemVariableCache->nextXid);
+	int			i = 0;
+
+	LWLockAcquire(FdwXactLock, LW_EXCLUSIVE);
+	while (i < FdwXactCtl->num_fdwxacts)
 	{
-		/* Read xlog data */
-		XlogReadFdwXactData(insert_start_lsn, &buf, NULL);
+		FdwXact		fdwxact = FdwXactCtl->fdwxacts[i];
+
+		/* Removing an entry moves the last one into its slot */
+		if (FdwXactRejectFutureXid(fdwxact))
+			continue;
+
+		if (TransactionIdPrecedes(fdwxact->local_xid, result))
+			result = fdwxact->local_xid;
+		i++;
 	}
+	LWLockRelease(FdwXactLock);
 
-	return buf;
+	return result;
 }
 
 /*
- * Read and validate the foreign transaction state file.
- *
- * If it looks OK (has a valid magic number and CRC), return the palloc'd
- * contents of the file, issuing an error when finding corrupted data.
- * This state can be reached when doing recovery.
+ * Read the snapshot file written by the last checkpoint and fill FdwXact with
+ * its entries.  This is called once at the beginning of recovery, and reads
+ * the whole file at once.  On a corrupted snapshot, fail immediately.
  */
-static char *
-ReadFdwXactFile(Oid dbid, TransactionId xid, Oid serverid, Oid userid)
+void
+RestoreFdwXactData(void)
 {
-	char		path[MAXPGPATH];
-	int			fd;
-	FdwXactOnDiskData *fdwxact_file_data;
+	FdwXactSnapshotHeader *hdr;
 	struct stat stat;
 	uint32		crc_offset;
 	pg_crc32c	calc_crc;
 	pg_crc32c	file_crc;
 	char	   *buf;
+	char	   *ptr;
+	int			fd;
 	int			r;
 
-	FdwXactFilePath(path, dbid, xid, serverid, userid);
-
-	fd = OpenTransientFile(path, O_RDONLY | PG_BINARY);
+	fd = OpenTransientFile(FDWXACT_SNAPSHOT_FILE, O_RDONLY | PG_BINARY);
 	if (fd < 0)
+	{
+		/* No in-doubt foreign transactions at the last checkpoint */
+		if (errno == ENOENT)
+			return;
 		ereport(ERROR,
 				(errcode_for_file_access(),
-				 errmsg("could not open FDW transaction state file \"%s\": %m",
-						path)));
+				 errmsg("could not open file \"%s\": %m",
+						FDWXACT_SNAPSHOT_FILE)));
+	}
 
-	/*
-	 * Check file length.  We can determine a lower bound pretty easily. We
-	 * set an upper bound to avoid palloc() failure on a corrupt file, though
-	 * we can't guarantee that we won't get an out of memory error anyway,
-	 * even on a valid file.
-	 */
 	if (fstat(fd, &stat))
 		ereport(ERROR,
 				(errcode_for_file_access(),
-				 errmsg("could not stat FDW transaction state file \"%s\": %m",
-						path)));
+				 errmsg("could not stat file \"%s\": %m",
+						FDWXACT_SNAPSHOT_FILE)));
 
-	if (stat.st_size < (offsetof(FdwXactOnDiskData, fdwxact_id) +
-						sizeof(pg_crc32c)) ||
+	if (stat.st_size < (SizeOfFdwXactSnapshotHeader + sizeof(pg_crc32c)) ||
 		stat.st_size > MaxAllocSize)
-
-		ereport(ERROR,
-				(errcode_for_file_access(),
-				 errmsg("too large FDW transaction state file \"%s\": %m",
-						path)));
-
-	crc_offset = stat.st_size - sizeof(pg_crc32c);
-	if (crc_offset != MAXALIGN(crc_offset))
 		ereport(ERROR,
 				(errcode(ERRCODE_DATA_CORRUPTED),
-				 errmsg("incorrect alignment of CRC offset for file \"%s\"",
-						path)));
+				 errmsg("invalid size of foreign transaction snapshot file \"%s\"",
+						FDWXACT_SNAPSHOT_FILE)));
 
-	/*
-	 * Ok, slurp in the file.
-	 */
 	buf = (char *) palloc(stat.st_size);
-	fdwxact_file_data = (FdwXactOnDiskData *) buf;
 
-	/* Slurp the file */
 	pgstat_report_wait_start(WAIT_EVENT_FDWXACT_FILE_READ);
 	r = read(fd, buf, stat.st_size);
 	if (r != stat.st_size)
@@ -1779,154 +2827,52 @@ ReadFdwXactFile(Oid dbid, TransactionId xid, Oid serverid, Oid userid)
 		if (r < 0)
 			ereport(ERROR,
 					(errcode_for_file_access(),
-					 errmsg("could not read file \"%s\": %m", path)));
+					 errmsg("could not read file \"%s\": %m",
+							FDWXACT_SNAPSHOT_FILE)));
 		else
 			ereport(ERROR,
 					(errmsg("could not read file \"%s\": read %d of %zu",
-							path, r, (Size) stat.st_size)));
+							FDWXACT_SNAPSHOT_FILE, r, (Size) stat.st_size)));
 	}
 	pgstat_report_wait_end();
 
-	if (CloseTransientFile(fd))
+	if (CloseTransientFile(fd) != 0)
 		ereport(ERROR,
 				(errcode_for_file_access(),
-				 errmsg("could not close file \"%s\": %m", path)));
+				 errmsg("could not close file \"%s\": %m",
+						FDWXACT_SNAPSHOT_FILE)));
 
-	/*
-	 * Check the CRC.
-	 */
+	crc_offset = stat.st_size - sizeof(pg_crc32c);
 	INIT_CRC32C(calc_crc);
 	COMP_CRC32C(calc_crc, buf, crc_offset);
 	FIN_CRC32C(calc_crc);
-
-	file_crc = *((pg_crc32c *) (buf + crc_offset));
+	memcpy(&file_crc, buf + crc_offset, sizeof(pg_crc32c));
 
 	if (!EQ_CRC32C(calc_crc, file_crc))
 		ereport(ERROR,
 				(errcode(ERRCODE_DATA_CORRUPTED),
 				 errmsg("calculated CRC checksum does not match value stored in file \"%s\"",
-						path)));
-
-	/* Check if the contents is an expected data */
-	fdwxact_file_data = (FdwXactOnDiskData *) buf;
-	if (fdwxact_file_data->dbid != dbid ||
-		fdwxact_file_data->serverid != serverid ||
-		fdwxact_file_data->userid != userid ||
-		fdwxact_file_data->local_xid != xid)
+						FDWXACT_SNAPSHOT_FILE)));
+
+	hdr = (FdwXactSnapshotHeader *) buf;
+	if (hdr->magic != FDWXACT_SNAPSHOT_MAGIC || hdr->nentries < 0 ||
+		crc_offset != SizeOfFdwXactSnapshotHeader +
+		sizeof(FdwXactOnDiskData) * hdr->nentries)
 		ereport(ERROR,
 				(errcode(ERRCODE_DATA_CORRUPTED),
-				 errmsg("invalid foreign transaction state file \"%s\"",
-						path)));
-
-	return buf;
-}
-
-/*
- * Scan the shared memory entries of FdwXact and determine the range of valid
- * XIDs present.  This is run during database startup, after we have completed
- * reading WAL.	 ShmemVariableCache->nextXid has been set to one more than
- * the highest XID for which evidence exists in WAL.
-
- * On corrupted two-phase files, fail immediately.	Keeping around broken
- * entries and let replay continue causes harm on the system, and a new
- * backup should be rolled in.
-
- * Our other responsibility is to update and return the oldest valid XID
- * among the distributed transactions. This is needed to synchronize pg_subtrans
- * startup properly.
- */
-TransactionId
-PrescanFdwXacts(TransactionId oldestActiveXid)
-{
-	FullTransactionId nextXid = ShmemVariableCache->nextXid;
-	TransactionId origNextXid = XidFromFullTransactionId(nextXid);
-	TransactionId result = origNextXid;
-
-	LWLockAcquire(FdwXactLock, LW_EXCLUSIVE);
-	for (int i = 0; i < FdwXactCtl->num_fdwxacts; i++)
-	{
-		FdwXact		fdwxact = FdwXactCtl->fdwxacts[i];
-		char	   *buf;
-
-		buf = ProcessFdwXactBuffer(fdwxact->dbid, fdwxact->local_xid,
-								   fdwxact->serverid, fdwxact->userid,
-								   fdwxact->insert_start_lsn, fdwxact->ondisk);
-
-		if (buf == NULL)
-			continue;
-
-		if (TransactionIdPrecedes(fdwxact->local_xid, result))
-			result = fdwxact->local_xid;
-
-		pfree(buf);
-	}
-	LWLockRelease(FdwXactLock);
-
-	return result;
-}
-
-/*
- * Scan pg_fdwxact and fill FdwXact depending on the on-disk data.
- * This is called once at the beginning of recovery, saving any extra
- * lookups in the future.  FdwXact files that are newer than the
- * minimum XID horizon are discarded on the way.
- */
-void
-RestoreFdwXactData(void)
-{
-	DIR		   *cldir;
-	struct dirent *clde;
+				 errmsg("invalid foreign transaction snapshot file \"%s\"",
+						FDWXACT_SNAPSHOT_FILE)));
 
 	LWLockAcquire(FdwXactLock, LW_EXCLUSIVE);
-	cldir = AllocateDir(FDWXACTS_DIR);
-	while ((clde = ReadDir(cldir, FDWXACTS_DIR)) != NULL)
+	ptr = buf + SizeOfFdwXactSnapshotHeader;
+	for (int i = 0; i < hdr->nentries; i++)
 	{
-		if (strlen(clde->d_name) == FDWXACT_FILE_NAME_LEN &&
-			strspn(clde->d_name, "0123456789ABCDEF_") == FDWXACT_FILE_NAME_LEN)
-		{
-			TransactionId local_xid;
-			Oid			dbid;
-			Oid			serverid;
-			Oid			userid;
-			char	   *buf;
-
-			sscanf(clde->d_name, "%08x_%08x_%08x_%08x",
-				   &dbid, &local_xid, &serverid, &userid);
-
-			/* Read fdwxact data from disk */
-			buf = ProcessFdwXactBuffer(dbid, local_xid, serverid, userid,
-									   InvalidXLogRecPtr, true);
-
-			if (buf == NULL)
-				continue;
-
-			/* Add this entry into the table of foreign transactions */
-			FdwXactRedoAdd(buf, InvalidXLogRecPtr, InvalidXLogRecPtr);
-		}
+		FdwXactRedoAdd(ptr, InvalidXLogRecPtr);
+		ptr += sizeof(FdwXactOnDiskData);
 	}
-
 	LWLockRelease(FdwXactLock);
-	FreeDir(cldir);
-}
 
-/*
- * Remove the foreign transaction file for given entry.
- *
- * If giveWarning is false, do not complain about file-not-present;
- * this is an expected case during WAL replay.
- */
-static void
-RemoveFdwXactFile(Oid dbid, TransactionId xid, Oid serverid, Oid userid,
-				  bool giveWarning)
-{
-	char		path[MAXPGPATH];
-
-	FdwXactFilePath(path, dbid, xid, serverid, userid);
-	if (unlink(path) < 0 && (errno != ENOENT || giveWarning))
-		ereport(WARNING,
-				(errcode_for_file_access(),
-				 errmsg("could not remove foreign transaction state file \"%s\": %m",
-						path)));
+	pfree(buf);
 }
 
 /*
@@ -1938,17 +2884,15 @@ RemoveFdwXactFile(Oid dbid, TransactionId xid, Oid serverid, Oid userid,
 void
 RecoverFdwXacts(void)
 {
+	int			i = 0;
+
 	LWLockAcquire(FdwXactLock, LW_EXCLUSIVE);
-	for (int i = 0; i < FdwXactCtl->num_fdwxacts; i++)
+	while (i < FdwXactCtl->num_fdwxacts)
 	{
 		FdwXact		fdwxact = FdwXactCtl->fdwxacts[i];
-		char	   *buf;
-
-		buf = ProcessFdwXactBuffer(fdwxact->dbid, fdwxact->local_xid,
-								   fdwxact->serverid, fdwxact->userid,
-								   fdwxact->insert_start_lsn, fdwxact->ondisk);
 
-		if (buf == NULL)
+		/* Removing an entry moves the last one into its slot */
+		if (FdwXactRejectFutureXid(fdwxact))
 			continue;
 
 		ereport(LOG,
@@ -1958,7 +2902,7 @@ RecoverFdwXacts(void)
 		/* recovered, so reset the flag for entries generated by redo */
 		fdwxact->inredo = false;
 		fdwxact->valid = true;
-		pfree(buf);
+		i++;
 	}
 	LWLockRelease(FdwXactLock);
 }
@@ -1982,6 +2926,9 @@ pg_foreign_xacts(PG_FUNCTION_ARGS)
 #define PG_PREPARED_FDWXACTS_COLS	6
 	ReturnSetInfo *rsinfo = (ReturnSetInfo *) fcinfo->resultinfo;
 	TupleDesc	tupdesc;
+	FdwXactData *fdwxacts;
+	int		   *lockers;
+	int			nfdwxacts = 0;
 	Tuplestorestate *tupstore;
 	MemoryContext per_query_ctx;
 	MemoryContext oldcontext;
@@ -2010,29 +2957,52 @@ pg_foreign_xacts(PG_FUNCTION_ARGS)
 
 	MemoryContextSwitchTo(oldcontext);
 
+	/*
+	 * Copy the entries so that we can look up the FDWs to render the
+	 * identifiers without holding the lock.
+	 */
 	LWLockAcquire(FdwXactLock, LW_SHARED);
+	fdwxacts = (FdwXactData *) palloc(sizeof(FdwXactData) *
+									  Max(FdwXactCtl->num_fdwxacts, 1));
+	lockers = (int *) palloc(sizeof(int) * Max(FdwXactCtl->num_fdwxacts, 1));
 	for (int i = 0; i < FdwXactCtl->num_fdwxacts; i++)
 	{
 		FdwXact		fdwxact = FdwXactCtl->fdwxacts[i];
-		FdwXactStatus status;
-		char	   *xact_status;
-		Datum		values[PG_PREPARED_FDWXACTS_COLS];
-		bool		nulls[PG_PREPARED_FDWXACTS_COLS];
 
 		if (!fdwxact->valid)
 			continue;
 
-		memset(nulls, 0, sizeof(nulls));
+		memcpy(&fdwxacts[nfdwxacts], fdwxact, sizeof(FdwXactData));
 
 		SpinLockAcquire(&fdwxact->mutex);
-		status = fdwxact->status;
+		fdwxacts[nfdwxacts].status = fdwxact->status;
 		SpinLockRelease(&fdwxact->mutex);
 
+		if (fdwxact->locking_backend != InvalidBackendId)
+			lockers[nfdwxacts] = BackendIdGetProc(fdwxact->locking_backend)->pid;
+		else
+			lockers[nfdwxacts] = InvalidPid;
+
+		nfdwxacts++;
+	}
+	LWLockRelease(FdwXactLock);
+
+	for (int i = 0; i < nfdwxacts; i++)
+	{
+		FdwXact		fdwxact = &fdwxacts[i];
+		ForeignServer *server;
+		char	   *xact_status;
+		char		fdwxact_id[FDWXACT_ID_MAX_LEN];
+		Datum		values[PG_PREPARED_FDWXACTS_COLS];
+		bool		nulls[PG_PREPARED_FDWXACTS_COLS];
+
+		memset(nulls, 0, sizeof(nulls));
+
 		values[0] = TransactionIdGetDatum(fdwxact->local_xid);
 		values[1] = ObjectIdGetDatum(fdwxact->serverid);
 		values[2] = ObjectIdGetDatum(fdwxact->userid);
 
-		switch (status)
+		switch (fdwxact->status)
 		{
 			case FDWXACT_STATUS_PREPARING:
 				xact_status = "preparing";
@@ -2052,19 +3022,22 @@ pg_foreign_xacts(PG_FUNCTION_ARGS)
 		}
 
 		values[3] = CStringGetTextDatum(xact_status);
-		values[4] = CStringGetTextDatum(fdwxact->fdwxact_id);
 
-		if (fdwxact->locking_backend != InvalidBackendId)
-		{
-			PGPROC *locker = BackendIdGetProc(fdwxact->locking_backend);
-			values[5] = Int32GetDatum(locker->pid);
-		}
+		server = GetForeignServerExtended(fdwxact->serverid, FSV_MISSING_OK);
+		render_fdwxact_id(&fdwxact->fxid, fdwxact->serverid, fdwxact->userid,
+						  server ?
+						  GetFdwRoutineByServerId(server->serverid)->GetPrepareId :
+						  NULL,
+						  fdwxact_id);
+		values[4] = CStringGetTextDatum(fdwxact_id);
+
+		if (lockers[i] != InvalidPid)
+			values[5] = Int32GetDatum(lockers[i]);
 		else
 			nulls[5] = true;
 
 		tuplestore_putvalues(tupstore, tupdesc, values, nulls);
 	}
-	LWLockRelease(FdwXactLock);
 
 	/* clean up and return the tuplestore */
 	tuplestore_donestoring(tupstore);
@@ -2083,13 +3056,12 @@ pg_resolve_foreign_xact(PG_FUNCTION_ARGS)
 	Oid			userid = PG_GETARG_OID(2);
 	Oid			myuserid;
 	FdwXact		fdwxact;
-	int			idx;
 
 	LWLockAcquire(FdwXactLock, LW_EXCLUSIVE);
 
-	idx = get_fdwxact(MyDatabaseId, xid, serverid, userid);
+	fdwxact = get_fdwxact(MyDatabaseId, xid, serverid, userid);
 
-	if (idx < 0)
+	if (fdwxact == NULL)
 	{
 		/* not found */
 		LWLockRelease(FdwXactLock);
@@ -2098,8 +3070,6 @@ pg_resolve_foreign_xact(PG_FUNCTION_ARGS)
 				 errmsg("does not exist foreign transaction")));
 	}
 
-	fdwxact = FdwXactCtl->fdwxacts[idx];
-
 	myuserid = GetUserId();
 	if (myuserid != fdwxact->userid && !superuser_arg(myuserid))
 		ereport(ERROR,
@@ -2112,8 +3082,8 @@ pg_resolve_foreign_xact(PG_FUNCTION_ARGS)
 		LWLockRelease(FdwXactLock);
 		ereport(ERROR,
 				(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
-				 errmsg("foreign transaction with transaction identifier \"%s\" is busy",
-						fdwxact->fdwxact_id)));
+				 errmsg("foreign transaction of transaction %u on foreign server %u is busy",
+						xid, serverid)));
 	}
 
 	if (TwoPhaseExists(fdwxact->local_xid))
@@ -2126,8 +3096,8 @@ pg_resolve_foreign_xact(PG_FUNCTION_ARGS)
 		LWLockRelease(FdwXactLock);
 		ereport(ERROR,
 				(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
-				 errmsg("cannot resolve foreign transaction with identifier \"%s\" whose local transaction is in-progress",
-						fdwxact->fdwxact_id),
+				 errmsg("cannot resolve foreign transaction of transaction %u on foreign server %u whose local transaction is in-progress",
+						xid, serverid),
 				 errhint("Do COMMIT PREPARED or ROLLBACK PREPARED")));
 	}
 
@@ -2138,12 +3108,12 @@ pg_resolve_foreign_xact(PG_FUNCTION_ARGS)
 
 	PG_TRY();
 	{
-		FdwXactResolveFdwXacts(&idx, 1);
+		FdwXactResolveFdwXacts(&fdwxact, 1);
 	}
 	PG_CATCH();
 	{
 		LWLockAcquire(FdwXactLock, LW_EXCLUSIVE);
-		FdwXactCtl->fdwxacts[idx]->locking_backend = InvalidBackendId;
+		fdwxact->locking_backend = InvalidBackendId;
 		LWLockRelease(FdwXactLock);
 
 		PG_RE_THROW();
@@ -2167,7 +3137,6 @@ pg_remove_foreign_xact(PG_FUNCTION_ARGS)
 	Oid			userid = PG_GETARG_OID(2);
 	Oid			myuserid;
 	FdwXact		fdwxact;
-	int			idx;
 
 	if (!superuser())
 		ereport(ERROR,
@@ -2176,9 +3145,9 @@ pg_remove_foreign_xact(PG_FUNCTION_ARGS)
 
 	LWLockAcquire(FdwXactLock, LW_EXCLUSIVE);
 
-	idx = get_fdwxact(MyDatabaseId, xid, serverid, userid);
+	fdwxact = get_fdwxact(MyDatabaseId, xid, serverid, userid);
 
-	if (idx < 0)
+	if (fdwxact == NULL)
 	{
 		/* not found */
 		LWLockRelease(FdwXactLock);
@@ -2188,8 +3157,6 @@ pg_remove_foreign_xact(PG_FUNCTION_ARGS)
 						serverid)));
 	}
 
-	fdwxact = FdwXactCtl->fdwxacts[idx];
-
 	myuserid = GetUserId();
 	if (myuserid != fdwxact->userid && !superuser_arg(myuserid))
 		ereport(ERROR,
@@ -2212,11 +3179,6 @@ pg_remove_foreign_xact(PG_FUNCTION_ARGS)
 
 	PG_TRY();
 	{
-		/* Clean up entry and any files we may have left */
-		if (fdwxact->ondisk)
-			RemoveFdwXactFile(fdwxact->dbid, fdwxact->local_xid,
-							  fdwxact->serverid, fdwxact->userid,
-							  true);
 		remove_fdwxact(fdwxact);
 	}
 	PG_CATCH();
@@ -2233,6 +3195,8 @@ pg_remove_foreign_xact(PG_FUNCTION_ARGS)
 
 	LWLockRelease(FdwXactLock);
 
+	FdwXactComputeRequiredXmin();
+
 	PG_RETURN_BOOL(true);
 }
 
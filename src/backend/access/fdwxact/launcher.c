@@ -5,6 +5,8 @@
  * The foreign transaction resolver launcher process starts foreign
  * transaction resolver processes. The launcher schedules resolver
  * process to be started when arrived a requested by backend process.
+ * One resolver is started for each pair of database and foreign server
+ * that has foreign transactions to resolve.
  *
  * Portions Copyright (c) 2020, PostgreSQL Global Development Group
  *
@@ -39,13 +41,20 @@
 
 static void fdwxact_launcher_onexit(int code, Datum arg);
 static void fdwxact_launcher_sighup(SIGNAL_ARGS);
-static void fdwxact_launch_resolver(Oid dbid);
+static bool fdwxact_launch_resolver(Oid dbid, Oid serverid);
 static bool fdwxact_relaunch_resolvers(void);
 
 static volatile sig_atomic_t got_SIGHUP = false;
 static volatile sig_atomic_t got_SIGUSR2 = false;
 FdwXactResolver *MyFdwXactResolver = NULL;
 
+/* Hash key and entry identifying the work of one resolver */
+typedef struct FdwXactRslvKey
+{
+	Oid			dbid;
+	Oid			serverid;
+} FdwXactRslvKey;
+
 /*
  * Wake up the launcher process to request launching new resolvers
  * immediately.
@@ -97,6 +106,7 @@ FdwXactRslvShmemInit(void)
 			FdwXactResolver *resolver = &FdwXactRslvCtl->resolvers[slot];
 
 			memset(resolver, 0, sizeof(FdwXactResolver));
+			resolver->pid = InvalidPid;
 			SpinLockInit(&(resolver->mutex));
 		}
 	}
@@ -250,37 +260,32 @@ FdwXactLauncherMain(Datum main_arg)
 /*
  * Request launcher to launch a new foreign transaction resolver process
  * or wake up the resolver if it's already running.
+ *
+ * Wake up the resolver for the given foreign server on our database.  If
+ * serverid is InvalidOid, wake up all resolvers on our database and let the
+ * launcher start the ones missing, since we don't know which servers have
+ * work to do.
  */
 void
-FdwXactLaunchOrWakeupResolver(void)
+FdwXactLaunchOrWakeupResolver(Oid serverid)
 {
-	volatile FdwXactResolver *resolver;
 	bool		found = false;
 
 	/*
 	 * Looking for a resolver process that is running and working on the same
-	 * database.
+	 * database and server.
 	 */
 	LWLockAcquire(FdwXactResolverLock, LW_SHARED);
 	for (int i = 0; i < max_foreign_xact_resolvers; i++)
 	{
-		resolver = &FdwXactRslvCtl->resolvers[i];
+		FdwXactResolver *resolver = &FdwXactRslvCtl->resolvers[i];
 
-		if (resolver->in_use &&
-			resolver->dbid == MyDatabaseId)
-		{
-			found = true;
-			break;
-		}
-	}
-	LWLockRelease(FdwXactResolverLock);
+		if (!resolver->in_use ||
+			resolver->dbid != MyDatabaseId ||
+			(OidIsValid(serverid) && resolver->serverid != serverid))
+			continue;
 
-	if (found)
-	{
-		/* Found the running resolver */
-		elog(DEBUG1,
-			 "found a running foreign transaction resolver process for database %u",
-			 MyDatabaseId);
+		found = true;
 
 		/*
 		 * Wakeup the resolver. It's possible that the resolver is starting up
@@ -290,6 +295,17 @@ FdwXactLaunchOrWakeupResolver(void)
 		if (resolver->latch)
 			SetLatch(resolver->latch);
 
+		if (OidIsValid(serverid))
+			break;
+	}
+	LWLockRelease(FdwXactResolverLock);
+
+	if (found && OidIsValid(serverid))
+	{
+		/* Found the running resolver */
+		elog(DEBUG1,
+			 "found a running foreign transaction resolver process for database %u and server %u",
+			 MyDatabaseId, serverid);
 		return;
 	}
 
@@ -299,10 +315,11 @@ FdwXactLaunchOrWakeupResolver(void)
 
 /*
  * Launch a foreign transaction resolver process that will connect to given
- * 'dbid'.
+ * 'dbid' and resolve foreign transactions on 'serverid'.  Return false if
+ * there is no free resolver slot.
  */
-static void
-fdwxact_launch_resolver(Oid dbid)
+static bool
+fdwxact_launch_resolver(Oid dbid, Oid serverid)
 {
 	BackgroundWorker bgw;
 	BackgroundWorkerHandle *bgw_handle;
@@ -324,16 +341,25 @@ fdwxact_launch_resolver(Oid dbid)
 		}
 	}
 
-	/* No unused found */
+	/*
+	 * No unused found.  The other resolvers exit once they are idle for
+	 * foreign_xact_resolver_timeout, so we will retry later.
+	 */
 	if (i >= max_foreign_xact_resolvers)
-		ereport(ERROR,
+	{
+		LWLockRelease(FdwXactResolverLock);
+		ereport(WARNING,
 				(errcode(ERRCODE_CONFIGURATION_LIMIT_EXCEEDED),
 				 errmsg("out of foreign transaction resolver slots"),
 				 errhint("You might need to increase max_foreign_transaction_resolvers.")));
+		return false;
+	}
 
 	resolver = &FdwXactRslvCtl->resolvers[unused_slot];
 	resolver->in_use = true;
+	resolver->pid = InvalidPid;
 	resolver->dbid = dbid;
+	resolver->serverid = serverid;
 	LWLockRelease(FdwXactResolverLock);
 
 	/* Register the new dynamic worker */
@@ -344,7 +370,8 @@ fdwxact_launch_resolver(Oid dbid)
 	snprintf(bgw.bgw_library_name, BGW_MAXLEN, "postgres");
 	snprintf(bgw.bgw_function_name, BGW_MAXLEN, "FdwXactResolverMain");
 	snprintf(bgw.bgw_name, BGW_MAXLEN,
-			 "foreign transaction resolver for database %u", resolver->dbid);
+			 "foreign transaction resolver for database %u server %u",
+			 resolver->dbid, resolver->serverid);
 	snprintf(bgw.bgw_type, BGW_MAXLEN, "foreign transaction resolver");
 	bgw.bgw_restart_time = BGW_NEVER_RESTART;
 	bgw.bgw_notify_pid = MyProcPid;
@@ -353,52 +380,56 @@ fdwxact_launch_resolver(Oid dbid)
 	if (!RegisterDynamicBackgroundWorker(&bgw, &bgw_handle))
 	{
 		/* Failed to launch, cleanup the worker slot */
-		SpinLockAcquire(&(MyFdwXactResolver->mutex));
+		LWLockAcquire(FdwXactResolverLock, LW_EXCLUSIVE);
 		resolver->in_use = false;
-		SpinLockRelease(&(MyFdwXactResolver->mutex));
+		LWLockRelease(FdwXactResolverLock);
 
 		ereport(WARNING,
 				(errcode(ERRCODE_CONFIGURATION_LIMIT_EXCEEDED),
 				 errmsg("out of background worker slots"),
 				 errhint("You might need to increase max_worker_processes.")));
+		return false;
 	}
 
 	/*
 	 * We don't need to wait until it attaches here because we're going to
 	 * wait until all foreign transactions are resolved.
 	 */
+	return true;
 }
 
 /*
- * Launch or relaunch foreign transaction resolvers on database that has
- * at least one FdwXact entry but no resolver is running on it.
+ * Launch or relaunch foreign transaction resolvers for pairs of database and
+ * foreign server that have at least one FdwXact entry but no resolver is
+ * running on them.
  */
 static bool
 fdwxact_relaunch_resolvers(void)
 {
-	HTAB	   *fdwxact_dbs;
-	HTAB	   *resolver_dbs;
+	HTAB	   *fdwxact_rslvs;
+	HTAB	   *running_rslvs;
 	HASHCTL		ctl;
 	HASH_SEQ_STATUS status;
-	Oid		   *entry;
-	bool		launched;
+	FdwXactRslvKey *entry;
+	bool		launched = false;
 
 	memset(&ctl, 0, sizeof(ctl));
-	ctl.keysize = sizeof(Oid);
-	ctl.entrysize = sizeof(Oid);
+	ctl.keysize = sizeof(FdwXactRslvKey);
+	ctl.entrysize = sizeof(FdwXactRslvKey);
 
 	/*
-	 * Create a hash map for the database that has at least one foreign
-	 * transaction to resolve.
+	 * Create a hash map for the pairs of database and server that have at
+	 * least one foreign transaction to resolve.
 	 */
-	fdwxact_dbs = hash_create("fdwxact dblist",
-							  32, &ctl, HASH_ELEM | HASH_BLOBS);
+	fdwxact_rslvs = hash_create("fdwxact resolver list",
+								32, &ctl, HASH_ELEM | HASH_BLOBS);
 
-	/* Collect database oids that has at least one FdwXact entry to resolve */
+	/* Collect the pairs that have at least one FdwXact entry to resolve */
 	LWLockAcquire(FdwXactLock, LW_SHARED);
 	for (int i = 0; i < FdwXactCtl->num_fdwxacts; i++)
 	{
 		FdwXact		fdwxact = FdwXactCtl->fdwxacts[i];
+		FdwXactRslvKey key;
 
 		if (!fdwxact->valid)
 			continue;
@@ -410,55 +441,67 @@ fdwxact_relaunch_resolvers(void)
 		 */
 		if (fdwxact->locking_backend == InvalidBackendId &&
 			!TwoPhaseExists(fdwxact->local_xid))
-			hash_search(fdwxact_dbs, &(fdwxact->dbid), HASH_ENTER, NULL);
+		{
+			key.dbid = fdwxact->dbid;
+			key.serverid = fdwxact->serverid;
+			hash_search(fdwxact_rslvs, &key, HASH_ENTER, NULL);
+		}
 	}
 	LWLockRelease(FdwXactLock);
 
 	/* There is no foreign transaction to resolve, no need to launch new one */
-	if (hash_get_num_entries(fdwxact_dbs) == 0)
+	if (hash_get_num_entries(fdwxact_rslvs) == 0)
 	{
-		hash_destroy(fdwxact_dbs);
+		hash_destroy(fdwxact_rslvs);
 		return false;
 	}
 
-	/* Create a hash map for databases on which a resolver is running */
-	resolver_dbs = hash_create("resolver dblist",
-							   32, &ctl, HASH_ELEM | HASH_BLOBS);
+	/* Create a hash map for the pairs on which a resolver is running */
+	running_rslvs = hash_create("running resolver list",
+								32, &ctl, HASH_ELEM | HASH_BLOBS);
 
-	/* Collect database oids on which resolvers are running */
+	/* Collect the pairs on which resolvers are running */
 	LWLockAcquire(FdwXactResolverLock, LW_SHARED);
 	for (int i = 0; i < max_foreign_xact_resolvers; i++)
 	{
 		FdwXactResolver *resolver = &FdwXactRslvCtl->resolvers[i];
+		FdwXactRslvKey key;
 
 		if (!resolver->in_use)
 			continue;
 
-		hash_search(resolver_dbs, &(resolver->dbid), HASH_ENTER, NULL);
+		key.dbid = resolver->dbid;
+		key.serverid = resolver->serverid;
+		hash_search(running_rslvs, &key, HASH_ENTER, NULL);
 	}
 	LWLockRelease(FdwXactResolverLock);
 
 	/*
-	 * Find databases on which no resolver is running and launch new
+	 * Find the pairs on which no resolver is running and launch new
 	 * resolver process on them.
 	 */
-	hash_seq_init(&status, fdwxact_dbs);
-	while ((entry = (Oid *) hash_seq_search(&status)) != NULL)
+	hash_seq_init(&status, fdwxact_rslvs);
+	while ((entry = (FdwXactRslvKey *) hash_seq_search(&status)) != NULL)
 	{
 		bool		found;
 
-		hash_search(resolver_dbs, entry, HASH_FIND, &found);
+		hash_search(running_rslvs, entry, HASH_FIND, &found);
 
-		if (!found)
+		if (found)
+			continue;
+
+		/* No resolver is running on this pair, launch new one */
+		if (!fdwxact_launch_resolver(entry->dbid, entry->serverid))
 		{
-			/* No resolver is running on this database, launch new one */
-			fdwxact_launch_resolver(*entry);
-			launched = true;
+			/* No room for more, retry later */
+			hash_seq_term(&status);
+			break;
 		}
+		launched = true;
 	}
 
-	hash_destroy(fdwxact_dbs);
-	hash_destroy(resolver_dbs);
+	hash_destroy(fdwxact_rslvs);
+	hash_destroy(running_rslvs);
 
 	return launched;
 }
@@ -496,14 +539,13 @@ IsFdwXactLauncher(void)
 }
 
 /*
- * Stop the fdwxact resolver running on the given database.
+ * Stop the fdwxact resolvers running on the given database.
  */
 Datum
 pg_stop_foreign_xact_resolver(PG_FUNCTION_ARGS)
 {
 	Oid			dbid = PG_GETARG_OID(0);
-	FdwXactResolver *resolver = NULL;
-	int			i;
+	bool		found = false;
 
 	/* Must be super user */
 	if (!superuser())
@@ -518,31 +560,45 @@ pg_stop_foreign_xact_resolver(PG_FUNCTION_ARGS)
 
 	LWLockAcquire(FdwXactResolverLock, LW_SHARED);
 
-	/* Find the running resolver process on the given database */
-	for (i = 0; i < max_foreign_xact_resolvers; i++)
+	/* Terminate the running resolver processes on the given database ... */
+	for (int i = 0; i < max_foreign_xact_resolvers; i++)
 	{
-		resolver = &FdwXactRslvCtl->resolvers[i];
+		FdwXactResolver *resolver = &FdwXactRslvCtl->resolvers[i];
 
-		/* found! */
 		if (resolver->in_use && resolver->dbid == dbid)
-			break;
+		{
+			/* The resolver might not have attached to its slot yet */
+			if (resolver->pid != InvalidPid)
+				kill(resolver->pid, SIGTERM);
+			found = true;
+		}
 	}
 
-	if (i >= max_foreign_xact_resolvers)
+	if (!found)
 		ereport(ERROR,
 				(errmsg("there is no running foreign transaction resolver process on database %d",
 						dbid)));
 
-	/* Found the resolver, terminate it ... */
-	kill(resolver->pid, SIGTERM);
-
-	/* ... and wait for it to die */
+	/* ... and wait for them to die */
 	for (;;)
 	{
 		int			rc;
+		bool		alive = false;
 
-		/* is it gone? */
-		if (!resolver->in_use)
+		/* are they gone? */
+		for (int i = 0; i < max_foreign_xact_resolvers; i++)
+		{
+			FdwXactResolver *resolver = &FdwXactRslvCtl->resolvers[i];
+
+			if (resolver->in_use && resolver->dbid == dbid)
+			{
+				if (resolver->pid != InvalidPid)
+					kill(resolver->pid, SIGTERM);
+				alive = true;
+			}
+		}
+
+		if (!alive)
 			break;
 
 		LWLockRelease(FdwXactResolverLock);
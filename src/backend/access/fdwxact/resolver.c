@@ -71,10 +71,10 @@ static volatile sig_atomic_t got_SIGHUP = false;
 static TimestampTz last_resolution_time = -1;
 
 /*
- * held_fdwxacts has indexes of FdwXact which the resolver marked
+ * held_fdwxacts has FdwXact entries which the resolver marked
  * as in-processing. These mark is cleared on process exit.
  */
-static int *held_fdwxacts = NULL;
+static FdwXact *held_fdwxacts = NULL;
 static int	nheld;
 
 /* Set flag to reload configuration at next convenient time */
@@ -102,6 +102,7 @@ fdwxact_resolver_detach(void)
 	MyFdwXactResolver->pid = InvalidPid;
 	MyFdwXactResolver->in_use = false;
 	MyFdwXactResolver->dbid = InvalidOid;
+	MyFdwXactResolver->serverid = InvalidOid;
 
 	LWLockRelease(FdwXactResolverLock);
 }
@@ -117,10 +118,12 @@ fdwxact_resolver_onexit(int code, Datum arg)
 	/* Release the held foreign transaction entries */
 	for (int i = 0; i < nheld; i++)
 	{
-		FdwXact		fdwxact = FdwXactCtl->fdwxacts[held_fdwxacts[i]];
+		FdwXact		fdwxact = held_fdwxacts[i];
 
+		/* The entry might have been resolved and reused by someone else */
 		LWLockAcquire(FdwXactLock, LW_EXCLUSIVE);
-		fdwxact->locking_backend = InvalidBackendId;
+		if (fdwxact->locking_backend == MyBackendId)
+			fdwxact->locking_backend = InvalidBackendId;
 		LWLockRelease(FdwXactLock);
 	}
 }
@@ -147,6 +150,7 @@ fdwxact_resolver_attach(int slot)
 	}
 
 	Assert(OidIsValid(MyFdwXactResolver->dbid));
+	Assert(OidIsValid(MyFdwXactResolver->serverid));
 
 	MyFdwXactResolver->pid = MyProcPid;
 	MyFdwXactResolver->latch = &MyProc->procLatch;
@@ -175,11 +179,12 @@ FdwXactResolverMain(Datum main_arg)
 
 	StartTransactionCommand();
 	ereport(LOG,
-			(errmsg("foreign transaction resolver for database \"%s\" has started",
-					get_database_name(MyFdwXactResolver->dbid))));
+			(errmsg("foreign transaction resolver for database \"%s\" and server %u has started",
+					get_database_name(MyFdwXactResolver->dbid),
+					MyFdwXactResolver->serverid)));
 	CommitTransactionCommand();
 
-	held_fdwxacts = palloc(sizeof(int) * max_prepared_foreign_xacts);
+	held_fdwxacts = palloc(sizeof(FdwXact) * max_prepared_foreign_xacts);
 	nheld = 0;
 
 	/* Initialize stats to a sanish value */
@@ -235,6 +240,9 @@ FXRslvLoop(void)
 			FdwXactResolveFdwXacts(held_fdwxacts, nheld);
 			CommitTransactionCommand();
 			last_resolution_time = now;
+
+			/* Send the distributed transaction statistics */
+			pgstat_report_stat(false);
 		}
 
 		FXRslvCheckTimeout(now);
@@ -275,8 +283,9 @@ FXRslvCheckTimeout(TimestampTz now)
 	/* Reached timeout, exit */
 	StartTransactionCommand();
 	ereport(LOG,
-			(errmsg("foreign transaction resolver for database \"%s\" will stop because the timeout",
-					get_database_name(MyDatabaseId))));
+			(errmsg("foreign transaction resolver for database \"%s\" and server %u will stop because the timeout",
+					get_database_name(MyDatabaseId),
+					MyFdwXactResolver->serverid)));
 	CommitTransactionCommand();
 	fdwxact_resolver_detach();
 	proc_exit(0);
@@ -329,7 +338,8 @@ IsFdwXactResolver(void)
 }
 
 /*
- * Lock foreign transactions that are not held by anyone.
+ * Lock foreign transactions on our database and server that are not held by
+ * anyone.
  */
 static void
 hold_indoubt_fdwxacts(void)
@@ -341,10 +351,12 @@ hold_indoubt_fdwxacts(void)
 		FdwXact		fdwxact = FdwXactCtl->fdwxacts[i];
 
 		if (fdwxact->valid &&
+			fdwxact->dbid == MyDatabaseId &&
+			fdwxact->serverid == MyFdwXactResolver->serverid &&
 			fdwxact->locking_backend == InvalidBackendId &&
 			!TwoPhaseExists(fdwxact->local_xid))
 		{
-			held_fdwxacts[nheld++] = i;
+			held_fdwxacts[nheld++] = fdwxact;
 			fdwxact->locking_backend = MyBackendId;
 		}
 	}
@@ -23,13 +23,27 @@ fdwxact_desc(StringInfo buf, XLogReaderState *record)
 
 	if (info == XLOG_FDWXACT_INSERT)
 	{
-		FdwXactOnDiskData *fdwxact_insert = (FdwXactOnDiskData *) rec;
+		xl_fdwxact_insert *xlrec = (xl_fdwxact_insert *) rec;
+		char	   *ptr = rec + SizeOfFdwXactInsert;
+		int			i;
 
-		appendStringInfo(buf, "server: %u,", fdwxact_insert->serverid);
-		appendStringInfo(buf, " user: %u,", fdwxact_insert->userid);
-		appendStringInfo(buf, " database: %u,", fdwxact_insert->dbid);
-		appendStringInfo(buf, " local xid: %u,", fdwxact_insert->local_xid);
-		appendStringInfo(buf, " id: %s", fdwxact_insert->fdwxact_id);
+		appendStringInfo(buf, "%d participants", xlrec->nentries);
+		for (i = 0; i < xlrec->nentries; i++)
+		{
+			FdwXactOnDiskData *fdwxact_insert = (FdwXactOnDiskData *) ptr;
+
+			appendStringInfo(buf, "; server: %u,", fdwxact_insert->serverid);
+			appendStringInfo(buf, " user: %u,", fdwxact_insert->userid);
+			appendStringInfo(buf, " database: %u,", fdwxact_insert->dbid);
+			appendStringInfo(buf, " local xid: %u,", fdwxact_insert->local_xid);
+			appendStringInfo(buf, " id: " FDWXACT_ID_FORMAT,
+							 fdwxact_insert->fxid.sysid,
+							 fdwxact_insert->fxid.xid,
+							 fdwxact_insert->fxid.index,
+							 fdwxact_insert->fxid.random);
+
+			ptr += FdwXactOnDiskDataSize(fdwxact_insert);
+		}
 	}
 	else
 	{
@@ -24,15 +24,18 @@
 #include "postgres.h"
 
 #include "access/csn_log.h"
+#include "access/csn_snapshot.h"
 #include "access/slru.h"
 #include "access/subtrans.h"
 #include "access/transam.h"
 #include "miscadmin.h"
 #include "pg_trace.h"
+#include "pgstat.h"
 #include "storage/shmem.h"
 #include "utils/snapmgr.h"
 
 bool enable_csn_snapshot;
+int csn_log_buffers = 0;
 
 /*
  * We use csnSnapshotActive to judge if csn snapshot enabled instead of by
@@ -71,10 +74,25 @@ CSNshapshotShared *csnShared;
 #define TransactionIdToPgIndex(xid) ((xid) % (TransactionId) CSN_LOG_XACTS_PER_PAGE)
 
 /*
- * Link to shared-memory data structures for CLOG control
+ * The CSNLog is split into banks, each of them a separate SLRU with its own
+ * buffers and control lock, so that backends looking up CSNs on different
+ * pages don't all contend for a single lock.  Page pageno is kept in bank
+ * pageno % csn_log_nbanks.  All banks share the pg_csn directory, so the
+ * pages of a segment are spread over all banks.
  */
-static SlruCtlData CSNLogCtlData;
-#define CsnlogCtl (&CSNLogCtlData)
+#define CSN_LOG_MAX_BANKS			16
+#define CSN_LOG_MIN_BANK_BUFFERS	16
+#define CSN_LOG_MAX_BANK_BUFFERS	(CSN_LOG_MAX_BUFFERS / CSN_LOG_MAX_BANKS)
+
+/*
+ * Link to shared-memory data structures for CSNLog control
+ */
+static SlruCtlData CSNLogCtlData[CSN_LOG_MAX_BANKS];
+static int	csn_log_nbanks;
+static LWLockPadded *CSNLogBankLocks;
+
+#define CsnlogBankCtl(pageno)	(&CSNLogCtlData[(pageno) % csn_log_nbanks])
+#define CsnlogCtl				(&CSNLogCtlData[0])
 
 static int	ZeroCSNLogPage(int pageno, bool write_xlog);
 static void ZeroTruncateCSNLogPage(int pageno, bool write_xlog);
@@ -82,7 +100,9 @@ static bool CSNLogPagePrecedes(int page1, int page2);
 static void CSNLogSetPageStatus(TransactionId xid, int nsubxids,
 									  TransactionId *subxids,
 									  CSN csn, int pageno);
-static void CSNLogSetCSNInSlot(TransactionId xid, CSN csn, int slotno);
+static void CSNLogSetCSNInSlot(SlruCtl ctl, TransactionId xid, CSN csn,
+							   int slotno);
+static void SetLatestCSNLogPage(int pageno);
 
 static void WriteCSNXlogRec(TransactionId xid, int nsubxids,
 							TransactionId *subxids, CSN csn);
@@ -152,41 +172,42 @@ CSNLogSetPageStatus(TransactionId xid, int nsubxids,
 						   TransactionId *subxids,
 						   CSN csn, int pageno)
 {
+	SlruCtl ctl = CsnlogBankCtl(pageno);
 	int slotno;
 	int i;
 
-	LWLockAcquire(CSNLogControlLock, LW_EXCLUSIVE);
+	LWLockAcquire(ctl->shared->ControlLock, LW_EXCLUSIVE);
 
-	slotno = SimpleLruReadPage(CsnlogCtl, pageno, true, xid);
+	slotno = SimpleLruReadPage(ctl, pageno, true, xid);
 
 	/* Subtransactions first, if needed ... */
 	for (i = 0; i < nsubxids; i++)
 	{
-		Assert(CsnlogCtl->shared->page_number[slotno] == TransactionIdToPage(subxids[i]));
-		CSNLogSetCSNInSlot(subxids[i],	csn, slotno);
+		Assert(ctl->shared->page_number[slotno] == TransactionIdToPage(subxids[i]));
+		CSNLogSetCSNInSlot(ctl, subxids[i],	csn, slotno);
 	}
 
 	/* ... then the main transaction */
 	if (TransactionIdIsValid(xid))
-		CSNLogSetCSNInSlot(xid, csn, slotno);
+		CSNLogSetCSNInSlot(ctl, xid, csn, slotno);
 
-	CsnlogCtl->shared->page_dirty[slotno] = true;
+	ctl->shared->page_dirty[slotno] = true;
 
-	LWLockRelease(CSNLogControlLock);
+	LWLockRelease(ctl->shared->ControlLock);
 }
 
 /*
  * Sets the commit status of a single transaction.
  */
 static void
-CSNLogSetCSNInSlot(TransactionId xid, CSN csn, int slotno)
+CSNLogSetCSNInSlot(SlruCtl ctl, TransactionId xid, CSN csn, int slotno)
 {
 	int entryno = TransactionIdToPgIndex(xid);
 	CSN *ptr;
 
-	Assert(LWLockHeldByMe(CSNLogControlLock));
+	Assert(LWLockHeldByMe(ctl->shared->ControlLock));
 
-	ptr = (CSN *) (CsnlogCtl->shared->page_buffer[slotno] +
+	ptr = (CSN *) (ctl->shared->page_buffer[slotno] +
 														entryno * sizeof(CSN));
 	*ptr = csn;
 }
@@ -203,34 +224,61 @@ CSNLogGetCSNByXid(TransactionId xid)
 {
 	int pageno = TransactionIdToPage(xid);
 	int entryno = TransactionIdToPgIndex(xid);
+	SlruCtl ctl = CsnlogBankCtl(pageno);
 	int slotno;
 	CSN csn;
 
 	/* lock is acquired by SimpleLruReadPage_ReadOnly */
-	slotno = SimpleLruReadPage_ReadOnly(CsnlogCtl, pageno, xid);
-	csn = *(CSN *) (CsnlogCtl->shared->page_buffer[slotno] +
+	slotno = SimpleLruReadPage_ReadOnly(ctl, pageno, xid);
+	csn = *(CSN *) (ctl->shared->page_buffer[slotno] +
 														entryno * sizeof(CSN));
-	LWLockRelease(CSNLogControlLock);
+	LWLockRelease(ctl->shared->ControlLock);
 
 	return csn;
 }
 
 /*
- * Number of shared CSNLog buffers.
+ * Number of shared CSNLog buffers, in total over all banks.
+ *
+ * Each xid takes 8 bytes, so a page covers only 1024 xids.  Unless set
+ * explicitly by csn_log_buffers, scale with shared_buffers.  Either way,
+ * stay within CSN_LOG_MAX_BANK_BUFFERS per bank.
  */
-static Size
+static int
 CSNLogShmemBuffers(void)
 {
-	return Min(32, Max(4, NBuffers / 512));
+	if (csn_log_buffers > 0)
+		return Min(CSN_LOG_MAX_BANKS * CSN_LOG_MAX_BANK_BUFFERS,
+				   Max(CSN_LOG_MIN_BANK_BUFFERS, csn_log_buffers));
+
+	return Min(512, Max(CSN_LOG_MIN_BANK_BUFFERS, NBuffers / 256));
+}
+
+/*
+ * Number of CSNLog banks.  Every bank gets at least CSN_LOG_MIN_BANK_BUFFERS
+ * buffers.
+ */
+static int
+CSNLogNumBanks(void)
+{
+	return Min(CSN_LOG_MAX_BANKS,
+			   CSNLogShmemBuffers() / CSN_LOG_MIN_BANK_BUFFERS);
 }
 
 /*
- * Reserve shared memory for CsnlogCtl.
+ * Reserve shared memory for the CSNLog banks.
  */
 Size
 CSNLogShmemSize(void)
 {
-	return SimpleLruShmemSize(CSNLogShmemBuffers(), 0);
+	int			nbanks = CSNLogNumBanks();
+	Size		size;
+
+	size = mul_size(nbanks,
+					SimpleLruShmemSize(CSNLogShmemBuffers() / nbanks, 0));
+	size = add_size(size, mul_size(nbanks, sizeof(LWLockPadded)));
+
+	return size;
 }
 
 /*
@@ -240,12 +288,37 @@ void
 CSNLogShmemInit(void)
 {
 	bool		found;
+	int			nbuffers = CSNLogShmemBuffers();
+	int			i;
+
+	csn_log_nbanks = CSNLogNumBanks();
+
+	CSNLogBankLocks = (LWLockPadded *)
+		ShmemInitStruct("CSNLog bank locks",
+						csn_log_nbanks * sizeof(LWLockPadded),
+						&found);
+	if (!found)
+	{
+		for (i = 0; i < csn_log_nbanks; i++)
+			LWLockInitialize(&CSNLogBankLocks[i].lock,
+							 LWTRANCHE_CSN_LOG_CONTROL);
+	}
+
+	for (i = 0; i < csn_log_nbanks; i++)
+	{
+		SlruCtl		ctl = &CSNLogCtlData[i];
+		char		name[SHMEM_INDEX_KEYSIZE];
 
+		snprintf(name, sizeof(name), "CSNLog Ctl %d", i);
+		ctl->PagePrecedes = CSNLogPagePrecedes;
+		SimpleLruInit(ctl, name, nbuffers / csn_log_nbanks, 0,
+					  &CSNLogBankLocks[i].lock, "pg_csn",
+					  LWTRANCHE_CSN_LOG_BUFFERS, SYNC_HANDLER_CSNLOG);
+
+		/* Report all banks as a single SLRU in pg_stat_slru */
+		ctl->shared->slru_stats_idx = pgstat_slru_index("CSNLog");
+	}
 
-	CsnlogCtl->PagePrecedes = CSNLogPagePrecedes;
-	SimpleLruInit(CsnlogCtl, "CSNLog Ctl", CSNLogShmemBuffers(), 0,
-				  CSNLogControlLock, "pg_csn", LWTRANCHE_CSN_LOG_BUFFERS,
-				  SYNC_HANDLER_CSNLOG);
 	csnShared = ShmemInitStruct("CSNlog shared",
 									 sizeof(CSNshapshotShared),
 									 &found);
@@ -273,18 +346,43 @@ BootStrapCSNLog(void)
 static int
 ZeroCSNLogPage(int pageno, bool write_xlog)
 {
-	Assert(LWLockHeldByMe(CSNLogControlLock));
+	Assert(LWLockHeldByMe(CsnlogBankCtl(pageno)->shared->ControlLock));
 	if(write_xlog)
 		WriteZeroCSNPageXlogRec(pageno);
-	return SimpleLruZeroPage(CsnlogCtl, pageno);
+	return SimpleLruZeroPage(CsnlogBankCtl(pageno), pageno);
+}
+
+/*
+ * SimpleLruZeroPage() only advances latest_page_number of the page's own
+ * bank, but SimpleLruTruncate() of every bank checks the cutoff page against
+ * it.  Keep it the same in all banks.
+ *
+ * Must be called without any bank lock held.
+ */
+static void
+SetLatestCSNLogPage(int pageno)
+{
+	int			i;
+
+	for (i = 0; i < csn_log_nbanks; i++)
+	{
+		SlruCtl		ctl = &CSNLogCtlData[i];
+
+		LWLockAcquire(ctl->shared->ControlLock, LW_EXCLUSIVE);
+		ctl->shared->latest_page_number = pageno;
+		LWLockRelease(ctl->shared->ControlLock);
+	}
 }
 
 static void
 ZeroTruncateCSNLogPage(int pageno, bool write_xlog)
 {
+	int			i;
+
 	if(write_xlog)
 		WriteTruncateCSNXlogRec(pageno);
-	SimpleLruTruncate(CsnlogCtl, pageno);
+	for (i = 0; i < csn_log_nbanks; i++)
+		SimpleLruTruncate(&CSNLogCtlData[i], pageno);
 }
 
 void
@@ -300,14 +398,17 @@ ActivateCSNlog(void)
 	startPage = TransactionIdToPage(nextXid);
 
 	/* Create the current segment file, if necessary */
-	if (!SimpleLruDoesPhysicalPageExist(CsnlogCtl, startPage))
+	if (!SimpleLruDoesPhysicalPageExist(CsnlogBankCtl(startPage), startPage))
 	{
+		SlruCtl		ctl = CsnlogBankCtl(startPage);
 		int			slotno;
-		LWLockAcquire(CSNLogControlLock, LW_EXCLUSIVE);
+
+		LWLockAcquire(ctl->shared->ControlLock, LW_EXCLUSIVE);
 		slotno = ZeroCSNLogPage(startPage, false);
-		SimpleLruWritePage(CsnlogCtl, slotno);
-		LWLockRelease(CSNLogControlLock);
+		SimpleLruWritePage(ctl, slotno);
+		LWLockRelease(ctl->shared->ControlLock);
 	}
+	SetLatestCSNLogPage(startPage);
 	csnShared->csnSnapshotActive = true;
 }
 
@@ -325,10 +426,21 @@ get_csnlog_status(void)
 void
 DeactivateCSNlog(void)
 {
+	int			i;
+
 	csnShared->csnSnapshotActive = false;
-	LWLockAcquire(CSNLogControlLock, LW_EXCLUSIVE);
+	CSNHintTruncate(InvalidTransactionId);
+
+	/*
+	 * The segment files hold pages of every bank, so keep all of them from
+	 * reading or writing pages while we remove the files.  Banks are always
+	 * locked in ascending order.
+	 */
+	for (i = 0; i < csn_log_nbanks; i++)
+		LWLockAcquire(CSNLogCtlData[i].shared->ControlLock, LW_EXCLUSIVE);
 	(void) SlruScanDirectory(CsnlogCtl, SlruScanDirCbDeleteAll, NULL);
-	LWLockRelease(CSNLogControlLock);
+	for (i = csn_log_nbanks - 1; i >= 0; i--)
+		LWLockRelease(CSNLogCtlData[i].shared->ControlLock);
 }
 
 void
@@ -373,6 +485,8 @@ CSNlogParameterChange(bool newvalue, bool oldvalue)
 void
 CheckPointCSNLog(void)
 {
+	int			i;
+
 	if (!get_csnlog_status())
 		return;
 
@@ -384,7 +498,8 @@ CheckPointCSNLog(void)
 	 * the checkpoint process and not by backends.
 	 */
 	TRACE_POSTGRESQL_CSNLOG_CHECKPOINT_START(true);
-	SimpleLruWriteAll(CsnlogCtl, true);
+	for (i = 0; i < csn_log_nbanks; i++)
+		SimpleLruWriteAll(&CSNLogCtlData[i], true);
 	TRACE_POSTGRESQL_CSNLOG_CHECKPOINT_DONE(true);
 }
 
@@ -414,12 +529,14 @@ ExtendCSNLog(TransactionId newestXact)
 
 	pageno = TransactionIdToPage(newestXact);
 
-	LWLockAcquire(CSNLogControlLock, LW_EXCLUSIVE);
+	LWLockAcquire(CsnlogBankCtl(pageno)->shared->ControlLock, LW_EXCLUSIVE);
 
 	/* Zero the page and make an XLOG entry about it */
 	ZeroCSNLogPage(pageno, !InRecovery);
 
-	LWLockRelease(CSNLogControlLock);
+	LWLockRelease(CsnlogBankCtl(pageno)->shared->ControlLock);
+
+	SetLatestCSNLogPage(pageno);
 }
 
 /*
@@ -448,6 +565,8 @@ TruncateCSNLog(TransactionId oldestXact)
 	TransactionIdRetreat(oldestXact);
 	cutoffPage = TransactionIdToPage(oldestXact);
 	ZeroTruncateCSNLogPage(cutoffPage, true);
+
+	CSNHintTruncate(oldestXact);
 }
 
 /*
@@ -493,14 +612,16 @@ WriteAssignCSNXlogRec(CSN csn)
 
 	/*
 	 * We log the CSN 5s greater than generated, you can see comments on
-	 * CSN_ASSIGN_TIME_INTERVAL define.
+	 * CSN_ASSIGN_TIME_INTERVAL define.  Only advertise the new limit once the
+	 * record is inserted, GenerateCSN() relies on it being covered by WAL.
 	 */
 	log_csn = CSNAddByNanosec(csn, CSN_ASSIGN_TIME_INTERVAL);
-	set_last_log_wal_csn(log_csn);
 
 	XLogBeginInsert();
 	XLogRegisterData((char *) (&log_csn), sizeof(CSN));
 	XLogInsert(RM_CSNLOG_ID, XLOG_CSN_ASSIGNMENT);
+
+	set_last_log_wal_csn(log_csn);
 }
 
 static void
@@ -555,35 +676,45 @@ csnlog_redo(XLogReaderState *record)
 		CSN csn;
 
 		memcpy(&csn, XLogRecGetData(record), sizeof(CSN));
-		LWLockAcquire(CSNLogControlLock, LW_EXCLUSIVE);
 		set_last_max_csn(csn);
-		LWLockRelease(CSNLogControlLock);
-
+		set_last_log_wal_csn(csn);
 	}
 	else if (info == XLOG_CSN_SETCSN)
 	{
 		xl_csn_set *xlrec = (xl_csn_set *) XLogRecGetData(record);
 		CSNLogSetCSN(xlrec->xtop, xlrec->nsubxacts, xlrec->xsub, xlrec->csn, false);
+
+		/*
+		 * A locally generated commit CSN can be ahead of the last CSN
+		 * assignment record, since GenerateCSN() leaves reserving CSNs in
+		 * WAL to the walwriter.  Make sure CSNs generated after recovery
+		 * are above it even if the clock went backwards meanwhile.
+		 */
+		if (CSNIsNormal(xlrec->csn))
+			set_last_max_csn(xlrec->csn);
 	}
 	else if (info == XLOG_CSN_ZEROPAGE)
 	{
 		int			pageno;
 		int			slotno;
+		SlruCtl		ctl;
 
 		memcpy(&pageno, XLogRecGetData(record), sizeof(int));
-		LWLockAcquire(CSNLogControlLock, LW_EXCLUSIVE);
+		ctl = CsnlogBankCtl(pageno);
+		LWLockAcquire(ctl->shared->ControlLock, LW_EXCLUSIVE);
 		slotno = ZeroCSNLogPage(pageno, false);
-		SimpleLruWritePage(CsnlogCtl, slotno);
-		LWLockRelease(CSNLogControlLock);
-		Assert(!CsnlogCtl->shared->page_dirty[slotno]);
+		SimpleLruWritePage(ctl, slotno);
+		LWLockRelease(ctl->shared->ControlLock);
+		Assert(!ctl->shared->page_dirty[slotno]);
 
+		SetLatestCSNLogPage(pageno);
 	}
 	else if (info == XLOG_CSN_TRUNCATE)
 	{
 		int			pageno;
 
 		memcpy(&pageno, XLogRecGetData(record), sizeof(int));
-		CsnlogCtl->shared->latest_page_number = pageno;
+		SetLatestCSNLogPage(pageno);
 		ZeroTruncateCSNLogPage(pageno, false);
 	}
 	else
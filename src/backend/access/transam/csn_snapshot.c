@@ -17,7 +17,11 @@
 #include "access/transam.h"
 #include "access/twophase.h"
 #include "access/xact.h"
+#include "access/xlog.h"
+#include "funcapi.h"
+#include "pgstat.h"
 #include "portability/instr_time.h"
+#include "storage/latch.h"
 #include "storage/lmgr.h"
 #include "storage/proc.h"
 #include "storage/procarray.h"
@@ -25,6 +29,7 @@
 #include "storage/spin.h"
 #include "utils/builtins.h"
 #include "utils/guc.h"
+#include "utils/memutils.h"
 #include "utils/snapmgr.h"
 #include "miscadmin.h"
 
@@ -43,9 +48,12 @@ TransactionId 	 xmin_for_csn = InvalidTransactionId;
 typedef struct
 {
 	CSN_atomic		 last_max_csn;		/* Record the max csn till now */
-	CSN			 last_csn_log_wal;	/* for interval we log the assign csn to wal */
+	CSN_atomic		 last_csn_log_wal;	/* CSNs up to this are covered by WAL */
+	pg_atomic_uint64 sync_waits;		/* # of CSNSnapshotSync() waits */
+	pg_atomic_uint64 sync_wait_time;	/* total time waited, in usec */
+	pg_atomic_uint64 sync_max_skew;		/* largest skew waited for, in nsec */
 	TransactionId 	 xmin_for_csn; 		/*'xmin_for_csn' for when turn xid-snapshot to csn-snapshot*/
-	volatile slock_t lock;
+	volatile slock_t lock;				/* protects xmin_for_csn */
 } CSNSnapshotState;
 
 static CSNSnapshotState *csnState;
@@ -108,6 +116,75 @@ CSNSnapshotXidMap;
 static CSNSnapshotXidMap *csnXidMap;
 
 
+/*
+ * Backend-local cache of xid -> CSN mappings.
+ *
+ * Once a normal or aborted CSN is set in CSNLog for an xid, it never changes,
+ * so TransactionIdGetCSN() remembers it and doesn't need to go to the SLRU
+ * (and its bank lock) the next time a tuple of the same transaction is
+ * checked.  Much like cachedFetchXid in transam.c, but with many entries,
+ * direct-mapped by xid.
+ *
+ * Cached values are only valid until the xid gets reused after wraparound,
+ * so the whole cache is dropped whenever TransactionXmin has moved more than
+ * CSN_CACHE_MAX_AGE away from where it was when the cache was last reset.
+ */
+#define CSN_CACHE_SIZE		4096	/* must be a power of 2 */
+#define CSN_CACHE_MAX_AGE	(1U << 30)
+
+typedef struct CSNCacheEntry
+{
+	TransactionId	 xid;
+	CSN				 csn;
+} CSNCacheEntry;
+
+static CSNCacheEntry *csnCache = NULL;
+static TransactionId csnCacheXmin = InvalidTransactionId;
+static uint64 csnCacheHits = 0;
+static uint64 csnCacheHintHits = 0;
+static uint64 csnCacheMisses = 0;
+
+static CSNCacheEntry *CSNCacheGetEntry(TransactionId xid);
+static SnapshotCSN GenerateCSNInternal(CSN assign, int n);
+
+
+/*
+ * CSN hints.
+ *
+ * Heap tuples only carry commit/abort hint bits, so every visibility check
+ * under an imported csn snapshot has to find the commit CSN elsewhere.  On
+ * top of the backend-local cache above, final CSNs are shared through a
+ * direct-mapped table in shared memory of csn_hint_cache_size entries.  Much
+ * like SetHintBits(), entries are written opportunistically, without any
+ * lock, whenever TransactionIdGetCSN() had to read CSNLog, and an update
+ * that loses a race is simply dropped.
+ *
+ * Each slot is protected by a sequence counter, which is odd while the slot
+ * is being written.  A writer claims the slot by advancing an even counter by
+ * compare-and-exchange, stores the xid and CSN and advances the counter once
+ * more.  A reader accepts the entry only if it saw the same even counter
+ * before and after reading it, so that it can't combine the xid and CSN of
+ * different writes, even if the slot went back to the same xid meanwhile.
+ *
+ * Entries must not outlive xid wraparound, so TruncateCSNLog() drops the ones
+ * that precede the new oldest xid, and the whole table is emptied when CSN
+ * snapshots are turned off.
+ */
+typedef struct CSNHintEntry
+{
+	pg_atomic_uint32 seq;		/* odd while the entry is being written */
+	pg_atomic_uint32 xid;
+	pg_atomic_uint64 csn;
+} CSNHintEntry;
+
+int csn_hint_cache_size = 0;
+
+static CSNHintEntry *csnHints;
+
+static bool CSNHintGet(TransactionId xid, CSN *csn);
+static void CSNHintSet(TransactionId xid, CSN csn);
+
+
 /* Estimate shared memory space needed */
 Size
 CSNSnapshotShmemSize(void)
@@ -123,6 +200,10 @@ CSNSnapshotShmemSize(void)
 		size = MAXALIGN(size);
 	}
 
+	if (csn_hint_cache_size > 0)
+		size = add_size(size, mul_size(csn_hint_cache_size,
+									   sizeof(CSNHintEntry)));
+
 	return size;
 }
 
@@ -139,8 +220,11 @@ CSNSnapshotShmemInit()
 								&found);
 		if (!found)
 		{
-			pg_atomic_write_u64(&csnState->last_max_csn, 0);
-			csnState->last_csn_log_wal = 0;
+			pg_atomic_init_u64(&csnState->last_max_csn, 0);
+			pg_atomic_init_u64(&csnState->last_csn_log_wal, 0);
+			pg_atomic_init_u64(&csnState->sync_waits, 0);
+			pg_atomic_init_u64(&csnState->sync_wait_time, 0);
+			pg_atomic_init_u64(&csnState->sync_max_skew, 0);
 			csnState->xmin_for_csn = InvalidTransactionId;
 			SpinLockInit(&csnState->lock);
 		}
@@ -165,6 +249,24 @@ CSNSnapshotShmemInit()
 				csnXidMap->xmin_by_second[i] = InvalidTransactionId;
 		}
 	}
+
+	if (csn_hint_cache_size > 0)
+	{
+		csnHints = ShmemInitStruct("csnHints",
+								   csn_hint_cache_size * sizeof(CSNHintEntry),
+								   &found);
+		if (!found)
+		{
+			int i;
+
+			for (i = 0; i < csn_hint_cache_size; i++)
+			{
+				pg_atomic_init_u32(&csnHints[i].seq, 0);
+				pg_atomic_init_u32(&csnHints[i].xid, InvalidTransactionId);
+				pg_atomic_init_u64(&csnHints[i].csn, InProgressCSN);
+			}
+		}
+	}
 }
 
 /*
@@ -369,12 +471,47 @@ CSNSnapshotToXmin(SnapshotCSN snapshot_csn)
  * this time to be always increasing. Since now it is not uncommon to have
  * millions of read transactions per second we are trying to use nanoseconds
  * if such time resolution is available.
+ *
+ * This is called from GetSnapshotData() under ProcArrayLock, so we don't take
+ * any lock here.  Instead last_max_csn is advanced by compare-and-exchange,
+ * which keeps the returned values strictly increasing among all backends.
+ *
+ * Nor do we write WAL here.  The walwriter logs CSN assignment records ahead
+ * of the CSNs we hand out, see CSNSnapshotReserveCSNs().
+ */
+SnapshotCSN
+GenerateCSN(CSN assign)
+{
+	return GenerateCSNInternal(assign, 1);
+}
+
+/*
+ * GenerateCSNRange
+ *
+ * Reserve n consecutive CSNs in one step and return the first of them.  Used
+ * by group commit, where the leader assigns CSNs on behalf of the whole group
+ * while holding ProcArrayLock, so that the clock is read and last_max_csn is
+ * advanced only once per group.
  */
 SnapshotCSN
-GenerateCSN(bool locked, CSN assign)
+GenerateCSNRange(int n)
+{
+	Assert(n > 0);
+
+	return GenerateCSNInternal(InvalidCSN, n);
+}
+
+/*
+ * Workhorse of GenerateCSN() and GenerateCSNRange(): reserve n CSNs starting
+ * at the current time, or at assign if that's later, and return the first.
+ */
+static SnapshotCSN
+GenerateCSNInternal(CSN assign, int n)
 {
 	instr_time	current_time;
 	SnapshotCSN	csn;
+	SnapshotCSN	last_max_csn;
+	SnapshotCSN	new_max_csn;
 
 	Assert(get_csnlog_status() || csn_snapshot_defer_time > 0);
 
@@ -400,22 +537,83 @@ GenerateCSN(bool locked, CSN assign)
 		csn = assign;
 	}
 
-	/* TODO: change to atomics? */
-	if (!locked)
-		SpinLockAcquire(&csnState->lock);
-
-	if (csn <= pg_atomic_read_u64(&csnState->last_max_csn))
-		csn = pg_atomic_add_fetch_u64(&csnState->last_max_csn, 1);
-	set_last_max_csn(csn);
+	/*
+	 * Start at our value, or at the previous maximum plus one if the clock
+	 * didn't advance past it, and install the end of our range as the new
+	 * maximum.  On failure the compare-exchange updates last_max_csn with the
+	 * current value, so just retry.
+	 */
+	last_max_csn = pg_atomic_read_u64(&csnState->last_max_csn);
+	for (;;)
+	{
+		SnapshotCSN	new_csn = (csn > last_max_csn) ? csn : last_max_csn + 1;
 
-	if (!locked)
-		SpinLockRelease(&csnState->lock);
+		new_max_csn = new_csn + n - 1;
+		if (pg_atomic_compare_exchange_u64(&csnState->last_max_csn,
+										   &last_max_csn, new_max_csn))
+		{
+			csn = new_csn;
+			break;
+		}
+	}
 
-	WriteAssignCSNXlogRec(csn);
+	/*
+	 * If we ran past the range reserved in WAL, ask the walwriter to reserve
+	 * more.  A CSN assigned by a remote node can be arbitrarily far ahead of
+	 * our clock, but that only happens on commit, which writes WAL anyway, so
+	 * log it right away.  Same without a walwriter, in single-user mode.
+	 *
+	 * A commit can thus store a CSN that is not yet covered by an assignment
+	 * record.  That's fine, since its XLOG_CSN_SETCSN record carries the CSN
+	 * and redo raises last_max_csn past it.
+	 */
+	if (unlikely(new_max_csn > pg_atomic_read_u64(&csnState->last_csn_log_wal)))
+	{
+		if (assign != InvalidCSN || !IsUnderPostmaster)
+			WriteAssignCSNXlogRec(new_max_csn);
+		else if (ProcGlobal->walwriterLatch)
+			SetLatch(ProcGlobal->walwriterLatch);
+	}
 
 	return csn;
 }
 
+/*
+ * CSNSnapshotReserveCSNs
+ *
+ * Called periodically by the walwriter.  Once the CSNs handed out by
+ * GenerateCSN() come within half of CSN_ASSIGN_TIME_INTERVAL of the range
+ * covered by WAL, log a new CSN assignment record covering the next interval.
+ * Nothing is logged while no CSNs are being generated, so an idle server
+ * stays idle.
+ *
+ * Returns true if a record was logged.
+ */
+bool
+CSNSnapshotReserveCSNs(void)
+{
+	instr_time	current_time;
+	SnapshotCSN	csn;
+	SnapshotCSN	last_max_csn;
+
+	if (!get_csnlog_status() && csn_snapshot_defer_time <= 0)
+		return false;
+
+	if (RecoveryInProgress())
+		return false;
+
+	last_max_csn = pg_atomic_read_u64(&csnState->last_max_csn);
+	if (CSNAddByNanosec(last_max_csn, CSN_ASSIGN_TIME_INTERVAL / 2) <=
+		pg_atomic_read_u64(&csnState->last_csn_log_wal))
+		return false;
+
+	INSTR_TIME_SET_CURRENT(current_time);
+	csn = (SnapshotCSN) INSTR_TIME_GET_NANOSEC(current_time);
+	WriteAssignCSNXlogRec(Max(csn, last_max_csn));
+
+	return true;
+}
+
 /*
  * CSNSnapshotPrepareCurrent
  *
@@ -443,7 +641,7 @@ CSNSnapshotPrepareCurrent(void)
 
 	/* Nothing to write if we don't have xid */
 
-	return GenerateCSN(false, InvalidCSN);
+	return GenerateCSN(InvalidCSN);
 }
 
 
@@ -477,7 +675,7 @@ CSNSnapshotAssignCurrent(SnapshotCSN snapshot_csn)
 	/* We do not care the Generate result, we just want to make sure max
 	 * csnState->last_max_csn value.
 	 */
-	GenerateCSN(false, snapshot_csn);
+	GenerateCSN(snapshot_csn);
 	/* Set csn and defuse ProcArrayEndTransaction from assigning one */
 	pg_atomic_write_u64(&MyProc->assignedCSN, snapshot_csn);
 }
@@ -491,53 +689,105 @@ CSNSnapshotAssignCurrent(SnapshotCSN snapshot_csn)
  *
  * This should happend relatively rare if nodes have running NTP/PTP/etc.
  * Complain if wait time is more than SNAP_SYNC_COMPLAIN.
+ *
+ * We sleep on our latch for the whole skew at once, rounded up to whole
+ * milliseconds, so the wait can be interrupted and shows up as the
+ * CsnSnapshotSync wait event.  Waits are counted in csnState, see
+ * pg_stat_csn_sync.
  */
 void
 CSNSnapshotSync(SnapshotCSN remote_csn)
 {
 	SnapshotCSN	local_csn;
 	SnapshotCSN	delta;
+	instr_time	start_time;
+	instr_time	wait_time;
+	bool		waited = false;
 
 	Assert(enable_csn_snapshot);
 
 	for(;;)
 	{
-		SpinLockAcquire(&csnState->lock);
 		if (pg_atomic_read_u64(&csnState->last_max_csn) > remote_csn)
 		{
 			/* Everything is fine */
-			SpinLockRelease(&csnState->lock);
-			return;
+			break;
 		}
-		else if ((local_csn = GenerateCSN(true, InvalidCSN)) >= remote_csn)
+		else if ((local_csn = GenerateCSN(InvalidCSN)) >= remote_csn)
 		{
 			/*
 			 * Everything is fine too, but last_max_csn wasn't updated for
 			 * some time.
 			 */
-			SpinLockRelease(&csnState->lock);
-			return;
+			break;
 		}
-		SpinLockRelease(&csnState->lock);
 
 		/* Okay we need to sleep now */
 		delta = remote_csn - local_csn;
-		if (delta > SNAP_DESYNC_COMPLAIN)
-			ereport(WARNING,
-				(errmsg("remote global snapshot exceeds ours by more than a second"),
-				 errhint("Consider running NTPd on servers participating in global transaction")));
+		if (!waited)
+		{
+			uint64		max_skew;
+
+			if (delta > SNAP_DESYNC_COMPLAIN)
+				ereport(WARNING,
+					(errmsg("remote global snapshot exceeds ours by more than a second"),
+					 errhint("Consider running NTPd on servers participating in global transaction")));
+
+			max_skew = pg_atomic_read_u64(&csnState->sync_max_skew);
+			while (max_skew < delta)
+			{
+				if (pg_atomic_compare_exchange_u64(&csnState->sync_max_skew,
+												   &max_skew, delta))
+					break;
+			}
+
+			INSTR_TIME_SET_CURRENT(start_time);
+			waited = true;
+		}
 
-		/* TODO: report this sleeptime somewhere? */
-		pg_usleep((long) (delta/NSECS_PER_USEC));
+		(void) WaitLatch(MyLatch,
+						 WL_LATCH_SET | WL_TIMEOUT | WL_EXIT_ON_PM_DEATH,
+						 (long) ((delta + NSECS_PER_SEC / 1000 - 1) /
+								 (NSECS_PER_SEC / 1000)),
+						 WAIT_EVENT_CSN_SNAPSHOT_SYNC);
+		ResetLatch(MyLatch);
+		CHECK_FOR_INTERRUPTS();
+	}
 
-		/*
-		 * Loop that checks to ensure that we actually slept for specified
-		 * amount of time.
-		 */
+	if (waited)
+	{
+		INSTR_TIME_SET_CURRENT(wait_time);
+		INSTR_TIME_SUBTRACT(wait_time, start_time);
+		pg_atomic_fetch_add_u64(&csnState->sync_waits, 1);
+		pg_atomic_fetch_add_u64(&csnState->sync_wait_time,
+								INSTR_TIME_GET_MICROSEC(wait_time));
 	}
+}
+
+/*
+ * pg_stat_get_csn_sync
+ *
+ * Report how often and how long CSNSnapshotSync() had to wait for the local
+ * clock to catch up with imported snapshots.
+ */
+Datum
+pg_stat_get_csn_sync(PG_FUNCTION_ARGS)
+{
+	TupleDesc	tupdesc;
+	Datum		values[3];
+	bool		nulls[3];
 
-	Assert(false); /* Should not happend */
-	return;
+	if (get_call_result_type(fcinfo, NULL, &tupdesc) != TYPEFUNC_COMPOSITE)
+		elog(ERROR, "return type must be a row type");
+
+	values[0] = Int64GetDatum((int64) pg_atomic_read_u64(&csnState->sync_waits));
+	/* convert to msec, like pg_stat_bgwriter does */
+	values[1] = Float8GetDatum(pg_atomic_read_u64(&csnState->sync_wait_time) / 1000.0);
+	values[2] = Float8GetDatum(pg_atomic_read_u64(&csnState->sync_max_skew) /
+							   (double) (NSECS_PER_SEC / 1000));
+	memset(nulls, 0, sizeof(nulls));
+
+	PG_RETURN_DATUM(HeapTupleGetDatum(heap_form_tuple(tupdesc, values, nulls)));
 }
 
 /*
@@ -550,6 +800,7 @@ CSN
 TransactionIdGetCSN(TransactionId xid)
 {
 	CSN csn;
+	CSNCacheEntry *entry;
 
 	Assert(get_csnlog_status());
 
@@ -601,6 +852,24 @@ TransactionIdGetCSN(TransactionId xid)
 	if (TransactionIdPrecedes(xid, xmin_for_csn))
 		return FrozenCSN;
 
+	/* Check the backend-local cache before going to SLRU */
+	entry = CSNCacheGetEntry(xid);
+	if (entry->xid == xid)
+	{
+		csnCacheHits++;
+		return entry->csn;
+	}
+
+	/* Then the CSN hints shared by all backends */
+	if (CSNHintGet(xid, &csn))
+	{
+		csnCacheHintHits++;
+		entry->xid = xid;
+		entry->csn = csn;
+		return csn;
+	}
+	csnCacheMisses++;
+
 	/* Read CSN from SLRU */
 	csn = CSNLogGetCSNByXid(xid);
 	/*
@@ -618,9 +887,186 @@ TransactionIdGetCSN(TransactionId xid)
 
 	Assert(CSNIsNormal(csn) || CSNIsInProgress(csn) || CSNIsAborted(csn));
 
+	/* Only final states can be cached */
+	if (CSNIsNormal(csn) || CSNIsAborted(csn))
+	{
+		entry->xid = xid;
+		entry->csn = csn;
+		CSNHintSet(xid, csn);
+	}
+
 	return csn;
 }
 
+/*
+ * CSNHintGet
+ *
+ * Look up xid in the CSN hints.  Returns true and sets *csn on success.
+ */
+static bool
+CSNHintGet(TransactionId xid, CSN *csn)
+{
+	CSNHintEntry *hint;
+	uint32		seq;
+
+	if (csn_hint_cache_size <= 0)
+		return false;
+
+	hint = &csnHints[xid % csn_hint_cache_size];
+
+	seq = pg_atomic_read_u32(&hint->seq);
+	if (seq & 1)
+		return false;
+	pg_read_barrier();
+	if (pg_atomic_read_u32(&hint->xid) != xid)
+		return false;
+	*csn = pg_atomic_read_u64(&hint->csn);
+	pg_read_barrier();
+
+	/* Make sure nobody rewrote the entry while we were reading it */
+	return pg_atomic_read_u32(&hint->seq) == seq;
+}
+
+/*
+ * Claim a CSN hint slot for writing, if nobody else is writing it.  On
+ * success, returns true and sets *seq to the odd counter value, to be passed
+ * to CSNHintRelease().
+ */
+static inline bool
+CSNHintAcquire(CSNHintEntry *hint, uint32 *seq)
+{
+	uint32		old_seq = pg_atomic_read_u32(&hint->seq);
+
+	if (old_seq & 1)
+		return false;
+	if (!pg_atomic_compare_exchange_u32(&hint->seq, &old_seq, old_seq + 1))
+		return false;
+
+	*seq = old_seq + 1;
+	return true;
+}
+
+static inline void
+CSNHintRelease(CSNHintEntry *hint, uint32 seq)
+{
+	pg_write_barrier();
+	pg_atomic_write_u32(&hint->seq, seq + 1);
+}
+
+/*
+ * CSNHintSet
+ *
+ * Remember the final CSN of xid in the CSN hints, unless someone else is
+ * updating the same slot right now.
+ */
+static void
+CSNHintSet(TransactionId xid, CSN csn)
+{
+	CSNHintEntry *hint;
+	uint32		seq;
+
+	if (csn_hint_cache_size <= 0)
+		return;
+
+	Assert(TransactionIdIsNormal(xid));
+
+	hint = &csnHints[xid % csn_hint_cache_size];
+
+	if (pg_atomic_read_u32(&hint->xid) == xid)
+		return;
+	if (!CSNHintAcquire(hint, &seq))
+		return;
+
+	pg_atomic_write_u32(&hint->xid, xid);
+	pg_atomic_write_u64(&hint->csn, csn);
+	CSNHintRelease(hint, seq);
+}
+
+/*
+ * CSNHintTruncate
+ *
+ * Forget the CSN hints of xids preceding oldestXact, so that they can't be
+ * mistaken for later xids with the same value after wraparound.  Pass
+ * InvalidTransactionId to forget all of them.
+ */
+void
+CSNHintTruncate(TransactionId oldestXact)
+{
+	int			i;
+
+	for (i = 0; i < csn_hint_cache_size; i++)
+	{
+		CSNHintEntry *hint = &csnHints[i];
+		uint32		old_xid = pg_atomic_read_u32(&hint->xid);
+		uint32		seq;
+
+		if (!TransactionIdIsNormal(old_xid))
+			continue;
+
+		if (TransactionIdIsValid(oldestXact) &&
+			!TransactionIdPrecedes(old_xid, oldestXact))
+			continue;
+
+		/*
+		 * If somebody is writing the slot right now, it's getting a recent
+		 * xid, so leave it alone.  Likewise if the xid changed before we
+		 * got hold of the slot.
+		 */
+		if (!CSNHintAcquire(hint, &seq))
+			continue;
+		if (pg_atomic_read_u32(&hint->xid) == old_xid)
+			pg_atomic_write_u32(&hint->xid, InvalidTransactionId);
+		CSNHintRelease(hint, seq);
+	}
+}
+
+/*
+ * CSNCacheGetEntry
+ *
+ * Return the cache slot for xid, allocating or resetting the cache as
+ * needed.  The caller must check whether the slot actually holds xid.
+ */
+static CSNCacheEntry *
+CSNCacheGetEntry(TransactionId xid)
+{
+	if (unlikely(csnCache == NULL))
+		csnCache = MemoryContextAlloc(TopMemoryContext,
+									  CSN_CACHE_SIZE * sizeof(CSNCacheEntry));
+	else if (likely(TransactionIdIsValid(csnCacheXmin) &&
+					TransactionXmin - csnCacheXmin <= CSN_CACHE_MAX_AGE))
+		return &csnCache[xid & (CSN_CACHE_SIZE - 1)];
+
+	/* InvalidTransactionId is zero, so this empties all slots */
+	memset(csnCache, 0, CSN_CACHE_SIZE * sizeof(CSNCacheEntry));
+	csnCacheXmin = TransactionXmin;
+
+	return &csnCache[xid & (CSN_CACHE_SIZE - 1)];
+}
+
+/*
+ * pg_csn_snapshot_cache_stats
+ *
+ * Report hits and misses of the xid -> CSN cache of the current backend,
+ * along with the hits in the shared CSN hints.
+ */
+Datum
+pg_csn_snapshot_cache_stats(PG_FUNCTION_ARGS)
+{
+	TupleDesc	tupdesc;
+	Datum		values[3];
+	bool		nulls[3];
+
+	if (get_call_result_type(fcinfo, NULL, &tupdesc) != TYPEFUNC_COMPOSITE)
+		elog(ERROR, "return type must be a row type");
+
+	values[0] = Int64GetDatum((int64) csnCacheHits);
+	values[1] = Int64GetDatum((int64) csnCacheHintHits);
+	values[2] = Int64GetDatum((int64) csnCacheMisses);
+	memset(nulls, 0, sizeof(nulls));
+
+	PG_RETURN_DATUM(HeapTupleGetDatum(heap_form_tuple(tupdesc, values, nulls)));
+}
+
 /*
  * XidInvisibleInCSNSnapshot
  *
@@ -790,26 +1236,47 @@ CSNSnapshotCommit(PGPROC *proc, TransactionId xid,
 	pg_atomic_write_u64(&proc->assignedCSN, InProgressCSN);
 }
 
+/*
+ * Advance the maximum CSN handed out so far.  Called during redo, where both
+ * CSN assignment records and the CSNs of replayed commits raise it, so never
+ * move it backwards.
+ */
 void
 set_last_max_csn(CSN csn)
 {
-	pg_atomic_write_u64(&csnState->last_max_csn, csn);
+	CSN			 last_max_csn;
+
+	last_max_csn = pg_atomic_read_u64(&csnState->last_max_csn);
+	while (last_max_csn < csn)
+	{
+		if (pg_atomic_compare_exchange_u64(&csnState->last_max_csn,
+										   &last_max_csn, csn))
+			break;
+	}
 }
 
+/*
+ * Advance the WAL-covered CSN.  Several processes may log CSN assignment
+ * records concurrently, so never move it backwards.
+ */
 void
 set_last_log_wal_csn(CSN csn)
 {
-	csnState->last_csn_log_wal = csn;
+	CSN			 last_csn_log_wal;
+
+	last_csn_log_wal = pg_atomic_read_u64(&csnState->last_csn_log_wal);
+	while (last_csn_log_wal < csn)
+	{
+		if (pg_atomic_compare_exchange_u64(&csnState->last_csn_log_wal,
+										   &last_csn_log_wal, csn))
+			break;
+	}
 }
 
 CSN
 get_last_log_wal_csn(void)
 {
-	CSN			 last_csn_log_wal;
-
-	last_csn_log_wal = csnState->last_csn_log_wal;
-
-	return last_csn_log_wal;
+	return pg_atomic_read_u64(&csnState->last_csn_log_wal);
 }
 
 /*
@@ -2322,7 +2322,7 @@ RecordTransactionCommitPrepared(TransactionId xid,
 	 * notify a resolver process to handle it.
 	 */
 	if (FdwXactExistsXid(xid))
-		FdwXactLaunchOrWakeupResolver();
+		FdwXactLaunchOrWakeupResolver(InvalidOid);
 }
 
 /*
@@ -2388,7 +2388,7 @@ RecordTransactionAbortPrepared(TransactionId xid,
 	 * notify a resolver process to handle it.
 	 */
 	if (FdwXactExistsXid(xid))
-		FdwXactLaunchOrWakeupResolver();
+		FdwXactLaunchOrWakeupResolver(InvalidOid);
 }
 
 /*
@@ -2553,7 +2553,7 @@ CSNSnapshotPrepareTwophase(const char *gid)
 
 	pfree(buf);
 
-	return GenerateCSN(false, InvalidCSN);
+	return GenerateCSN(InvalidCSN);
 }
 
 /*
@@ -2566,7 +2566,7 @@ CSNSnapshotPrepareTwophase(const char *gid)
  * This function is a counterpart of CSNSnapshotAssignCurrent() for
  * twophase transactions.
  */
-static void
+void
 CSNSnapshotAssignTwoPhase(const char *gid, SnapshotCSN csn)
 {
 	GlobalTransaction gxact;
@@ -2595,7 +2595,7 @@ CSNSnapshotAssignTwoPhase(const char *gid, SnapshotCSN csn)
 	/* We do not care the Generate result, we just want to make sure max
 	 * csnState->last_max_csn value.
 	 */
-	GenerateCSN(false, csn);
+	GenerateCSN(csn);
 	/* Set snapshot_csn and defuse ProcArrayRemove from assigning one. */
 	pg_atomic_write_u64(&proc->assignedCSN, csn);
 
@@ -2622,7 +2622,8 @@ pg_csn_snapshot_prepare(PG_FUNCTION_ARGS)
 /*
  * SQL interface to CSNSnapshotAssignTwoPhase()
  *
- * TODO: Rewrite this as COMMIT PREPARED 'gid' SNAPSHOT 'csn'
+ * COMMIT PREPARED 'gid' WITH CSN csn does the same and commits the
+ * transaction in a single command.
  */
 Datum
 pg_csn_snapshot_assign(PG_FUNCTION_ARGS)
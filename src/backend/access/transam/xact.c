@@ -23,7 +23,6 @@
 #include "access/commit_ts.h"
 #include "access/csn_snapshot.h"
 #include "access/fdwxact.h"
-#include "access/fdwxact_launcher.h"
 #include "access/multixact.h"
 #include "access/parallel.h"
 #include "access/subtrans.h"
@@ -1458,9 +1457,6 @@ RecordTransactionCommit(void)
 	if (wrote_xlog && markXidCommitted)
 		SyncRepWaitForLSN(XactLastRecEnd, true);
 
-	if (FdwXactIsForeignTwophaseCommitRequired())
-		FdwXactLaunchOrWakeupResolver();
-
 	/* remember end of last commit record */
 	XactLastCommitEnd = XactLastRecEnd;
 
@@ -1946,6 +1942,13 @@ StartTransaction(void)
 	/* check the current transaction state */
 	Assert(s->state == TRANS_DEFAULT);
 
+	/*
+	 * Hand prepared foreign transactions that the previous transaction left
+	 * to us over to the resolvers, since we can't commit them while this
+	 * one is in progress.
+	 */
+	AtStart_FdwXact();
+
 	/*
 	 * Set the current transaction state information appropriately during
 	 * start processing.  Note that once the transaction status is switched
@@ -2141,9 +2144,6 @@ CommitTransaction(void)
 	 * the transaction-abort path.
 	 */
 
-	/* Pre-commit step for foreign transactions */
-	PreCommit_FdwXact();
-
 	CallXactCallbacks(is_parallel_worker ? XACT_EVENT_PARALLEL_PRE_COMMIT
 					  : XACT_EVENT_PRE_COMMIT);
 
@@ -2188,6 +2188,15 @@ CommitTransaction(void)
 	if (!is_parallel_worker)
 		PreCommit_CheckForSerializationFailure();
 
+	/*
+	 * Pre-commit step for foreign transactions.  This comes after all the
+	 * steps above that can raise an error, so that a foreign transaction
+	 * committed in one-phase here can't be followed by a local abort.  It
+	 * also sees the final decision on whether we have an xid, which
+	 * PreCommit_Notify() may have assigned.
+	 */
+	PreCommit_FdwXact();
+
 	/* Prevent cancel/die interrupt while cleaning up */
 	HOLD_INTERRUPTS();
 
@@ -994,6 +994,40 @@ CREATE VIEW pg_stat_bgwriter AS
         pg_stat_get_buf_alloc() AS buffers_alloc,
         pg_stat_get_bgwriter_stat_reset_time() AS stats_reset;
 
+CREATE VIEW pg_stat_csn_cache AS
+    SELECT
+        s.hits,
+        s.hint_hits,
+        s.misses
+    FROM pg_csn_snapshot_cache_stats() s;
+
+CREATE VIEW pg_stat_csn_sync AS
+    SELECT
+        s.sync_waits,
+        s.sync_wait_time,
+        s.max_skew
+    FROM pg_stat_get_csn_sync() s;
+
+CREATE VIEW pg_stat_foreign_xact AS
+    SELECT
+        s.oid AS serverid,
+        s.srvname AS servername,
+        x.prepare_count,
+        x.prepare_time,
+        x.csn_prepare_count,
+        x.csn_prepare_time,
+        x.csn_assign_count,
+        x.csn_assign_time,
+        x.commit_count,
+        x.commit_time,
+        x.rollback_count,
+        x.rollback_time,
+        x.resolve_failures,
+        x.in_doubt,
+        x.oldest_in_doubt_age
+    FROM pg_foreign_server s,
+        LATERAL pg_stat_get_foreign_xact(s.oid) x;
+
 CREATE VIEW pg_stat_wal AS
     SELECT
         w.wal_buffers_full,
@@ -33,6 +33,7 @@
 #include "foreign/foreign.h"
 #include "miscadmin.h"
 #include "parser/parse_func.h"
+#include "pgstat.h"
 #include "tcop/utility.h"
 #include "utils/acl.h"
 #include "utils/builtins.h"
@@ -1094,6 +1095,9 @@ RemoveForeignServerById(Oid srvId)
 	ReleaseSysCache(tp);
 
 	table_close(rel, RowExclusiveLock);
+
+	/* Forget its distributed transaction statistics */
+	pgstat_report_fdwxact_drop(srvId);
 }
 
 /*
@@ -1233,6 +1233,11 @@ InitResultRelInfo(ResultRelInfo *resultRelInfo,
 	/* The following fields are set later if needed */
 	resultRelInfo->ri_FdwState = NULL;
 	resultRelInfo->ri_usesFdwDirectModify = false;
+	resultRelInfo->ri_NumSlots = 0;
+	resultRelInfo->ri_NumSlotsInitialized = 0;
+	resultRelInfo->ri_BatchSize = 0;
+	resultRelInfo->ri_Slots = NULL;
+	resultRelInfo->ri_PlanSlots = NULL;
 	resultRelInfo->ri_ConstraintExprs = NULL;
 	resultRelInfo->ri_GeneratedExprs = NULL;
 	resultRelInfo->ri_junkFilter = NULL;
@@ -116,6 +116,14 @@ InstrStopNode(Instrumentation *instr, double nTuples)
 	}
 }
 
+/* Update tuple count */
+void
+InstrUpdateTupleCount(Instrumentation *instr, double nTuples)
+{
+	/* count the returned tuples */
+	instr->tuplecount += nTuples;
+}
+
 /* Finish a run cycle for a plan node */
 void
 InstrEndLoop(Instrumentation *instr)
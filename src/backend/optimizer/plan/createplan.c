@@ -83,6 +83,7 @@ static Plan *create_gating_plan(PlannerInfo *root, Path *path, Plan *plan,
 static Plan *create_join_plan(PlannerInfo *root, JoinPath *best_path);
 static Plan *create_append_plan(PlannerInfo *root, AppendPath *best_path,
 								int flags);
+static bool is_async_capable_plan(Plan *plan, Path *path);
 static Plan *create_merge_append_plan(PlannerInfo *root, MergeAppendPath *best_path,
 									  int flags);
 static Result *create_group_result_plan(PlannerInfo *root,
@@ -1090,6 +1091,8 @@ create_append_plan(PlannerInfo *root, AppendPath *best_path, int flags)
 	Oid		   *nodeSortOperators = NULL;
 	Oid		   *nodeCollations = NULL;
 	bool	   *nodeNullsFirst = NULL;
+	bool		consider_async = false;
+	int			nasyncplans = 0;
 
 	/*
 	 * The subpaths list could be empty, if every child was proven empty by
@@ -1133,6 +1136,15 @@ create_append_plan(PlannerInfo *root, AppendPath *best_path, int flags)
 	plan->plan.righttree = NULL;
 	plan->apprelids = rel->relids;
 
+	/*
+	 * Consider running the children asynchronously.  That's pointless for a
+	 * single child, and not supported for ordered Appends (whose children
+	 * must be read in order anyway) nor for parallel ones.
+	 */
+	consider_async = (enable_async_append && pathkeys == NIL &&
+					  !best_path->path.parallel_safe &&
+					  list_length(best_path->subpaths) > 1);
+
 	if (pathkeys != NIL)
 	{
 		/*
@@ -1219,6 +1231,13 @@ create_append_plan(PlannerInfo *root, AppendPath *best_path, int flags)
 			}
 		}
 
+		/* If needed, check to see if subplan can be executed asynchronously */
+		if (consider_async && is_async_capable_plan(subplan, subpath))
+		{
+			subplan->async_capable = true;
+			++nasyncplans;
+		}
+
 		subplans = lappend(subplans, subplan);
 	}
 
@@ -1254,6 +1273,7 @@ create_append_plan(PlannerInfo *root, AppendPath *best_path, int flags)
 	}
 
 	plan->appendplans = subplans;
+	plan->nasyncplans = nasyncplans;
 	plan->first_partial_plan = best_path->first_partial_path;
 	plan->part_prune_info = partpruneinfo;
 
@@ -1275,6 +1295,37 @@ create_append_plan(PlannerInfo *root, AppendPath *best_path, int flags)
 		return (Plan *) plan;
 }
 
+/*
+ * is_async_capable_plan
+ *		Check whether the Plan node created from a Path node can be executed
+ *		asynchronously by its parent Append.
+ *
+ * Only foreign scans whose FDW says it can run the path asynchronously
+ * qualify.  We insist that the plan is still the ForeignScan itself, since
+ * the executor requests tuples from the Append's direct child.
+ */
+static bool
+is_async_capable_plan(Plan *plan, Path *path)
+{
+	switch (nodeTag(path))
+	{
+		case T_ForeignPath:
+			{
+				FdwRoutine *fdwroutine = path->parent->fdwroutine;
+
+				Assert(fdwroutine != NULL);
+				if (IsA(plan, ForeignScan) &&
+					fdwroutine->IsForeignPathAsyncCapable != NULL &&
+					fdwroutine->IsForeignPathAsyncCapable((ForeignPath *) path))
+					return true;
+			}
+			break;
+		default:
+			break;
+	}
+	return false;
+}
+
 /*
  * create_merge_append_plan
  *	  Create a MergeAppend plan for 'best_path' and (recursively) plans
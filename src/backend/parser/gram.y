@@ -325,6 +325,7 @@ static Node *makeRecursiveViewSelect(char *relname, List *aliases, Node *query);
 				opt_nowait opt_if_exists opt_with_data
 				opt_transaction_chain
 %type <ival>	opt_nowait_or_skip
+%type <str>		opt_commit_prepared_csn
 
 %type <list>	OptRoleList AlterOptRoleList
 %type <defelt>	CreateOptRoleElem AlterOptRoleElem
@@ -638,7 +639,7 @@ static Node *makeRecursiveViewSelect(char *relname, List *aliases, Node *query);
 	CLUSTER COALESCE COLLATE COLLATION COLUMN COLUMNS COMMENT COMMENTS COMMIT
 	COMMITTED CONCURRENTLY CONFIGURATION CONFLICT CONNECTION CONSTRAINT
 	CONSTRAINTS CONTENT_P CONTINUE_P CONVERSION_P COPY COST CREATE
-	CROSS CSV CUBE CURRENT_P
+	CROSS CSN_P CSV CUBE CURRENT_P
 	CURRENT_CATALOG CURRENT_DATE CURRENT_ROLE CURRENT_SCHEMA
 	CURRENT_TIME CURRENT_TIMESTAMP CURRENT_USER CURSOR CYCLE
 
@@ -9843,11 +9844,12 @@ TransactionStmt:
 					n->gid = $3;
 					$$ = (Node *)n;
 				}
-			| COMMIT PREPARED Sconst
+			| COMMIT PREPARED Sconst opt_commit_prepared_csn
 				{
 					TransactionStmt *n = makeNode(TransactionStmt);
 					n->kind = TRANS_STMT_COMMIT_PREPARED;
 					n->gid = $3;
+					n->csn = $4;
 					$$ = (Node *)n;
 				}
 			| ROLLBACK PREPARED Sconst
@@ -9904,6 +9906,13 @@ opt_transaction_chain:
 			| /* EMPTY */	{ $$ = false; }
 		;
 
+/* CSN values don't fit in int4, so we keep them as strings */
+opt_commit_prepared_csn:
+			WITH CSN_P Iconst	{ $$ = psprintf("%d", $3); }
+			| WITH CSN_P FCONST	{ $$ = $3; }
+			| /* EMPTY */		{ $$ = NULL; }
+		;
+
 
 /*****************************************************************************
  *
@@ -15194,6 +15203,7 @@ unreserved_keyword:
 			| CONVERSION_P
 			| COPY
 			| COST
+			| CSN_P
 			| CSV
 			| CUBE
 			| CURRENT_P
@@ -15715,6 +15725,7 @@ bare_label_keyword:
 			| COPY
 			| COST
 			| CROSS
+			| CSN_P
 			| CSV
 			| CUBE
 			| CURRENT_P
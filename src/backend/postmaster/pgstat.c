@@ -104,6 +104,7 @@
 #define PGSTAT_DB_HASH_SIZE		16
 #define PGSTAT_TAB_HASH_SIZE	512
 #define PGSTAT_FUNCTION_HASH_SIZE	512
+#define PGSTAT_FDWXACT_HASH_SIZE	64
 
 
 /* ----------
@@ -150,6 +151,7 @@ PgStat_MsgWal WalStats;
  */
 static const char *const slru_names[] = {
 	"CommitTs",
+	"CSNLog",
 	"MultiXactMember",
 	"MultiXactOffset",
 	"Notify",
@@ -229,6 +231,19 @@ static HTAB *pgStatFunctions = NULL;
  */
 static bool have_function_stats = false;
 
+/*
+ * Backends store per-server distributed transaction counts of the current
+ * database in this hash table, keyed by server OID, until sending them to
+ * the collector.
+ */
+static HTAB *pgStatFdwXacts = NULL;
+
+/*
+ * Indicates if backend has some distributed transaction stats that it hasn't
+ * yet sent to the collector.
+ */
+static bool have_fdwxact_stats = false;
+
 /*
  * Tuple insertion/deletion counts for an open transaction can't be propagated
  * into PgStat_TableStatus counters until we know if it is going to commit
@@ -287,6 +302,7 @@ static PgStat_WalStats walStats;
 static PgStat_SLRUStats slruStats[SLRU_NUM_ELEMENTS];
 static PgStat_ReplSlotStats *replSlotStats;
 static int	nReplSlotStats;
+static HTAB *fdwXactStats = NULL;
 
 /*
  * List of OIDs of databases we need to write out.  If an entry is InvalidOid,
@@ -329,9 +345,11 @@ static bool pgstat_db_requested(Oid databaseid);
 
 static int	pgstat_replslot_index(const char *name, bool create_it);
 static void pgstat_reset_replslot(int i, TimestampTz ts);
+static void pgstat_remove_fdwxact_entries(Oid databaseid);
 
 static void pgstat_send_tabstat(PgStat_MsgTabstat *tsmsg);
 static void pgstat_send_funcstats(void);
+static void pgstat_send_fdwxactstats(void);
 static void pgstat_send_slru(void);
 static HTAB *pgstat_collect_oids(Oid catalogid, AttrNumber anum_oid);
 
@@ -370,6 +388,7 @@ static void pgstat_recv_recoveryconflict(PgStat_MsgRecoveryConflict *msg, int le
 static void pgstat_recv_deadlock(PgStat_MsgDeadlock *msg, int len);
 static void pgstat_recv_checksum_failure(PgStat_MsgChecksumFailure *msg, int len);
 static void pgstat_recv_replslot(PgStat_MsgReplSlot *msg, int len);
+static void pgstat_recv_fdwxact(PgStat_MsgFdwXact *msg, int len);
 static void pgstat_recv_tempfile(PgStat_MsgTempFile *msg, int len);
 
 /* ------------------------------------------------------------
@@ -862,7 +881,7 @@ pgstat_report_stat(bool force)
 	/* Don't expend a clock check if nothing to do */
 	if ((pgStatTabList == NULL || pgStatTabList->tsa_used == 0) &&
 		pgStatXactCommit == 0 && pgStatXactRollback == 0 &&
-		!have_function_stats)
+		!have_function_stats && !have_fdwxact_stats)
 		return;
 
 	/*
@@ -949,6 +968,9 @@ pgstat_report_stat(bool force)
 	/* Now, send function statistics */
 	pgstat_send_funcstats();
 
+	/* Send distributed transaction statistics */
+	pgstat_send_fdwxactstats();
+
 	/* Send WAL statistics */
 	pgstat_send_wal();
 
@@ -1055,6 +1077,57 @@ pgstat_send_funcstats(void)
 	have_function_stats = false;
 }
 
+/*
+ * Subroutine for pgstat_report_stat: populate and send distributed
+ * transaction stat messages
+ */
+static void
+pgstat_send_fdwxactstats(void)
+{
+	/* we assume this inits to all zeroes: */
+	static const PgStat_FdwXactCounts all_zeroes;
+
+	PgStat_MsgFdwXact msg;
+	PgStat_FdwXactEntry *entry;
+	HASH_SEQ_STATUS fstat;
+
+	if (pgStatFdwXacts == NULL)
+		return;
+
+	pgstat_setheader(&msg.m_hdr, PGSTAT_MTYPE_FDWXACT);
+	msg.m_databaseid = MyDatabaseId;
+	msg.m_drop = false;
+	msg.m_nentries = 0;
+
+	hash_seq_init(&fstat, pgStatFdwXacts);
+	while ((entry = (PgStat_FdwXactEntry *) hash_seq_search(&fstat)) != NULL)
+	{
+		/* Skip it if no counts accumulated since last time */
+		if (memcmp(&entry->f_counts, &all_zeroes,
+				   sizeof(PgStat_FdwXactCounts)) == 0)
+			continue;
+
+		memcpy(&msg.m_entry[msg.m_nentries], entry,
+			   sizeof(PgStat_FdwXactEntry));
+
+		if (++msg.m_nentries >= PGSTAT_NUM_FDWXACTENTRIES)
+		{
+			pgstat_send(&msg, offsetof(PgStat_MsgFdwXact, m_entry[0]) +
+						msg.m_nentries * sizeof(PgStat_FdwXactEntry));
+			msg.m_nentries = 0;
+		}
+
+		/* reset the entry's counts */
+		MemSet(&entry->f_counts, 0, sizeof(PgStat_FdwXactCounts));
+	}
+
+	if (msg.m_nentries > 0)
+		pgstat_send(&msg, offsetof(PgStat_MsgFdwXact, m_entry[0]) +
+					msg.m_nentries * sizeof(PgStat_FdwXactEntry));
+
+	have_fdwxact_stats = false;
+}
+
 
 /* ----------
  * pgstat_vacuum_stat() -
@@ -1744,6 +1817,29 @@ pgstat_report_replslot_drop(const char *slotname)
 	pgstat_send(&msg, sizeof(PgStat_MsgReplSlot));
 }
 
+/* ----------
+ * pgstat_report_fdwxact_drop() -
+ *
+ *	Tell the collector about dropping a foreign server.
+ * ----------
+ */
+void
+pgstat_report_fdwxact_drop(Oid serverid)
+{
+	PgStat_MsgFdwXact msg;
+
+	if (pgStatSock == PGINVALID_SOCKET)
+		return;
+
+	pgstat_setheader(&msg.m_hdr, PGSTAT_MTYPE_FDWXACT);
+	msg.m_databaseid = MyDatabaseId;
+	msg.m_drop = true;
+	msg.m_nentries = 1;
+	msg.m_entry[0].f_serverid = serverid;
+	pgstat_send(&msg, offsetof(PgStat_MsgFdwXact, m_entry[0]) +
+				sizeof(PgStat_FdwXactEntry));
+}
+
 /* ----------
  * pgstat_ping() -
  *
@@ -2838,6 +2934,29 @@ pgstat_fetch_replslot(int *nslots_p)
 	return replSlotStats;
 }
 
+/*
+ * ---------
+ * pgstat_fetch_stat_fdwxact() -
+ *
+ *	Support function for the SQL-callable pgstat* functions. Returns
+ *	the collected distributed transaction statistics for one foreign
+ *	server of the current database or NULL if there are none.
+ * ---------
+ */
+PgStat_StatFdwXactEntry *
+pgstat_fetch_stat_fdwxact(Oid serverid)
+{
+	PgStat_FdwXactKey key;
+
+	backend_read_statsfile();
+
+	key.databaseid = MyDatabaseId;
+	key.serverid = serverid;
+	return (PgStat_StatFdwXactEntry *) hash_search(fdwXactStats,
+												   (void *) &key,
+												   HASH_FIND, NULL);
+}
+
 /* ------------------------------------------------------------
  * Functions for management of the shared-memory PgBackendStatus array
  * ------------------------------------------------------------
@@ -3904,6 +4023,9 @@ pgstat_get_wait_ipc(WaitEventIPC w)
 
 	switch (w)
 	{
+		case WAIT_EVENT_APPEND_READY:
+			event_name = "AppendReady";
+			break;
 		case WAIT_EVENT_BACKUP_WAIT_WAL_ARCHIVE:
 			event_name = "BackupWaitWalArchive";
 			break;
@@ -4052,6 +4174,9 @@ pgstat_get_wait_timeout(WaitEventTimeout w)
 		case WAIT_EVENT_BASE_BACKUP_THROTTLE:
 			event_name = "BaseBackupThrottle";
 			break;
+		case WAIT_EVENT_CSN_SNAPSHOT_SYNC:
+			event_name = "CsnSnapshotSync";
+			break;
 		case WAIT_EVENT_PG_SLEEP:
 			event_name = "PgSleep";
 			break;
@@ -4894,6 +5019,10 @@ PgstatCollectorMain(int argc, char *argv[])
 					pgstat_recv_replslot(&msg.msg_replslot, len);
 					break;
 
+				case PGSTAT_MTYPE_FDWXACT:
+					pgstat_recv_fdwxact(&msg.msg_fdwxact, len);
+					break;
+
 				default:
 					break;
 			}
@@ -5092,6 +5221,7 @@ pgstat_write_statsfiles(bool permanent, bool allDbs)
 	int32		format_id;
 	const char *tmpfile = permanent ? PGSTAT_STAT_PERMANENT_TMPFILE : pgstat_stat_tmpname;
 	const char *statfile = permanent ? PGSTAT_STAT_PERMANENT_FILENAME : pgstat_stat_filename;
+	PgStat_StatFdwXactEntry *fxentry;
 	int			rc;
 	int			i;
 
@@ -5183,6 +5313,17 @@ pgstat_write_statsfiles(bool permanent, bool allDbs)
 		(void) rc;				/* we'll check for error with ferror */
 	}
 
+	/*
+	 * Write distributed transaction stats structs
+	 */
+	hash_seq_init(&hstat, fdwXactStats);
+	while ((fxentry = (PgStat_StatFdwXactEntry *) hash_seq_search(&hstat)) != NULL)
+	{
+		fputc('X', fpout);
+		rc = fwrite(fxentry, sizeof(PgStat_StatFdwXactEntry), 1, fpout);
+		(void) rc;				/* we'll check for error with ferror */
+	}
+
 	/*
 	 * No more output to be done. Close the temp file and replace the old
 	 * pgstat.stat with it.  The ferror() check replaces testing for error
@@ -5412,6 +5553,15 @@ pgstat_read_statsfiles(Oid onlydb, bool permanent, bool deep)
 	replSlotStats = palloc0(max_replication_slots * sizeof(PgStat_ReplSlotStats));
 	nReplSlotStats = 0;
 
+	/* Create the hashtable for distributed transaction statistics */
+	memset(&hash_ctl, 0, sizeof(hash_ctl));
+	hash_ctl.keysize = sizeof(PgStat_FdwXactKey);
+	hash_ctl.entrysize = sizeof(PgStat_StatFdwXactEntry);
+	hash_ctl.hcxt = pgStatLocalContext;
+	fdwXactStats = hash_create("Foreign transaction stats hash",
+							   PGSTAT_FDWXACT_HASH_SIZE, &hash_ctl,
+							   HASH_ELEM | HASH_BLOBS | HASH_CONTEXT);
+
 	/*
 	 * Clear out global, archiver, WAL and SLRU statistics so they start from
 	 * zero in case we can't load an existing statsfile.
@@ -5632,6 +5782,31 @@ pgstat_read_statsfiles(Oid onlydb, bool permanent, bool deep)
 				nReplSlotStats++;
 				break;
 
+				/*
+				 * 'X'	A PgStat_StatFdwXactEntry struct describing the
+				 * distributed transactions of a foreign server follows.
+				 */
+			case 'X':
+				{
+					PgStat_StatFdwXactEntry fxbuf;
+					PgStat_StatFdwXactEntry *fxentry;
+
+					if (fread(&fxbuf, 1, sizeof(PgStat_StatFdwXactEntry), fpin)
+						!= sizeof(PgStat_StatFdwXactEntry))
+					{
+						ereport(pgStatRunningInCollector ? LOG : WARNING,
+								(errmsg("corrupted statistics file \"%s\"",
+										statfile)));
+						goto done;
+					}
+
+					fxentry = (PgStat_StatFdwXactEntry *)
+						hash_search(fdwXactStats, (void *) &fxbuf.key,
+									HASH_ENTER, NULL);
+					memcpy(fxentry, &fxbuf, sizeof(PgStat_StatFdwXactEntry));
+				}
+				break;
+
 			case 'E':
 				goto done;
 
@@ -5844,6 +6019,7 @@ pgstat_read_db_statsfile_timestamp(Oid databaseid, bool permanent,
 	PgStat_WalStats myWalStats;
 	PgStat_SLRUStats mySLRUStats[SLRU_NUM_ELEMENTS];
 	PgStat_ReplSlotStats myReplSlotStats;
+	PgStat_StatFdwXactEntry myFdwXactStats;
 	FILE	   *fpin;
 	int32		format_id;
 	const char *statfile = permanent ? PGSTAT_STAT_PERMANENT_FILENAME : pgstat_stat_filename;
@@ -5974,6 +6150,22 @@ pgstat_read_db_statsfile_timestamp(Oid databaseid, bool permanent,
 				}
 				break;
 
+				/*
+				 * 'X'	A PgStat_StatFdwXactEntry struct describing the
+				 * distributed transactions of a foreign server follows.
+				 */
+			case 'X':
+				if (fread(&myFdwXactStats, 1, sizeof(PgStat_StatFdwXactEntry), fpin)
+					!= sizeof(PgStat_StatFdwXactEntry))
+				{
+					ereport(pgStatRunningInCollector ? LOG : WARNING,
+							(errmsg("corrupted statistics file \"%s\"",
+									statfile)));
+					FreeFile(fpin);
+					return false;
+				}
+				break;
+
 			case 'E':
 				goto done;
 
@@ -6162,6 +6354,7 @@ pgstat_clear_snapshot(void)
 	/* Reset variables */
 	pgStatLocalContext = NULL;
 	pgStatDBHash = NULL;
+	fdwXactStats = NULL;
 	localBackendStatusTable = NULL;
 	localNumBackends = 0;
 }
@@ -6443,6 +6636,8 @@ pgstat_recv_dropdb(PgStat_MsgDropdb *msg, int len)
 			ereport(ERROR,
 					(errmsg("database hash table corrupted during cleanup --- abort")));
 	}
+
+	pgstat_remove_fdwxact_entries(dbid);
 }
 
 
@@ -6482,6 +6677,9 @@ pgstat_recv_resetcounter(PgStat_MsgResetcounter *msg, int len)
 	 * tables and functions.
 	 */
 	reset_dbentry_counters(dbentry);
+
+	/* Also throw away the database's distributed transaction entries */
+	pgstat_remove_fdwxact_entries(msg->m_databaseid);
 }
 
 /* ----------
@@ -6918,6 +7116,50 @@ pgstat_recv_replslot(PgStat_MsgReplSlot *msg, int len)
 	}
 }
 
+/* ----------
+ * pgstat_recv_fdwxact() -
+ *
+ *	Count what the backend has done, or drop the entries of foreign
+ *	servers.
+ * ----------
+ */
+static void
+pgstat_recv_fdwxact(PgStat_MsgFdwXact *msg, int len)
+{
+	PgStat_FdwXactEntry *fxmsg = &(msg->m_entry[0]);
+	int			i;
+
+	for (i = 0; i < msg->m_nentries; i++, fxmsg++)
+	{
+		PgStat_StatFdwXactEntry *fxentry;
+		PgStat_FdwXactKey key;
+		bool		found;
+		int			p;
+
+		key.databaseid = msg->m_databaseid;
+		key.serverid = fxmsg->f_serverid;
+
+		if (msg->m_drop)
+		{
+			(void) hash_search(fdwXactStats, (void *) &key, HASH_REMOVE, NULL);
+			continue;
+		}
+
+		fxentry = (PgStat_StatFdwXactEntry *) hash_search(fdwXactStats,
+														  (void *) &key,
+														  HASH_ENTER, &found);
+		if (!found)
+			MemSet(&fxentry->counts, 0, sizeof(PgStat_FdwXactCounts));
+
+		for (p = 0; p < PGSTAT_FDWXACT_NUM_PHASES; p++)
+		{
+			fxentry->counts.f_count[p] += fxmsg->f_counts.f_count[p];
+			fxentry->counts.f_time[p] += fxmsg->f_counts.f_time[p];
+		}
+		fxentry->counts.f_failures += fxmsg->f_counts.f_failures;
+	}
+}
+
 /* ----------
  * pgstat_recv_tempfile() -
  *
@@ -7154,6 +7396,28 @@ pgstat_reset_replslot(int i, TimestampTz ts)
 	replSlotStats[i].stat_reset_timestamp = ts;
 }
 
+/* ----------
+ * pgstat_remove_fdwxact_entries
+ *
+ * Remove the distributed transaction statistics of all foreign servers of
+ * the given database.
+ * ----------
+ */
+static void
+pgstat_remove_fdwxact_entries(Oid databaseid)
+{
+	HASH_SEQ_STATUS hstat;
+	PgStat_StatFdwXactEntry *fxentry;
+
+	hash_seq_init(&hstat, fdwXactStats);
+	while ((fxentry = (PgStat_StatFdwXactEntry *) hash_seq_search(&hstat)) != NULL)
+	{
+		if (fxentry->key.databaseid == databaseid)
+			(void) hash_search(fdwXactStats, (void *) &fxentry->key,
+							   HASH_REMOVE, NULL);
+	}
+}
+
 /*
  * pgstat_slru_index
  *
@@ -7212,6 +7476,78 @@ slru_entry(int slru_idx)
 	return &SLRUStats[slru_idx];
 }
 
+/*
+ * Distributed transaction statistics count accumulation functions --- called
+ * from fdwxact.c
+ */
+
+/*
+ * Find or create the pending counts of the given foreign server.
+ */
+static PgStat_FdwXactCounts *
+get_fdwxact_stat_counts(Oid serverid)
+{
+	PgStat_FdwXactEntry *entry;
+	bool		found;
+
+	if (pgStatFdwXacts == NULL)
+	{
+		HASHCTL		hash_ctl;
+
+		memset(&hash_ctl, 0, sizeof(HASHCTL));
+		hash_ctl.keysize = sizeof(Oid);
+		hash_ctl.entrysize = sizeof(PgStat_FdwXactEntry);
+		pgStatFdwXacts = hash_create("Foreign transaction stat entries",
+									 PGSTAT_FDWXACT_HASH_SIZE,
+									 &hash_ctl,
+									 HASH_ELEM | HASH_BLOBS);
+	}
+
+	entry = (PgStat_FdwXactEntry *) hash_search(pgStatFdwXacts, &serverid,
+												HASH_ENTER, &found);
+	if (!found)
+		MemSet(&entry->f_counts, 0, sizeof(PgStat_FdwXactCounts));
+
+	have_fdwxact_stats = true;
+
+	return &entry->f_counts;
+}
+
+/*
+ * Count n foreign transactions of the given server that went through the
+ * given phase at once, which took from start until now.
+ */
+void
+pgstat_count_fdwxact(Oid serverid, PgStat_FdwXactPhase phase, int n,
+					 instr_time start)
+{
+	PgStat_FdwXactCounts *counts;
+	instr_time	duration;
+
+	if (!pgstat_track_counts)
+		return;
+
+	INSTR_TIME_SET_CURRENT(duration);
+	INSTR_TIME_SUBTRACT(duration, start);
+
+	counts = get_fdwxact_stat_counts(serverid);
+	counts->f_count[phase] += n;
+	counts->f_time[phase] += INSTR_TIME_GET_MICROSEC(duration);
+}
+
+/*
+ * Count n foreign transactions of the given server that failed to be
+ * committed or rolled back once prepared, and are to be retried.
+ */
+void
+pgstat_count_fdwxact_failure(Oid serverid, int n)
+{
+	if (!pgstat_track_counts)
+		return;
+
+	get_fdwxact_stat_counts(serverid)->f_failures += n;
+}
+
 /*
  * SLRU statistics count accumulation functions --- called from slru.c
  */
@@ -44,6 +44,7 @@
 #include <signal.h>
 #include <unistd.h>
 
+#include "access/csn_snapshot.h"
 #include "access/xlog.h"
 #include "libpq/pqsignal.h"
 #include "miscadmin.h"
@@ -223,6 +224,7 @@ WalWriterMain(void)
 	for (;;)
 	{
 		long		cur_timeout;
+		bool		csn_reserved;
 
 		/*
 		 * Advertise whether we might hibernate in this cycle.  We do this
@@ -246,9 +248,11 @@ WalWriterMain(void)
 
 		/*
 		 * Do what we're here for; then, if XLogBackgroundFlush() found useful
-		 * work to do, reset hibernation counter.
+		 * work to do, reset hibernation counter.  Reserve CSNs first, so that
+		 * the CSN assignment record gets flushed along with everything else.
 		 */
-		if (XLogBackgroundFlush())
+		csn_reserved = CSNSnapshotReserveCSNs();
+		if (XLogBackgroundFlush() || csn_reserved)
 			left_till_hibernate = LOOPS_UNTIL_HIBERNATE;
 		else if (left_till_hibernate > 0)
 			left_till_hibernate--;
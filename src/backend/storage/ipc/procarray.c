@@ -570,7 +570,7 @@ ProcArrayRemove(PGPROC *proc, TransactionId latestXid)
 		 * CSNSnapshotCommit() will write this value to CsnLog.
 		 */
 		if (CSNIsInDoubt(pg_atomic_read_u64(&proc->assignedCSN)))
-			pg_atomic_write_u64(&proc->assignedCSN, GenerateCSN(false, InvalidCSN));
+			pg_atomic_write_u64(&proc->assignedCSN, GenerateCSN(InvalidCSN));
 	}
 	else
 	{
@@ -739,14 +739,11 @@ ProcArrayEndTransactionInternal(PGPROC *proc, TransactionId latestXid)
 	ShmemVariableCache->xactCompletionCount++;
 
 	/*
-	 * Assign xid csn while holding ProcArrayLock for
-	 * COMMIT.
-	 *
-	 * TODO: in case of group commit we can generate one CSNSnapshot for
-	 * whole group to save time on timestamp aquisition.
+	 * Assign xid csn while holding ProcArrayLock for COMMIT, unless the
+	 * group commit leader already did, see ProcArrayGroupClearXid().
 	 */
 	if (CSNIsInDoubt(pg_atomic_read_u64(&proc->assignedCSN)))
-		pg_atomic_write_u64(&proc->assignedCSN, GenerateCSN(false, InvalidCSN));
+		pg_atomic_write_u64(&proc->assignedCSN, GenerateCSN(InvalidCSN));
 }
 
 /*
@@ -829,15 +826,49 @@ ProcArrayGroupClearXid(PGPROC *proc, TransactionId latestXid)
 	/* Remember head of list so we can perform wakeups after dropping lock. */
 	wakeidx = nextidx;
 
+	/*
+	 * Members committing with csn snapshots need a CSN assigned under
+	 * ProcArrayLock.  Rather than reading the clock and advancing the
+	 * maximum CSN once per member, reserve a contiguous range for all of
+	 * them at once.
+	 */
+	if (get_csnlog_status())
+	{
+		int			ncsns = 0;
+
+		for (nextidx = wakeidx; nextidx != INVALID_PGPROCNO;
+			 nextidx = pg_atomic_read_u32(&allProcs[nextidx].procArrayGroupNext))
+		{
+			if (CSNIsInDoubt(pg_atomic_read_u64(&allProcs[nextidx].assignedCSN)))
+				ncsns++;
+		}
+
+		if (ncsns > 0)
+		{
+			CSN			csn = GenerateCSNRange(ncsns);
+
+			for (nextidx = wakeidx; nextidx != INVALID_PGPROCNO;
+				 nextidx = pg_atomic_read_u32(&allProcs[nextidx].procArrayGroupNext))
+			{
+				PGPROC	   *nextproc = &allProcs[nextidx];
+
+				if (CSNIsInDoubt(pg_atomic_read_u64(&nextproc->assignedCSN)))
+					pg_atomic_write_u64(&nextproc->assignedCSN, csn++);
+			}
+		}
+
+		nextidx = wakeidx;
+	}
+
 	/* Walk the list and clear all XIDs. */
 	while (nextidx != INVALID_PGPROCNO)
 	{
-		PGPROC	   *proc = &allProcs[nextidx];
+		PGPROC	   *nextproc = &allProcs[nextidx];
 
-		ProcArrayEndTransactionInternal(proc, proc->procArrayGroupMemberXid);
+		ProcArrayEndTransactionInternal(nextproc, nextproc->procArrayGroupMemberXid);
 
 		/* Move to next proc in list. */
-		nextidx = pg_atomic_read_u32(&proc->procArrayGroupNext);
+		nextidx = pg_atomic_read_u32(&nextproc->procArrayGroupNext);
 	}
 
 	/* We're done with the lock now. */
@@ -852,18 +883,18 @@ ProcArrayGroupClearXid(PGPROC *proc, TransactionId latestXid)
 	 */
 	while (wakeidx != INVALID_PGPROCNO)
 	{
-		PGPROC	   *proc = &allProcs[wakeidx];
+		PGPROC	   *nextproc = &allProcs[wakeidx];
 
-		wakeidx = pg_atomic_read_u32(&proc->procArrayGroupNext);
-		pg_atomic_write_u32(&proc->procArrayGroupNext, INVALID_PGPROCNO);
+		wakeidx = pg_atomic_read_u32(&nextproc->procArrayGroupNext);
+		pg_atomic_write_u32(&nextproc->procArrayGroupNext, INVALID_PGPROCNO);
 
 		/* ensure all previous writes are visible before follower continues. */
 		pg_write_barrier();
 
-		proc->procArrayGroupMember = false;
+		nextproc->procArrayGroupMember = false;
 
-		if (proc != MyProc)
-			PGSemaphoreUnlock(proc->sem);
+		if (nextproc != MyProc)
+			PGSemaphoreUnlock(nextproc->sem);
 	}
 }
 
@@ -2405,7 +2436,7 @@ GetSnapshotData(Snapshot snapshot)
 	 * synchronized.
 	 */
 	if (!snapshot->takenDuringRecovery && get_csnlog_status())
-		csn = GenerateCSN(false, InvalidCSN);
+		csn = GenerateCSN(InvalidCSN);
 
 	LWLockRelease(ProcArrayLock);
 
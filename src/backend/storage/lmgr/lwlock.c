@@ -179,7 +179,9 @@ static const char *const BuiltinTrancheNames[] = {
 	/* LWTRANCHE_PER_XACT_PREDICATE_LIST: */
 	"PerXactPredicateList",
 	/* LWTRANCHE_CSN_LOG_BUFFERS */
-	"CsnLogBuffers"
+	"CsnLogBuffers",
+	/* LWTRANCHE_CSN_LOG_CONTROL */
+	"CsnLogControl"
 };
 
 StaticAssertDecl(lengthof(BuiltinTrancheNames) ==
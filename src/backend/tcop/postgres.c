@@ -36,6 +36,7 @@
 #include "rusagestub.h"
 #endif
 
+#include "access/fdwxact.h"
 #include "access/fdwxact_launcher.h"
 #include "access/fdwxact_resolver.h"
 #include "access/parallel.h"
@@ -2675,6 +2676,13 @@ finish_xact_command(void)
 #endif
 
 		xact_started = false;
+
+		/*
+		 * Commit the prepared foreign transactions that the just finished
+		 * transaction left to us, unless we are still in a transaction block.
+		 */
+		if (!IsTransactionOrTransactionBlock())
+			FdwXactResolvePendingCommits();
 	}
 }
 
@@ -4229,6 +4237,13 @@ PostgresMain(int argc, char *argv[],
 			}
 			else
 			{
+				/*
+				 * Commit the prepared foreign transactions that the just
+				 * finished transaction left to us, if finish_xact_command()
+				 * didn't.
+				 */
+				FdwXactResolvePendingCommits();
+
 				/* Send out notify signals and transmit self-notifies */
 				ProcessCompletedNotifies();
 
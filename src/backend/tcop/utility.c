@@ -67,6 +67,7 @@
 #include "tcop/utility.h"
 #include "utils/acl.h"
 #include "utils/guc.h"
+#include "utils/int8.h"
 #include "utils/lsyscache.h"
 #include "utils/rel.h"
 #include "utils/syscache.h"
@@ -635,6 +636,13 @@ standard_ProcessUtility(PlannedStmt *pstmt,
 
 					case TRANS_STMT_COMMIT_PREPARED:
 						PreventInTransactionBlock(isTopLevel, "COMMIT PREPARED");
+						if (stmt->csn)
+						{
+							int64		csn;
+
+							(void) scanint8(stmt->csn, false, &csn);
+							CSNSnapshotAssignTwoPhase(stmt->gid, (SnapshotCSN) csn);
+						}
 						FinishPreparedTransaction(stmt->gid, true);
 						break;
 
@@ -14,6 +14,7 @@
  */
 #include "postgres.h"
 
+#include "access/fdwxact.h"
 #include "access/htup_details.h"
 #include "access/xlog.h"
 #include "catalog/pg_authid.h"
@@ -1733,6 +1734,61 @@ pg_stat_get_wal(PG_FUNCTION_ARGS)
 	PG_RETURN_DATUM(HeapTupleGetDatum(heap_form_tuple(tupdesc, values, nulls)));
 }
 
+/*
+ * Returns statistics of distributed transactions on the given foreign server
+ * of the current database.
+ */
+Datum
+pg_stat_get_foreign_xact(PG_FUNCTION_ARGS)
+{
+#define PG_STAT_GET_FOREIGN_XACT_COLS	13
+	Oid			serverid = PG_GETARG_OID(0);
+	TupleDesc	tupdesc;
+	Datum		values[PG_STAT_GET_FOREIGN_XACT_COLS];
+	bool		nulls[PG_STAT_GET_FOREIGN_XACT_COLS];
+	PgStat_StatFdwXactEntry *fxentry;
+	PgStat_FdwXactCounts counts;
+	TimestampTz oldest;
+	int			in_doubt;
+	int			i = 0;
+
+	/* Initialise values and NULL flags arrays */
+	MemSet(values, 0, sizeof(values));
+	MemSet(nulls, 0, sizeof(nulls));
+
+	/* Build a tuple descriptor for our result type */
+	if (get_call_result_type(fcinfo, NULL, &tupdesc) != TYPEFUNC_COMPOSITE)
+		elog(ERROR, "return type must be a row type");
+
+	fxentry = pgstat_fetch_stat_fdwxact(serverid);
+	if (fxentry)
+		counts = fxentry->counts;
+	else
+		MemSet(&counts, 0, sizeof(PgStat_FdwXactCounts));
+
+	/* Count and total time in milliseconds of each phase */
+	for (int p = 0; p < PGSTAT_FDWXACT_NUM_PHASES; p++)
+	{
+		values[i++] = Int64GetDatum(counts.f_count[p]);
+		values[i++] = Float8GetDatum(((double) counts.f_time[p]) / 1000.0);
+	}
+	values[i++] = Int64GetDatum(counts.f_failures);
+
+	/* Foreign transactions currently in doubt, and the age of the oldest */
+	in_doubt = FdwXactCountServerEntries(MyDatabaseId, serverid, &oldest);
+	values[i++] = Int32GetDatum(in_doubt);
+	if (in_doubt > 0)
+		values[i++] = DirectFunctionCall2(timestamp_mi,
+										  TimestampTzGetDatum(GetCurrentTimestamp()),
+										  TimestampTzGetDatum(oldest));
+	else
+		nulls[i++] = true;
+	Assert(i == PG_STAT_GET_FOREIGN_XACT_COLS);
+
+	/* Returns the record as Datum */
+	PG_RETURN_DATUM(HeapTupleGetDatum(heap_form_tuple(tupdesc, values, nulls)));
+}
+
 /*
  * Returns statistics of SLRU caches.
  */
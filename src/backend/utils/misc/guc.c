@@ -32,6 +32,7 @@
 #include "access/commit_ts.h"
 #include "access/fdwxact.h"
 #include "access/gin.h"
+#include "access/csn_log.h"
 #include "access/csn_snapshot.h"
 #include "access/rmgr.h"
 #include "access/tableam.h"
@@ -1100,6 +1101,16 @@ static struct config_bool ConfigureNamesBool[] =
 		false,
 		NULL, NULL, NULL
 	},
+	{
+		{"enable_async_append", PGC_USERSET, QUERY_TUNING_METHOD,
+			gettext_noop("Enables the planner's use of async append plans."),
+			NULL,
+			GUC_EXPLAIN
+		},
+		&enable_async_append,
+		true,
+		NULL, NULL, NULL
+	},
 	{
 		{"enable_parallel_append", PGC_USERSET, QUERY_TUNING_METHOD,
 			gettext_noop("Enables the planner's use of parallel append plans."),
@@ -1190,6 +1201,15 @@ static struct config_bool ConfigureNamesBool[] =
 		false,
 		NULL, NULL, NULL
 	},
+	{
+		{"foreign_transaction_resolve_in_backend", PGC_USERSET, FOREIGN_TRANSACTION,
+			gettext_noop("Commits prepared foreign transactions in the committing backend."),
+			gettext_noop("The foreign transaction resolver only retries the ones that fail.")
+		},
+		&foreign_xact_resolve_in_backend,
+		false,
+		NULL, NULL, NULL
+	},
 
 	{
 		{"ssl", PGC_SIGHUP, CONN_AUTH_SSL,
@@ -2650,6 +2670,27 @@ static struct config_int ConfigureNamesInt[] =
 		NULL, NULL, NULL
 	},
 
+	{
+		{"csn_log_buffers", PGC_POSTMASTER, RESOURCES_MEM,
+			gettext_noop("Sets the number of shared memory buffers used for the CSN log."),
+			gettext_noop("0 means to size the CSN log based on shared_buffers."),
+			GUC_UNIT_BLOCKS
+		},
+		&csn_log_buffers,
+		0, 0, CSN_LOG_MAX_BUFFERS,
+		NULL, NULL, NULL
+	},
+
+	{
+		{"csn_hint_cache_size", PGC_POSTMASTER, RESOURCES_MEM,
+			gettext_noop("Sets the number of commit sequence numbers cached in shared memory."),
+			gettext_noop("0 disables the shared CSN hint cache.")
+		},
+		&csn_hint_cache_size,
+		0, 0, INT_MAX / 16,
+		NULL, NULL, NULL
+	},
+
 	{
 		{"csn_snapshot_defer_time", PGC_POSTMASTER, REPLICATION_PRIMARY,
 			gettext_noop("Minimal age of records which allowed to be vacuumed, in seconds."),
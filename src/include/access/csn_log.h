@@ -27,7 +27,9 @@
  * turned back.
  *
  * However we can not log the MAX CSN every time it generated, if so it will
- * cause too many wal expend, so we log it 5s more in the future.
+ * cause too many wal expend, so we log it 5s more in the future.  These
+ * records are logged ahead of time by the walwriter, so that backends
+ * generating CSNs don't have to write WAL, see CSNSnapshotReserveCSNs().
  *
  * As a trade off, when this database restart, there will be 5s bad performance
  * for time synchronization among sharding nodes.
@@ -48,6 +50,15 @@ typedef struct xl_csn_set
 
 #define MinSizeOfCSNSet offsetof(xl_csn_set, xsub)
 #define	CSNAddByNanosec(csn,second) (csn + second * 1000000000L)
+
+/*
+ * Upper limit of csn_log_buffers.  Lookups scan a bank's buffers linearly,
+ * so more buffers per bank would make every access slower.
+ */
+#define CSN_LOG_MAX_BUFFERS		2048
+
+extern int csn_log_buffers;
+
 extern void CSNLogSetCSN(TransactionId xid, int nsubxids,
 							   TransactionId *subxids, CSN csn, bool write_xlog);
 extern CSN CSNLogGetCSNByXid(TransactionId xid);
@@ -40,6 +40,7 @@ typedef pg_atomic_uint64 CSN_atomic;
 
 
 extern int csn_snapshot_defer_time;
+extern int csn_hint_cache_size;
 
 
 extern Size CSNSnapshotShmemSize(void);
@@ -49,11 +50,14 @@ extern void CSNSnapshotStartup(TransactionId oldestActiveXID);
 extern void CSNSnapshotMapXmin(SnapshotCSN snapshot_csn);
 extern TransactionId CSNSnapshotToXmin(SnapshotCSN snapshot_csn);
 
-extern SnapshotCSN GenerateCSN(bool locked, CSN assign);
+extern SnapshotCSN GenerateCSN(CSN assign);
+extern SnapshotCSN GenerateCSNRange(int n);
+extern bool CSNSnapshotReserveCSNs(void);
 
 extern bool XidInvisibleInCSNSnapshot(TransactionId xid, Snapshot snapshot);
 
 extern CSN TransactionIdGetCSN(TransactionId xid);
+extern void CSNHintTruncate(TransactionId oldestXact);
 
 extern void CSNSnapshotAbort(PGPROC *proc, TransactionId xid, int nsubxids,
 								TransactionId *subxids);
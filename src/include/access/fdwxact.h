@@ -11,7 +11,9 @@
 #define FDWXACT_H
 
 #include "access/fdwxact_xlog.h"
+#include "datatype/timestamp.h"
 #include "foreign/foreign.h"
+#include "lib/ilist.h"
 #include "storage/proc.h"
 #include "storage/shmem.h"
 #include "storage/s_lock.h"
@@ -47,6 +49,10 @@ typedef struct FdwXactData *FdwXact;
 typedef struct FdwXactData
 {
 	FdwXact		fdwxact_free_next;	/* Next free FdwXact entry */
+	FdwXact		xid_next;		/* Next entry of the same local transaction */
+	dlist_node	server_node;	/* Entry in the list of its database and
+								 * server, in insertion order */
+	int			ctl_idx;		/* Index in FdwXactCtl->fdwxacts */
 
 	TransactionId local_xid;	/* XID of local transaction */
 
@@ -61,24 +67,20 @@ typedef struct FdwXactData
 	slock_t		mutex;			/* protect the above field */
 
 	/*
-	 * Note that we need to keep track of two LSNs for each FdwXact. We keep
-	 * track of the start LSN because this is the address we must use to read
-	 * state data back from WAL when committing a FdwXact. We keep track of
-	 * the end LSN because that is the LSN we need to wait for prior to
-	 * commit.
+	 * End LSN of the WAL record inserting this entry.  A checkpoint writes
+	 * the entry to its snapshot file only if this is behind its redo
+	 * horizon, otherwise recovery gets the entry from WAL.  Invalid if the
+	 * entry was restored from the snapshot file.
 	 */
-	XLogRecPtr	insert_start_lsn;	/* XLOG offset of inserting this entry
-									 * start */
-	XLogRecPtr	insert_end_lsn; /* XLOG offset of inserting this entry end */
+	XLogRecPtr	insert_end_lsn;
 
 	bool		valid;			/* has the entry been complete and written to
-								 * file? */
+								 * WAL? */
 	BackendId	locking_backend;	/* backend currently working on the fdw xact */
-	bool		ondisk;			/* true if prepare state file is on disk */
 	bool		inredo;			/* true if entry was added via xlog_redo */
+	TimestampTz insert_time;	/* when the entry was added on this server */
 
-	char		fdwxact_id[FDWXACT_ID_MAX_LEN]; /* prepared transaction
-												 * identifier */
+	FdwXactId	fxid;			/* global transaction identifier */
 }			FdwXactData;
 
 /*
@@ -94,6 +96,9 @@ typedef struct
 	/* Number of valid foreign transaction entries */
 	int			num_fdwxacts;
 
+	/* Number of distinct local transactions in the xid heap */
+	int			num_xids;
+
 	/* Upto max_prepared_foreign_xacts entries in the array */
 	FdwXact		fdwxacts[FLEXIBLE_ARRAY_MEMBER];	/* Variable length array */
 } FdwXactCtlData;
@@ -105,11 +110,20 @@ FdwXactCtlData *FdwXactCtl;
 typedef struct FdwXactRslvState
 {
 	/* Foreign transaction information */
-	char		   *fdwxact_id;
+	char		fdwxact_id[FDWXACT_ID_MAX_LEN];	/* prepared transaction
+												 * identifier */
 	ForeignServer *server;
 	UserMapping *usermapping;
 
 	int			flags;			/* OR of FDWXACT_FLAG_xx flags */
+
+	/*
+	 * CSN of the foreign transaction, used if FDWXACT_FLAG_USE_GLOBAL_CSN is
+	 * set.  When preparing, the FDW can set the prepare CSN to save the
+	 * separate call of PrepareForeignCSNSnapshot.  When committing the
+	 * prepared transaction, this is the global CSN to assign to it.
+	 */
+	CSN			csn;
 } FdwXactRslvState;
 
 /* GUC parameters */
@@ -119,20 +133,23 @@ extern int	foreign_xact_resolution_retry_interval;
 extern int	foreign_xact_resolver_timeout;
 extern int	foreign_twophase_commit;
 extern bool enable_global_snapshot;
+extern bool foreign_xact_resolve_in_backend;
 
 /* Function declarations */
 extern Size FdwXactShmemSize(void);
 extern void FdwXactShmemInit(void);
 extern void PreCommit_FdwXact(void);
 extern void AtEOXact_FdwXact(bool is_commit);
+extern void AtStart_FdwXact(void);
+extern void FdwXactResolvePendingCommits(void);
 extern void PrePrepare_FdwXact(void);
 extern bool FdwXactIsForeignTwophaseCommitRequired(void);
-extern void FdwXactResolveFdwXacts(int *fdwxact_idxs, int nfdwxacts);
+extern void FdwXactResolveFdwXacts(FdwXact *fdwxacts, int nfdwxacts);
 extern bool FdwXactExists(Oid dbid, Oid serverid, Oid userid);
+extern int	FdwXactCountServerEntries(Oid dbid, Oid serverid,
+									  TimestampTz *oldest);
 extern bool FdwXactExistsXid(TransactionId xid);
 extern void CheckPointFdwXacts(XLogRecPtr redo_horizon);
-extern void RecreateFdwXactFile(Oid dbid, TransactionId xid, Oid serverid,
-								Oid userid, void *content, int len);
 extern void RestoreFdwXactData(void);
 extern void RecoverFdwXacts(void);
 extern TransactionId PrescanFdwXacts(TransactionId oldestActiveXid);
@@ -19,7 +19,7 @@
 extern void FdwXactLauncherRegister(void);
 extern void FdwXactLauncherMain(Datum main_arg);
 extern void FdwXactLauncherRequestToLaunch(void);
-extern void FdwXactLaunchOrWakeupResolver(void);
+extern void FdwXactLaunchOrWakeupResolver(Oid serverid);
 extern Size FdwXactRslvShmemSize(void);
 extern void FdwXactRslvShmemInit(void);
 extern bool IsFdwXactLauncher(void);
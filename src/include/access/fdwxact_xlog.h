@@ -23,6 +23,26 @@
 /* Maximum length of the prepared transaction id, borrowed from twophase.c */
 #define FDWXACT_ID_MAX_LEN 200
 
+/*
+ * Global identifier of a foreign transaction.  The system identifier makes it
+ * unique among coordinators, and the participant index among the foreign
+ * transactions of one local transaction.  A cloned or promoted coordinator
+ * keeps the system identifier and may reuse xids, so a random number is
+ * added to keep its identifiers from colliding with those of the original.
+ * It's rendered as the prepared transaction identifier only when sent to the
+ * foreign server.
+ */
+typedef struct FdwXactId
+{
+	uint64		sysid;			/* system identifier of the coordinator */
+	TransactionId xid;			/* local transaction id */
+	uint32		index;			/* participant index */
+	uint32		random;			/* random number */
+} FdwXactId;
+
+/* Default rendering of FdwXactId, followed by its fields in order */
+#define FDWXACT_ID_FORMAT "fx_" UINT64_FORMAT "_%u_%u_%u"
+
 /*
  * On disk file structure, also used to WAL
  */
@@ -35,9 +55,24 @@ typedef struct
 								 * place */
 	Oid			userid;			/* user who initiated the foreign transaction */
 	Oid			umid;
-	char		fdwxact_id[FDWXACT_ID_MAX_LEN]; /* foreign txn prepare id */
+	FdwXactId	fxid;			/* global transaction identifier */
 } FdwXactOnDiskData;
 
+/* Size of an entry in XLOG_FDWXACT_INSERT */
+#define FdwXactOnDiskDataSize(data) MAXALIGN(sizeof(FdwXactOnDiskData))
+
+/*
+ * XLOG_FDWXACT_INSERT logs all participants of a distributed transaction at
+ * once.  The header is followed by nentries FdwXactOnDiskData entries, see
+ * FdwXactOnDiskDataSize().
+ */
+typedef struct xl_fdwxact_insert
+{
+	int			nentries;		/* number of participants */
+} xl_fdwxact_insert;
+
+#define SizeOfFdwXactInsert	MAXALIGN(sizeof(xl_fdwxact_insert))
+
 typedef struct xl_fdwxact_remove
 {
 	TransactionId xid;
@@ -21,11 +21,16 @@
 /*
  * Each foreign transaction resolver has a FdwXactResolver struct in
  * shared memory.  This struct is protected by FdwXactResolverLaunchLock.
+ *
+ * A resolver resolves the foreign transactions of one foreign server on one
+ * database, so that transactions on different servers are resolved in
+ * parallel.
  */
 typedef struct FdwXactResolver
 {
 	pid_t		pid;			/* this resolver's PID, or 0 if not active */
 	Oid			dbid;			/* database oid */
+	Oid			serverid;		/* foreign server oid */
 
 	/* Indicates if this slot is used of free */
 	bool		in_use;
@@ -31,7 +31,7 @@
 /*
  * Each page of XLOG file has a header like this:
  */
-#define XLOG_PAGE_MAGIC 0xD108	/* can be used as WAL version indicator */
+#define XLOG_PAGE_MAGIC 0xD10B	/* can be used as WAL version indicator */
 
 typedef struct XLogPageHeaderData
 {
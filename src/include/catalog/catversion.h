@@ -53,6 +53,6 @@
  */
 
 /*							yyyymmddN */
-#define CATALOG_VERSION_NO	202011044
+#define CATALOG_VERSION_NO	202011049
 
 #endif
@@ -86,6 +86,14 @@ typedef TupleTableSlot *(*ExecForeignInsert_function) (EState *estate,
 													   TupleTableSlot *slot,
 													   TupleTableSlot *planSlot);
 
+typedef TupleTableSlot **(*ExecForeignBatchInsert_function) (EState *estate,
+															 ResultRelInfo *rinfo,
+															 TupleTableSlot **slots,
+															 TupleTableSlot **planSlots,
+															 int *numSlots);
+
+typedef int (*GetForeignModifyBatchSize_function) (ResultRelInfo *rinfo);
+
 typedef TupleTableSlot *(*ExecForeignUpdate_function) (EState *estate,
 													   ResultRelInfo *rinfo,
 													   TupleTableSlot *slot,
@@ -171,14 +179,32 @@ typedef List *(*ReparameterizeForeignPathByChild_function) (PlannerInfo *root,
 															List *fdw_private,
 															RelOptInfo *child_rel);
 
+typedef bool (*IsForeignPathAsyncCapable_function) (ForeignPath *path);
+
+typedef void (*ForeignAsyncRequest_function) (AsyncRequest *areq);
+
+typedef void (*ForeignAsyncConfigureWait_function) (AsyncRequest *areq);
+
+typedef void (*ForeignAsyncNotify_function) (AsyncRequest *areq);
+
 typedef void (*PrepareForeignTransaction_function) (FdwXactRslvState *frstate);
+typedef void (*SendPrepareForeignTransaction_function) (FdwXactRslvState *frstate);
+typedef void (*WaitPrepareForeignTransaction_function) (FdwXactRslvState *frstate);
 typedef void (*CommitForeignTransaction_function) (FdwXactRslvState *frstate);
+typedef void (*SendCommitForeignTransaction_function) (FdwXactRslvState *frstate);
+typedef void (*WaitCommitForeignTransaction_function) (FdwXactRslvState *frstate);
 typedef void (*RollbackForeignTransaction_function) (FdwXactRslvState *frstate);
+typedef void (*SendRollbackForeignTransaction_function) (FdwXactRslvState *frstate);
+typedef void (*WaitRollbackForeignTransaction_function) (FdwXactRslvState *frstate);
 typedef char *(*GetPrepareId_function) (TransactionId xid, Oid serverid,
 										Oid userid, int *prep_id_len);
 /* CSN based global snapshot functions */
 typedef uint64 (*PrepareForeignCSNSnapshot_function) (FdwXactRslvState *frstate);
 typedef void (*AssignGlobalCSN_function) (FdwXactRslvState *frstate, CSN max_csn);
+typedef void (*SendPrepareForeignCSNSnapshot_function) (FdwXactRslvState *frstate);
+typedef uint64 (*WaitPrepareForeignCSNSnapshot_function) (FdwXactRslvState *frstate);
+typedef void (*SendAssignGlobalCSN_function) (FdwXactRslvState *frstate, CSN max_csn);
+typedef void (*WaitAssignGlobalCSN_function) (FdwXactRslvState *frstate);
 
 /*
  * FdwRoutine is the struct returned by a foreign-data wrapper's handler
@@ -219,6 +245,8 @@ typedef struct FdwRoutine
 	PlanForeignModify_function PlanForeignModify;
 	BeginForeignModify_function BeginForeignModify;
 	ExecForeignInsert_function ExecForeignInsert;
+	ExecForeignBatchInsert_function ExecForeignBatchInsert;
+	GetForeignModifyBatchSize_function GetForeignModifyBatchSize;
 	ExecForeignUpdate_function ExecForeignUpdate;
 	ExecForeignDelete_function ExecForeignDelete;
 	EndForeignModify_function EndForeignModify;
@@ -257,6 +285,12 @@ typedef struct FdwRoutine
 	/* Support functions for path reparameterization. */
 	ReparameterizeForeignPathByChild_function ReparameterizeForeignPathByChild;
 
+	/* Support functions for asynchronous execution */
+	IsForeignPathAsyncCapable_function IsForeignPathAsyncCapable;
+	ForeignAsyncRequest_function ForeignAsyncRequest;
+	ForeignAsyncConfigureWait_function ForeignAsyncConfigureWait;
+	ForeignAsyncNotify_function ForeignAsyncNotify;
+
 	/* Support functions for transaction management */
 	CommitForeignTransaction_function CommitForeignTransaction;
 	RollbackForeignTransaction_function RollbackForeignTransaction;
@@ -264,6 +298,18 @@ typedef struct FdwRoutine
 	GetPrepareId_function GetPrepareId;
 	PrepareForeignCSNSnapshot_function PrepareForeignCSNSnapshot;
 	AssignGlobalCSN_function AssignGlobalCSN;
+
+	/* Asynchronous variants of the above, used to pipeline participants */
+	SendPrepareForeignTransaction_function SendPrepareForeignTransaction;
+	WaitPrepareForeignTransaction_function WaitPrepareForeignTransaction;
+	SendPrepareForeignCSNSnapshot_function SendPrepareForeignCSNSnapshot;
+	WaitPrepareForeignCSNSnapshot_function WaitPrepareForeignCSNSnapshot;
+	SendAssignGlobalCSN_function SendAssignGlobalCSN;
+	WaitAssignGlobalCSN_function WaitAssignGlobalCSN;
+	SendCommitForeignTransaction_function SendCommitForeignTransaction;
+	WaitCommitForeignTransaction_function WaitCommitForeignTransaction;
+	SendRollbackForeignTransaction_function SendRollbackForeignTransaction;
+	WaitRollbackForeignTransaction_function WaitRollbackForeignTransaction;
 } FdwRoutine;
 
 
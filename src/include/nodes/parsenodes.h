@@ -3059,6 +3059,7 @@ typedef struct TransactionStmt
 	char	   *savepoint_name; /* for savepoint commands */
 	char	   *gid;			/* for two-phase-commit related commands */
 	bool		chain;			/* AND CHAIN option */
+	char	   *csn;			/* CSN to assign at COMMIT PREPARED, or NULL */
 } TransactionStmt;
 
 /* ----------------------
@@ -100,6 +100,7 @@ PG_KEYWORD("copy", COPY, UNRESERVED_KEYWORD, BARE_LABEL)
 PG_KEYWORD("cost", COST, UNRESERVED_KEYWORD, BARE_LABEL)
 PG_KEYWORD("create", CREATE, RESERVED_KEYWORD, AS_LABEL)
 PG_KEYWORD("cross", CROSS, TYPE_FUNC_NAME_KEYWORD, BARE_LABEL)
+PG_KEYWORD("csn", CSN_P, UNRESERVED_KEYWORD, BARE_LABEL)
 PG_KEYWORD("csv", CSV, UNRESERVED_KEYWORD, BARE_LABEL)
 PG_KEYWORD("cube", CUBE, UNRESERVED_KEYWORD, BARE_LABEL)
 PG_KEYWORD("current", CURRENT_P, UNRESERVED_KEYWORD, BARE_LABEL)
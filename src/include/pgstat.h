@@ -71,6 +71,7 @@ typedef enum StatMsgType
 	PGSTAT_MTYPE_DEADLOCK,
 	PGSTAT_MTYPE_CHECKSUMFAILURE,
 	PGSTAT_MTYPE_REPLSLOT,
+	PGSTAT_MTYPE_FDWXACT,
 } StatMsgType;
 
 /* ----------
@@ -497,6 +498,67 @@ typedef struct PgStat_MsgReplSlot
 	PgStat_Counter m_stream_bytes;
 } PgStat_MsgReplSlot;
 
+/* ----------
+ * PgStat_FdwXactPhase			Steps of distributed transactions timed per
+ *								foreign server
+ * ----------
+ */
+typedef enum PgStat_FdwXactPhase
+{
+	PGSTAT_FDWXACT_PREPARE,		/* preparing the foreign transaction */
+	PGSTAT_FDWXACT_CSN_PREPARE, /* getting its prepare CSN */
+	PGSTAT_FDWXACT_CSN_ASSIGN,	/* assigning the global CSN to it */
+	PGSTAT_FDWXACT_COMMIT,		/* committing it once prepared */
+	PGSTAT_FDWXACT_ROLLBACK		/* rolling it back once prepared */
+} PgStat_FdwXactPhase;
+
+#define PGSTAT_FDWXACT_NUM_PHASES	(PGSTAT_FDWXACT_ROLLBACK + 1)
+
+/* ----------
+ * PgStat_FdwXactCounts			The distributed transaction counts of a
+ *								foreign server
+ * ----------
+ */
+typedef struct PgStat_FdwXactCounts
+{
+	PgStat_Counter f_count[PGSTAT_FDWXACT_NUM_PHASES];
+	PgStat_Counter f_time[PGSTAT_FDWXACT_NUM_PHASES];	/* times in
+														 * microseconds */
+	PgStat_Counter f_failures;	/* failed commits and rollbacks of prepared
+								 * transactions */
+} PgStat_FdwXactCounts;
+
+/* ----------
+ * PgStat_FdwXactEntry			Per-server info in a MsgFdwXact, also used
+ *								for the counts pending in a backend
+ * ----------
+ */
+typedef struct PgStat_FdwXactEntry
+{
+	Oid			f_serverid;
+	PgStat_FdwXactCounts f_counts;
+} PgStat_FdwXactEntry;
+
+/* ----------
+ * PgStat_MsgFdwXact			Sent by the backend or the foreign transaction
+ *								resolver to update distributed transaction
+ *								statistics, or to drop the entries of
+ *								foreign servers.
+ * ----------
+ */
+#define PGSTAT_NUM_FDWXACTENTRIES	\
+	((PGSTAT_MSG_PAYLOAD - sizeof(Oid) - sizeof(bool) - sizeof(int))  \
+	 / sizeof(PgStat_FdwXactEntry))
+
+typedef struct PgStat_MsgFdwXact
+{
+	PgStat_MsgHdr m_hdr;
+	Oid			m_databaseid;
+	bool		m_drop;
+	int			m_nentries;
+	PgStat_FdwXactEntry m_entry[PGSTAT_NUM_FDWXACTENTRIES];
+} PgStat_MsgFdwXact;
+
 
 /* ----------
  * PgStat_MsgRecoveryConflict	Sent by the backend upon recovery conflict
@@ -651,6 +713,7 @@ typedef union PgStat_Msg
 	PgStat_MsgTempFile msg_tempfile;
 	PgStat_MsgChecksumFailure msg_checksumfailure;
 	PgStat_MsgReplSlot msg_replslot;
+	PgStat_MsgFdwXact msg_fdwxact;
 } PgStat_Msg;
 
 
@@ -662,7 +725,7 @@ typedef union PgStat_Msg
  * ------------------------------------------------------------
  */
 
-#define PGSTAT_FILE_FORMAT_ID	0x01A5BC9F
+#define PGSTAT_FILE_FORMAT_ID	0x01A5BCA1
 
 /* ----------
  * PgStat_StatDBEntry			The collector's data per database
@@ -832,6 +895,22 @@ typedef struct PgStat_ReplSlotStats
 	TimestampTz stat_reset_timestamp;
 } PgStat_ReplSlotStats;
 
+/*
+ * Distributed transaction statistics of a foreign server kept in the stats
+ * collector
+ */
+typedef struct PgStat_FdwXactKey
+{
+	Oid			databaseid;
+	Oid			serverid;
+} PgStat_FdwXactKey;
+
+typedef struct PgStat_StatFdwXactEntry
+{
+	PgStat_FdwXactKey key;		/* hash key (must be first) */
+	PgStat_FdwXactCounts counts;
+} PgStat_StatFdwXactEntry;
+
 /* ----------
  * Backend states
  * ----------
@@ -919,7 +998,8 @@ typedef enum
  */
 typedef enum
 {
-	WAIT_EVENT_BACKUP_WAIT_WAL_ARCHIVE = PG_WAIT_IPC,
+	WAIT_EVENT_APPEND_READY = PG_WAIT_IPC,
+	WAIT_EVENT_BACKUP_WAIT_WAL_ARCHIVE,
 	WAIT_EVENT_BGWORKER_SHUTDOWN,
 	WAIT_EVENT_BGWORKER_STARTUP,
 	WAIT_EVENT_BTREE_PAGE,
@@ -972,6 +1052,7 @@ typedef enum
 typedef enum
 {
 	WAIT_EVENT_BASE_BACKUP_THROTTLE = PG_WAIT_TIMEOUT,
+	WAIT_EVENT_CSN_SNAPSHOT_SYNC,
 	WAIT_EVENT_PG_SLEEP,
 	WAIT_EVENT_RECOVERY_APPLY_DELAY,
 	WAIT_EVENT_RECOVERY_RETRIEVE_RETRY_INTERVAL,
@@ -1551,6 +1632,11 @@ extern void pgstat_send_archiver(const char *xlog, bool failed);
 extern void pgstat_send_bgwriter(void);
 extern void pgstat_send_wal(void);
 
+extern void pgstat_count_fdwxact(Oid serverid, PgStat_FdwXactPhase phase,
+								 int n, instr_time start);
+extern void pgstat_count_fdwxact_failure(Oid serverid, int n);
+extern void pgstat_report_fdwxact_drop(Oid serverid);
+
 /* ----------
  * Support functions for the SQL-callable functions to
  * generate the pgstat* views.
@@ -1567,6 +1653,7 @@ extern PgStat_GlobalStats *pgstat_fetch_global(void);
 extern PgStat_WalStats *pgstat_fetch_stat_wal(void);
 extern PgStat_SLRUStats *pgstat_fetch_slru(void);
 extern PgStat_ReplSlotStats *pgstat_fetch_replslot(int *nslots_p);
+extern PgStat_StatFdwXactEntry *pgstat_fetch_stat_fdwxact(Oid serverid);
 
 extern void pgstat_count_slru_page_zeroed(int slru_idx);
 extern void pgstat_count_slru_page_hit(int slru_idx);
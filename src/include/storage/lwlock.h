@@ -219,6 +219,7 @@ typedef enum BuiltinTrancheIds
 	LWTRANCHE_PARALLEL_APPEND,
 	LWTRANCHE_PER_XACT_PREDICATE_LIST,
 	LWTRANCHE_CSN_LOG_BUFFERS,
+	LWTRANCHE_CSN_LOG_CONTROL,
 	LWTRANCHE_FIRST_USER_DEFINED
 }			BuiltinTrancheIds;
 
@@ -1 +1,44 @@
-create table t1(i int, j int, k varchar);
\ No newline at end of file
+create table t1(i int, j int, k varchar);
+-- COMMIT PREPARED with the global CSN
+BEGIN;
+INSERT INTO t1 VALUES (1, 1, 'a');
+PREPARE TRANSACTION 'csn_pt1';
+SELECT pg_csn_snapshot_prepare('csn_pt1') > 0 AS prepared;
+SELECT pg_csn_snapshot_export() + 1000 AS global_csn \gset
+COMMIT PREPARED 'csn_pt1' WITH CSN :global_csn;
+SELECT * FROM t1;
+
+-- CSN must be a valid normal CSN
+BEGIN;
+INSERT INTO t1 VALUES (2, 2, 'b');
+PREPARE TRANSACTION 'csn_pt2';
+COMMIT PREPARED 'csn_pt2' WITH CSN 1.5;
+COMMIT PREPARED 'csn_pt2' WITH CSN 1;
+COMMIT PREPARED 'csn_pt2';
+SELECT * FROM t1 ORDER BY i;
+
+-- Visibility checks under an imported snapshot go through the xid -> CSN cache
+create table t2(i int);
+INSERT INTO t2 SELECT generate_series(1, 10);
+SELECT hits AS hits_before FROM pg_stat_csn_cache \gset
+SELECT pg_csn_snapshot_export() AS snap_csn \gset
+BEGIN ISOLATION LEVEL REPEATABLE READ;
+SELECT pg_csn_snapshot_import(:snap_csn);
+SELECT count(*) FROM t2;
+SELECT hits - :hits_before >= 9 AS cache_hit FROM pg_stat_csn_cache;
+COMMIT;
+
+-- A new backend finds the CSNs resolved above in the shared CSN hints
+\c
+BEGIN ISOLATION LEVEL REPEATABLE READ;
+SELECT pg_csn_snapshot_import(:snap_csn);
+SELECT count(*) FROM t2;
+SELECT hint_hits > 0 AS hint_hit FROM pg_stat_csn_cache;
+COMMIT;
+
+-- Importing a snapshot from a node whose clock is ahead waits for our clock
+SELECT pg_csn_snapshot_export() + 50000000 AS future_csn \gset
+BEGIN ISOLATION LEVEL REPEATABLE READ;
+SELECT pg_csn_snapshot_import(:future_csn);
+COMMIT;
+SELECT sync_waits > 0 AS waited, max_skew > 0 AS skewed FROM pg_stat_csn_sync;
@@ -0,0 +1,55 @@
+# Check that CSN snapshots stay consistent under concurrent commits: each
+# pgbench TPC-B-like transaction adds the same delta to an account, a teller
+# and a branch and logs it in the history, so every snapshot must see the
+# same total in all four tables.
+
+use strict;
+use warnings;
+
+use TestLib;
+use Test::More tests => 3;
+use PostgresNode;
+
+my $node = get_new_node('csnconsistency');
+$node->init;
+$node->append_conf(
+	'postgresql.conf', qq{
+	enable_csn_snapshot = on
+	csn_snapshot_defer_time = 10
+	});
+$node->start;
+
+$node->command_ok([ 'pgbench', '-i', '-s', '1', 'postgres' ],
+	'pgbench initialization');
+
+# A single statement runs under a single snapshot.  If the totals differ,
+# run a statement that fails, which makes pgbench abort the client and exit
+# with an error.
+my $script = "$TestLib::tmp_check/csn_check.sql";
+TestLib::append_to_file(
+	$script, q{
+SELECT (SELECT sum(abalance) FROM pgbench_accounts) - b.total AS adiff,
+       (SELECT sum(tbalance) FROM pgbench_tellers) - b.total AS tdiff,
+       (SELECT coalesce(sum(delta), 0) FROM pgbench_history) - b.total AS hdiff
+  FROM (SELECT sum(bbalance) AS total FROM pgbench_branches) b \gset
+\if :adiff != 0 or :tdiff != 0 or :hdiff != 0
+SELECT 'inconsistent snapshot'::int;
+\endif
+});
+
+$node->command_ok(
+	[
+		'pgbench', '-n', '-c', '4', '-j', '4', '-t', '200',
+		'-b', 'tpcb-like@4', '-f', "$script\@1", 'postgres'
+	],
+	'snapshots are consistent under concurrent commits');
+
+is( $node->safe_psql(
+		'postgres', q{
+		SELECT count(*) > 0 AND
+			   sum(delta) = (SELECT sum(bbalance) FROM pgbench_branches)
+		  FROM pgbench_history}),
+	't',
+	'transactions were committed and the totals match');
+
+$node->stop;
@@ -0,0 +1,78 @@
+# Check that visibility checks under an old csn snapshot are served from
+# CSNLog buffers when csn_log_buffers covers the xids involved.
+
+use strict;
+use warnings;
+
+use TestLib;
+use Test::More tests => 6;
+use PostgresNode;
+use Time::HiRes qw(gettimeofday tv_interval);
+
+# Each CSNLog page covers 1024 xids, so this spans about 24 pages.
+my $nxacts = 24000;
+
+my $script = "$TestLib::tmp_check/csn_insert.sql";
+TestLib::append_to_file($script, "INSERT INTO t VALUES (1);\n");
+
+# Generate $nxacts xids after taking a csn snapshot, then scan their rows
+# under that snapshot.  Return the CSNLog blocks read by the scan and its
+# duration.
+sub scan_under_old_snapshot
+{
+	my ($name, $buffers) = @_;
+
+	my $node = get_new_node($name);
+	$node->init;
+	$node->append_conf(
+		'postgresql.conf', qq{
+		enable_csn_snapshot = on
+		csn_snapshot_defer_time = 120
+		csn_log_buffers = $buffers
+		autovacuum = off
+		synchronous_commit = off
+		});
+	$node->start;
+
+	$node->safe_psql('postgres', 'CREATE TABLE t(i int)');
+	my $snap_csn =
+	  $node->safe_psql('postgres', 'SELECT pg_csn_snapshot_export()');
+
+	$node->command_ok(
+		[ 'pgbench', '-n', '-f', $script, '-t', $nxacts, 'postgres' ],
+		"generate $nxacts transactions with csn_log_buffers = $buffers");
+
+	$node->safe_psql('postgres', "SELECT pg_stat_reset_slru('CSNLog')");
+
+	my $start = [gettimeofday];
+	my $count = $node->safe_psql(
+		'postgres', qq{
+		BEGIN ISOLATION LEVEL REPEATABLE READ;
+		SELECT pg_csn_snapshot_import($snap_csn);
+		SELECT count(*) FROM t;
+		COMMIT;
+	});
+	my $elapsed = tv_interval($start);
+	note "scan with csn_log_buffers = $buffers took $elapsed s";
+
+	# The rows were all inserted after the snapshot was taken.
+	is((split /\n/, $count)[-1], '0', 'old snapshot does not see new rows');
+
+	# Every row's xid is looked up once; wait for the stats to arrive.
+	$node->poll_query_until('postgres',
+		"SELECT blks_hit + blks_read >= $nxacts FROM pg_stat_slru WHERE name = 'CSNLog'"
+	) or die "timed out waiting for CSNLog statistics";
+
+	my $blks_read = $node->safe_psql('postgres',
+		"SELECT blks_read FROM pg_stat_slru WHERE name = 'CSNLog'");
+	note "CSNLog blocks read with csn_log_buffers = $buffers: $blks_read";
+
+	$node->stop;
+	return $blks_read;
+}
+
+my $read_small = scan_under_old_snapshot('csnlog_small', 16);
+my $read_large = scan_under_old_snapshot('csnlog_large', 256);
+
+cmp_ok($read_small, '>', 0, 'CSNLog smaller than the xid range is read from disk');
+is($read_large, 0, 'CSNLog covering the xid range stays in memory');
@@ -183,3 +183,13 @@ CALL wait_for_resolution(0);
 BEGIN;
 INSERT INTO ft_no2pc_1 VALUES (1);
 PREPARE TRANSACTION 'global_x1';
+
+-- Ok. The server not supporting two-phase commit is not modified, so it's
+-- committed rather than prepared.
+BEGIN;
+EXPLAIN (COSTS OFF) INSERT INTO ft_no2pc_1 VALUES (1);
+INSERT INTO ft_2pc_1 VALUES(1);
+PREPARE TRANSACTION 'global_x1';
+SELECT count(*) FROM pg_foreign_xacts;
+ROLLBACK PREPARED 'global_x1';
+CALL wait_for_resolution(0);
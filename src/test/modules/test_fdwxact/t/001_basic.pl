@@ -2,7 +2,7 @@ use strict;
 use warnings;
 use PostgresNode;
 use TestLib;
-use Test::More tests => 7;
+use Test::More tests => 28;
 
 my $node = get_new_node('main');
 $node->init;
@@ -66,6 +66,46 @@ sub run_transaction
 	return $log, $stdout;
 }
 
+# Start a psql session driven by send_query_and_wait(), to keep a transaction
+# open while other sessions run.
+sub start_psql
+{
+	my ($node) = @_;
+	my %psql = (stdin => '', stdout => '', stderr => '',
+				timer => IPC::Run::timer(60));
+
+	$psql{run} =
+	  IPC::Run::start(
+		  ['psql', '-XA', '-f', '-', '-d', $node->connstr('postgres')],
+		  '<', \$psql{stdin},
+		  '>', \$psql{stdout},
+		  '2>', \$psql{stderr},
+		  $psql{timer});
+
+	return \%psql;
+}
+
+sub send_query_and_wait
+{
+	my ($psql, $query, $untl) = @_;
+
+	$$psql{stdin} .= $query . "\n";
+	$$psql{run}->pump_nb();
+	while ($$psql{stdout} !~ /$untl/)
+	{
+		BAIL_OUT("aborting wait: program timed out\n"
+				 . "stream contents: >>$$psql{stdout}<<\n"
+				 . "pattern searched for: $untl\n")
+		  if $$psql{timer}->is_expired;
+		BAIL_OUT("aborting wait: program died\n"
+				 . "stream contents: >>$$psql{stdout}<<\n"
+				 . "pattern searched for: $untl\n")
+		  if !$$psql{run}->pumpable();
+		$$psql{run}->pump();
+	}
+	$$psql{stdout} = '';
+}
+
 my ($log, $xid);
 
 # The transaction is committed using two-phase commit.
@@ -75,6 +115,12 @@ my ($log, $xid);
 like($log, qr/commit prepared tx_$xid on srv_2pc_1/, "commit prepared transaction-1");
 like($log, qr/commit prepared tx_$xid on srv_2pc_2/, "commit prepared transaction-2");
 
+# Each server got its own resolver.
+is($node->safe_psql('postgres',
+					"SELECT count(*) FROM pg_stat_activity
+					WHERE backend_type = 'foreign transaction resolver'"),
+   2, "one resolver per foreign server");
+
 # Similary, two-phase commit is used.
 ($log, $xid) = run_transaction($node, "",
 					  "INSERT INTO t VALUES(1);
@@ -108,3 +154,176 @@ $node->safe_psql('postgres', "COMMIT PREPARED 'tx1'");
 like($log, qr/rollback $xid on srv_2pc_1/, "rollback on failed server");
 like($log, qr/rollback prepared tx_$xid on srv_2pc_1/, "rollback prepared on failed server");
 like($log, qr/rollback $xid on srv_2pc_2/, "rollback on another server");
+unlike($log, qr/rollback prepared tx_$xid on srv_2pc_2/,
+	   "no rollback prepared on server not asked to prepare");
+
+# A server that is only read from is committed in one-phase.
+my $stdout;
+($log, $stdout) = run_transaction($node, "SELECT test_reset_error();",
+								  "EXPLAIN INSERT INTO ft_2pc_2 VALUES(1);
+								  INSERT INTO t VALUES(1);
+								  INSERT INTO ft_2pc_1 VALUES(1);");
+($xid) = split /\n/, $stdout;
+like($log, qr/commit $xid on srv_2pc_2/, "commit read-only server in one-phase");
+unlike($log, qr/prepare tx_$xid on srv_2pc_2/, "read-only server is not prepared");
+
+# Commit the prepared foreign transactions in the committing backend.
+$node->append_conf('postgresql.conf', "log_line_prefix = '%b: '");
+$node->reload;
+($log, $xid) = run_transaction($node, "SELECT test_reset_error();",
+							   "SET LOCAL foreign_transaction_resolve_in_backend = on;
+							   INSERT INTO ft_2pc_1 VALUES(1);
+							   INSERT INTO ft_2pc_2 VALUES(1);");
+like($log, qr/client backend: LOG:  commit prepared tx_$xid on srv_2pc_1/,
+	 "commit prepared transaction in backend");
+
+# If the backend fails to commit, the resolver takes over.
+($log, $xid) = run_transaction($node,
+							   "SELECT test_inject_error('error', 'commit', 'srv_2pc_1');",
+							   "SET LOCAL foreign_transaction_resolve_in_backend = on;
+							   INSERT INTO ft_2pc_1 VALUES(1);
+							   INSERT INTO ft_2pc_2 VALUES(1);", "COMMIT", 1);
+like($log, qr/WARNING:  could not commit prepared foreign transaction on server "srv_2pc_1"/,
+	 "failure of commit prepared in backend");
+$node->safe_psql('postgres', "SELECT test_reset_error()");
+$node->poll_query_until('postgres', "SELECT count(*) = 0 FROM pg_foreign_xacts");
+like(TestLib::slurp_file($node->logfile),
+	 qr/foreign transaction resolver: LOG:  commit prepared tx_$xid on srv_2pc_1/,
+	 "resolver commits the failed foreign transaction");
+
+# A procedure committing in a loop never leaves the transaction, so the
+# resolvers take over the prepared foreign transactions of each commit.
+$node->safe_psql('postgres', q{
+CREATE PROCEDURE commit_loop() AS $$
+DECLARE
+  resolved bool;
+BEGIN
+  FOR i IN 1 .. 3 LOOP
+    INSERT INTO ft_2pc_1 VALUES(i);
+    INSERT INTO ft_2pc_2 VALUES(i);
+    COMMIT;
+  END LOOP;
+  FOR i IN 1 .. 300 LOOP
+    SELECT count(*) = 0 INTO resolved FROM pg_foreign_xacts;
+    EXIT WHEN resolved;
+    PERFORM pg_sleep_for('100 milliseconds');
+  END LOOP;
+  RAISE NOTICE 'resolved: %', resolved;
+END
+$$ LANGUAGE plpgsql;
+});
+my ($ret, $out, $err) = $node->psql('postgres',
+									"SET foreign_transaction_resolve_in_backend = on;
+									CALL commit_loop();");
+like($err, qr/resolved: t/,
+	 "prepared foreign transactions committed in a procedure are resolved");
+
+# Staying idle in a transaction started in the same query as the commit
+# doesn't hold back the prepared foreign transactions.
+my $psql_idle = start_psql($node);
+send_query_and_wait($psql_idle, "SET foreign_transaction_resolve_in_backend = on;
+					BEGIN;
+					INSERT INTO ft_2pc_1 VALUES(1);
+					INSERT INTO ft_2pc_2 VALUES(1);
+					COMMIT \\; BEGIN;
+					SELECT 'idle';", qr/^idle$/m);
+ok($node->poll_query_until('postgres',
+						   "SELECT count(*) = 0 FROM pg_foreign_xacts"),
+   "prepared foreign transactions are resolved while idle in transaction");
+send_query_and_wait($psql_idle, "COMMIT; SELECT 'done';", qr/^done$/m);
+$$psql_idle{stdin} .= "\\q\n";
+$$psql_idle{run}->finish;
+
+# With a single modified server, one-phase commit is used and the modified
+# server is committed last.  The local transaction must not have an xid.
+truncate $node->logfile, 0;
+$node->safe_psql('postgres', "BEGIN;
+				 INSERT INTO ft_2pc_1 VALUES(1);
+				 EXPLAIN INSERT INTO ft_2pc_2 VALUES(1);
+				 COMMIT;");
+$log = TestLib::slurp_file($node->logfile);
+like($log, qr/commit 0 on srv_2pc_2.*commit 0 on srv_2pc_1/s,
+	 "commit the modified server last");
+unlike($log, qr/prepare tx_/, "single modified server is not prepared");
+
+# Writing to a temporary table or sending a notification assigns an xid, so
+# the foreign server is no longer the only one modified.
+truncate $node->logfile, 0;
+$node->safe_psql('postgres', "CREATE TEMP TABLE tmp (i int);
+				 BEGIN;
+				 INSERT INTO tmp VALUES(1);
+				 INSERT INTO ft_2pc_1 VALUES(1);
+				 COMMIT;");
+$log = TestLib::slurp_file($node->logfile);
+like($log, qr/prepare tx_\d+ on srv_2pc_1/,
+	 "write to a temporary table needs two-phase commit");
+truncate $node->logfile, 0;
+$node->safe_psql('postgres', "BEGIN;
+				 INSERT INTO ft_2pc_1 VALUES(1);
+				 NOTIFY fdwxact_test;
+				 COMMIT;");
+$log = TestLib::slurp_file($node->logfile);
+like($log, qr/prepare tx_\d+ on srv_2pc_1/,
+	 "notification needs two-phase commit");
+
+# A serialization failure at commit happens before the foreign transactions
+# are prepared or committed.  The other transaction makes ours a pivot and
+# commits first, so ours fails at commit.
+my $psql = start_psql($node);
+truncate $node->logfile, 0;
+send_query_and_wait($psql, "BEGIN ISOLATION LEVEL SERIALIZABLE;
+					SELECT count(*) FROM t;
+					INSERT INTO t VALUES(1);
+					INSERT INTO ft_2pc_1 VALUES(1);
+					SELECT 'written';", qr/^written$/m);
+$node->safe_psql('postgres', "BEGIN ISOLATION LEVEL SERIALIZABLE;
+				 SELECT count(*) FROM t;
+				 INSERT INTO t VALUES(1);
+				 COMMIT;");
+send_query_and_wait($psql, "COMMIT; SELECT 'committed';", qr/^committed$/m);
+like($$psql{stderr}, qr/could not serialize access/,
+	 "serialization failure at commit");
+$log = TestLib::slurp_file($node->logfile);
+like($log, qr/rollback \d+ on srv_2pc_1/,
+	 "foreign transaction is rolled back on serialization failure");
+unlike($log, qr/prepare tx_\d+ on srv_2pc_1|commit \d+ on srv_2pc_1/,
+	   "foreign transaction is neither prepared nor committed");
+$$psql{stdin} .= "\\q\n";
+$$psql{run}->finish;
+
+# In-doubt foreign transactions survive a crash, both the ones a checkpoint
+# wrote to the snapshot file and the ones replayed from WAL.
+my $snapshot = $node->data_dir . '/pg_fdwxact/snapshot';
+$node->safe_psql('postgres', "BEGIN;
+				 INSERT INTO ft_2pc_1 VALUES(1);
+				 INSERT INTO ft_2pc_2 VALUES(1);
+				 PREPARE TRANSACTION 'tx_ckpt';");
+$node->safe_psql('postgres', "CHECKPOINT");
+ok(-f $snapshot, "checkpoint writes the snapshot file");
+$node->safe_psql('postgres', "BEGIN;
+				 INSERT INTO t VALUES(1);
+				 INSERT INTO ft_2pc_1 VALUES(1);
+				 PREPARE TRANSACTION 'tx_wal';");
+$node->stop('immediate');
+$node->start;
+is($node->safe_psql('postgres', "SELECT count(*) FROM pg_foreign_xacts"),
+   '3', "in-doubt foreign transactions are recovered");
+is($node->safe_psql('postgres',
+	"SELECT in_doubt, oldest_in_doubt_age IS NOT NULL
+	 FROM pg_stat_foreign_xact WHERE servername = 'srv_2pc_1'"),
+   '2|t', "in-doubt foreign transactions report their age");
+$node->safe_psql('postgres', "COMMIT PREPARED 'tx_ckpt'");
+$node->safe_psql('postgres', "COMMIT PREPARED 'tx_wal'");
+$node->poll_query_until('postgres', "SELECT count(*) = 0 FROM pg_foreign_xacts");
+$node->safe_psql('postgres', "CHECKPOINT");
+ok(!-e $snapshot, "snapshot file is removed when nothing is in doubt");
+
+# Each backend reports the foreign transactions it prepared when it exits.
+$node->safe_psql('postgres', "BEGIN;
+				 INSERT INTO ft_2pc_1 VALUES(1);
+				 INSERT INTO ft_2pc_2 VALUES(1);
+				 COMMIT;");
+ok($node->poll_query_until('postgres',
+	"SELECT prepare_count > 0 AND in_doubt = 0 AND oldest_in_doubt_age IS NULL
+	 FROM pg_stat_foreign_xact WHERE servername = 'srv_2pc_1'"),
+   "foreign transaction statistics are collected");